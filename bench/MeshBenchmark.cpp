@@ -0,0 +1,204 @@
+// CPU benchmarks for the mesh import path. Run from the repository root so the default model paths resolve, or pass
+// OBJ files on the command line. The correctness checks of TangentGenerator live in tests/TangentTest.cpp.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "TangentGenerator.h"
+#include "Vertex.h"
+#include "VertexDedupTable.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+constexpr int iterations = 20;
+
+// The per-index vertex stream a Mesh sees before deduplication
+std::vector<Vertex> assembleVertices(const tinyobj::shape_t &shape, const tinyobj::attrib_t &attrib)
+{
+	std::vector<Vertex> stream;
+	stream.reserve(shape.mesh.indices.size());
+
+	for (const auto &index : shape.mesh.indices)
+	{
+		Vertex vertex{};
+		vertex.pos = glm::vec3{attrib.vertices.at(3 * index.vertex_index),
+							   attrib.vertices.at(3 * index.vertex_index + 1),
+							   attrib.vertices.at(3 * index.vertex_index + 2)};
+		vertex.normal = glm::vec3{attrib.normals.at(3 * index.normal_index),
+								  attrib.normals.at(3 * index.normal_index + 1),
+								  attrib.normals.at(3 * index.normal_index + 2)};
+
+		if (attrib.texcoords.size() != 0)
+		{
+			vertex.texCoords = glm::vec2{attrib.texcoords.at(2 * index.texcoord_index),
+										 1 - attrib.texcoords.at(2 * index.texcoord_index + 1)};
+		}
+
+		stream.push_back(vertex);
+	}
+
+	return stream;
+}
+
+template <typename F> float timeMilliseconds(F &&function)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	function();
+	auto endTime = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count();
+}
+
+void benchmarkDedup(const std::vector<Vertex> &stream)
+{
+	size_t mapUnique = 0;
+	size_t tableUnique = 0;
+
+	float mapTime = timeMilliseconds([&]() {
+		for (int i = 0; i < iterations; i++)
+		{
+			std::unordered_map<Vertex, uint32_t> uniqueVertices;
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+
+			for (const auto &vertex : stream)
+			{
+				if (uniqueVertices.count(vertex) == 0)
+				{
+					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(vertex);
+				}
+
+				indices.push_back(uniqueVertices.at(vertex));
+			}
+
+			mapUnique = vertices.size();
+		}
+	});
+
+	float tableTime = timeMilliseconds([&]() {
+		for (int i = 0; i < iterations; i++)
+		{
+			VertexDedupTable uniqueVertices(stream.size());
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			indices.reserve(stream.size());
+
+			for (const auto &vertex : stream)
+			{
+				indices.push_back(uniqueVertices.findOrInsert(vertex, vertices));
+			}
+
+			tableUnique = vertices.size();
+		}
+	});
+
+	std::cout << "  dedup " << stream.size() << " indices -> " << tableUnique << " vertices"
+			  << (mapUnique == tableUnique ? "" : " (MISMATCH with unordered_map!)") << "\n";
+	std::cout << "    unordered_map:    " << mapTime / iterations << " ms\n";
+	std::cout << "    VertexDedupTable: " << tableTime / iterations << " ms (" << mapTime / tableTime << "x)\n";
+}
+
+// The tangent accumulation Mesh used before TangentGenerator, kept as the baseline for timing
+std::vector<glm::vec3> referenceTangents(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	std::vector<glm::vec3> tangents(vertices.size(), glm::vec3{0.f});
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		auto &vert1 = vertices.at(indices.at(i));
+		auto &vert2 = vertices.at(indices.at(i + 1));
+		auto &vert3 = vertices.at(indices.at(i + 2));
+
+		glm::vec3 edge1 = vert2.pos - vert1.pos;
+		glm::vec3 edge2 = vert3.pos - vert1.pos;
+		glm::vec2 deltaUV1 = vert2.texCoords - vert1.texCoords;
+		glm::vec2 deltaUV2 = vert3.texCoords - vert1.texCoords;
+
+		float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+		glm::vec3 newTan = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+
+		tangents.at(indices.at(i)) += newTan;
+		tangents.at(indices.at(i + 1)) += newTan;
+		tangents.at(indices.at(i + 2)) += newTan;
+	}
+
+	return tangents;
+}
+
+void benchmarkTangents(const std::vector<Vertex> &stream)
+{
+	VertexDedupTable uniqueVertices(stream.size());
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	for (const auto &vertex : stream)
+	{
+		indices.push_back(uniqueVertices.findOrInsert(vertex, vertices));
+	}
+
+	std::vector<glm::vec3> reference;
+	float referenceTime = timeMilliseconds([&]() {
+		for (int i = 0; i < iterations; i++)
+		{
+			reference = referenceTangents(vertices, indices);
+		}
+	});
+
+	std::vector<Vertex> generated;
+	float generatorTime = timeMilliseconds([&]() {
+		for (int i = 0; i < iterations; i++)
+		{
+			generated = vertices;
+			TangentGenerator::generate(generated, indices);
+		}
+	});
+
+	float scalarTime = timeMilliseconds([&]() {
+		for (int i = 0; i < iterations; i++)
+		{
+			generated = vertices;
+			TangentGenerator::generateScalar(generated, indices);
+		}
+	});
+
+	std::cout << "  tangents for " << vertices.size() << " vertices\n";
+	std::cout << "    reference:        " << referenceTime / iterations << " ms\n";
+	std::cout << "    TangentGenerator: " << generatorTime / iterations << " ms (" << referenceTime / generatorTime
+			  << "x), scalar path " << scalarTime / iterations << " ms\n";
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<const char *> paths{"models/gun.obj", "models/rusty_sphere.obj"};
+	if (argc > 1)
+		paths.assign(argv + 1, argv + argc);
+
+	for (const char *path : paths)
+	{
+		tinyobj::ObjReaderConfig objReaderConfig;
+		objReaderConfig.triangulate = true;
+
+		tinyobj::ObjReader objReader;
+		if (!objReader.ParseFromFile(path, objReaderConfig))
+		{
+			std::cerr << "Could not load " << path << ": " << objReader.Error() << std::endl;
+			continue;
+		}
+
+		std::cout << path << "\n";
+
+		for (const auto &shape : objReader.GetShapes())
+		{
+			auto stream = assembleVertices(shape, objReader.GetAttrib());
+			benchmarkDedup(stream);
+			benchmarkTangents(stream);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,816 @@
+// Host to device upload benchmark for the staging strategies the renderer can use. Runs headless on any Vulkan 1.2
+// device, including CPU implementations, and writes its results as JSON.
+//
+// upload_benchmark [--device index] [--iterations count] [--output path]
+//
+// Every strategy uploads the same total amount of data per size step, split into as many equally sized buffers or
+// images as fit the step. Time is measured from the first byte written on the CPU until the GPU finished the last copy
+// and the median over all iterations is reported.
+//
+// The mip chain sweep compares blitting the chain of sRGB images on the GPU with generating it on the CPU through
+// MipGenerator and uploading every level in one copy. prebuilt_mips is the upload of an already generated chain, which
+// is all the loading thread waits for when the chains are generated on the workers.
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "CommandBuffer.h"
+#include "MipGenerator.h"
+#include "StagingUploader.h"
+
+#define VMA_IMPLEMENTATION
+#include <vk_mem_alloc.h>
+
+// Bytes uploaded per size step, split into count = totalBytes / size resources. The count is clamped to maxBufferCount
+// or maxImageCount to bound the number of allocations, so steps with small resources upload less than totalBytes (4
+// MiB for 4 KiB buffers, 16 MiB for 256x256 images). The results report the count, throughput uses the bytes actually
+// uploaded.
+constexpr vk::DeviceSize totalBytes = 64ull << 20;
+constexpr uint32_t maxBufferCount = 1024;
+constexpr uint32_t maxImageCount = 64;
+
+struct Context
+{
+	vk::Instance instance;
+	vk::PhysicalDevice physicalDevice;
+	vk::Device device;
+	VmaAllocator vmaAllocator;
+
+	uint32_t queueFamilyIndex;
+	vk::Queue queue;
+	vk::CommandPool commandPool;
+	vk::CommandBuffer commandBuffer;
+	vk::Fence fence;
+
+	// A transfer only family if the device has one, otherwise the same as queueFamilyIndex
+	uint32_t transferQueueFamilyIndex;
+	vk::Queue transferQueue;
+};
+
+struct BufferObject
+{
+	vk::Buffer buffer;
+	VmaAllocation allocation;
+	VmaAllocationInfo allocationInfo;
+};
+
+struct ImageObject
+{
+	vk::Image image;
+	VmaAllocation allocation;
+};
+
+struct Result
+{
+	const char *resource;
+	const char *strategy;
+	vk::DeviceSize size;
+	uint32_t count;
+	// Median time from the first written byte until every copy finished
+	float milliseconds;
+	// Median time until the first resource was usable
+	float firstMilliseconds;
+	bool deviceLocal;
+};
+
+float elapsedMilliseconds(std::chrono::high_resolution_clock::time_point startTime)
+{
+	auto endTime = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count();
+}
+
+float median(std::vector<float> values)
+{
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+std::string escapeJson(const std::string &string)
+{
+	std::string escaped;
+	for (char c : string)
+	{
+		if (c == '"' || c == '\\')
+			escaped.push_back('\\');
+		escaped.push_back(c);
+	}
+	return escaped;
+}
+
+Context createContext(uint32_t deviceIndex)
+{
+	Context context;
+
+	vk::ApplicationInfo applicationInfo("UploadBenchmark", 1, "VulkanEngine", 1, vk::ApiVersion12);
+	vk::InstanceCreateInfo instanceCreateInfo;
+	instanceCreateInfo.setPApplicationInfo(&applicationInfo);
+	context.instance = vk::createInstance(instanceCreateInfo);
+
+	auto physicalDevices = context.instance.enumeratePhysicalDevices();
+	if (deviceIndex >= physicalDevices.size())
+		throw std::runtime_error("There is no physical device with that index");
+	context.physicalDevice = physicalDevices[deviceIndex];
+
+	if (context.physicalDevice.getProperties().apiVersion < vk::ApiVersion12)
+		throw std::runtime_error("The upload benchmark needs a Vulkan 1.2 device for timeline semaphores");
+
+	// Any graphics or compute family can transfer, prefer graphics since that is what the renderer uploads on
+	auto queueFamilies = context.physicalDevice.getQueueFamilyProperties();
+	std::optional<uint32_t> mainFamily;
+	std::optional<uint32_t> transferFamily;
+	for (uint32_t i = 0; i < queueFamilies.size(); i++)
+	{
+		vk::QueueFlags flags = queueFamilies[i].queueFlags;
+		if ((flags & vk::QueueFlagBits::eGraphics) && !mainFamily.has_value())
+			mainFamily = i;
+		if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics) &&
+			!(flags & vk::QueueFlagBits::eCompute) && !transferFamily.has_value())
+			transferFamily = i;
+	}
+	for (uint32_t i = 0; i < queueFamilies.size() && !mainFamily.has_value(); i++)
+	{
+		if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eCompute)
+			mainFamily = i;
+	}
+	if (!mainFamily.has_value())
+		throw std::runtime_error("The device has no graphics or compute queue");
+
+	context.queueFamilyIndex = mainFamily.value();
+	context.transferQueueFamilyIndex = transferFamily.value_or(mainFamily.value());
+
+	float queuePriority = 1.f;
+	std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos(1);
+	queueCreateInfos[0].setQueueFamilyIndex(context.queueFamilyIndex);
+	queueCreateInfos[0].setQueuePriorities(queuePriority);
+	if (context.transferQueueFamilyIndex != context.queueFamilyIndex)
+	{
+		vk::DeviceQueueCreateInfo transferQueueCreateInfo;
+		transferQueueCreateInfo.setQueueFamilyIndex(context.transferQueueFamilyIndex);
+		transferQueueCreateInfo.setQueuePriorities(queuePriority);
+		queueCreateInfos.push_back(transferQueueCreateInfo);
+	}
+
+	vk::PhysicalDeviceVulkan12Features vulkan12Features;
+	vulkan12Features.setTimelineSemaphore(vk::True);
+
+	vk::DeviceCreateInfo deviceCreateInfo;
+	deviceCreateInfo.setPNext(&vulkan12Features);
+	deviceCreateInfo.setQueueCreateInfos(queueCreateInfos);
+	context.device = context.physicalDevice.createDevice(deviceCreateInfo);
+
+	context.queue = context.device.getQueue(context.queueFamilyIndex, 0);
+	context.transferQueue = context.device.getQueue(context.transferQueueFamilyIndex, 0);
+
+	VmaAllocatorCreateInfo vmaCreateInfo{};
+	vmaCreateInfo.device = context.device;
+	vmaCreateInfo.instance = context.instance;
+	vmaCreateInfo.physicalDevice = context.physicalDevice;
+	vmaCreateInfo.vulkanApiVersion = VK_API_VERSION_1_2;
+	vmaCreateAllocator(&vmaCreateInfo, &context.vmaAllocator);
+
+	vk::CommandPoolCreateInfo commandPoolCreateInfo;
+	commandPoolCreateInfo.setQueueFamilyIndex(context.queueFamilyIndex);
+	commandPoolCreateInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+	context.commandPool = context.device.createCommandPool(commandPoolCreateInfo);
+
+	vk::CommandBufferAllocateInfo commandBufferAllocateInfo;
+	commandBufferAllocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+	commandBufferAllocateInfo.setCommandPool(context.commandPool);
+	commandBufferAllocateInfo.setCommandBufferCount(1);
+	context.commandBuffer = context.device.allocateCommandBuffers(commandBufferAllocateInfo).at(0);
+
+	context.fence = context.device.createFence({});
+
+	return context;
+}
+
+void destroyContext(Context &context)
+{
+	context.device.destroyFence(context.fence);
+	context.device.destroyCommandPool(context.commandPool);
+	vmaDestroyAllocator(context.vmaAllocator);
+	context.device.destroy();
+	context.instance.destroy();
+}
+
+BufferObject createBuffer(const Context &context, vk::DeviceSize size, VkBufferUsageFlags usage,
+						  VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags)
+{
+	VkBufferCreateInfo bufferCreateInfo{};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bufferCreateInfo.usage = usage;
+	bufferCreateInfo.size = size;
+
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = memoryUsage;
+	allocCreateInfo.flags = flags;
+
+	BufferObject object;
+	if (vmaCreateBuffer(context.vmaAllocator, &bufferCreateInfo, &allocCreateInfo,
+						reinterpret_cast<VkBuffer *>(&object.buffer), &object.allocation,
+						&object.allocationInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a benchmark buffer");
+	}
+	return object;
+}
+
+BufferObject createStagingBuffer(const Context &context, vk::DeviceSize size)
+{
+	return createBuffer(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+						VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+}
+
+void destroyBuffer(const Context &context, BufferObject &object)
+{
+	vmaDestroyBuffer(context.vmaAllocator, object.buffer, object.allocation);
+}
+
+ImageObject createImage(const Context &context, uint32_t extent, vk::Format format = vk::Format::eR8G8B8A8Unorm,
+						uint32_t mipLevels = 1)
+{
+	vk::ImageCreateInfo imageCreateInfo;
+	imageCreateInfo.setImageType(vk::ImageType::e2D);
+	imageCreateInfo.setFormat(format);
+	imageCreateInfo.setExtent({extent, extent, 1});
+	imageCreateInfo.setMipLevels(mipLevels);
+	imageCreateInfo.setArrayLayers(1);
+	imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+	imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+	// Blitting the mip chain reads from the image itself
+	imageCreateInfo.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc |
+							 vk::ImageUsageFlagBits::eSampled);
+	imageCreateInfo.setSharingMode(vk::SharingMode::eExclusive);
+	imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+	ImageObject object;
+	if (vmaCreateImage(context.vmaAllocator, reinterpret_cast<VkImageCreateInfo *>(&imageCreateInfo),
+					   &allocCreateInfo, reinterpret_cast<VkImage *>(&object.image), &object.allocation,
+					   nullptr) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a benchmark image");
+	}
+	return object;
+}
+
+void submitAndWait(const Context &context)
+{
+	vk::SubmitInfo submitInfo;
+	submitInfo.setCommandBuffers(context.commandBuffer);
+	context.queue.submit(submitInfo, context.fence);
+
+	vk::resultCheck(context.device.waitForFences(context.fence, VK_TRUE, UINT64_MAX), "Could not wait for a copy");
+	context.device.resetFences(context.fence);
+}
+
+void recordImageCopy(const vk::CommandBuffer &commandBuffer, vk::Buffer source, vk::DeviceSize sourceOffset,
+					 vk::Image image, uint32_t extent)
+{
+	vk::ImageMemoryBarrier barrier;
+	barrier.setImage(image);
+	barrier.setSubresourceRange({vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setOldLayout(vk::ImageLayout::eUndefined);
+	barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {},
+								  nullptr, nullptr, barrier);
+
+	vk::BufferImageCopy copy;
+	copy.setBufferOffset(sourceOffset);
+	copy.setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+	copy.setImageExtent({extent, extent, 1});
+	commandBuffer.copyBufferToImage(source, image, vk::ImageLayout::eTransferDstOptimal, copy);
+
+	barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask({});
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {},
+								  nullptr, nullptr, barrier);
+}
+
+// Staging buffer and a single time command round trip per copy, the way meshes and textures used to be uploaded
+void uploadBuffersSingleTime(const Context &context, const std::vector<BufferObject> &targets,
+							 const std::vector<unsigned char> &data, vk::DeviceSize size, float &firstMilliseconds)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		BufferObject staging = createStagingBuffer(context, size);
+		memcpy(staging.allocationInfo.pMappedData, data.data(), size);
+
+		CommandBuffer::beginSTC(context.commandBuffer);
+		vk::BufferCopy copy;
+		copy.setSize(size);
+		context.commandBuffer.copyBuffer(staging.buffer, targets[i].buffer, copy);
+		CommandBuffer::endSTC(context.commandBuffer, context.queue);
+
+		destroyBuffer(context, staging);
+
+		if (i == 0)
+			firstMilliseconds = elapsedMilliseconds(startTime);
+	}
+}
+
+// One staging buffer for everything, all copies recorded into one submit
+void uploadBuffersBatched(const Context &context, const std::vector<BufferObject> &targets,
+						  const std::vector<unsigned char> &data, vk::DeviceSize size)
+{
+	BufferObject staging = createStagingBuffer(context, size * targets.size());
+
+	context.commandBuffer.reset();
+	context.commandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		memcpy(static_cast<unsigned char *>(staging.allocationInfo.pMappedData) + i * size, data.data(), size);
+
+		vk::BufferCopy copy;
+		copy.setSrcOffset(i * size);
+		copy.setSize(size);
+		context.commandBuffer.copyBuffer(staging.buffer, targets[i].buffer, copy);
+	}
+	context.commandBuffer.end();
+	submitAndWait(context);
+
+	destroyBuffer(context, staging);
+}
+
+// The renderer's StagingUploader on the transfer queue
+void uploadBuffersRing(N::StagingUploader &uploader, const std::vector<BufferObject> &targets,
+					   const std::vector<unsigned char> &data, vk::DeviceSize size)
+{
+	for (const auto &target : targets)
+	{
+		uploader.upload(target.buffer, 0, data.data(), size);
+	}
+
+	N::UploadBatch batch = uploader.submitBatch();
+	uploader.wait(batch.timelineValue);
+}
+
+// Writes straight into mapped memory. Where the device has host visible device local memory (resizable BAR or
+// unified memory) this skips the copy entirely, elsewhere VMA falls back to host memory the GPU reads over the bus.
+void uploadBuffersDirect(const Context &context, const std::vector<BufferObject> &targets,
+						 const std::vector<unsigned char> &data, vk::DeviceSize size)
+{
+	for (const auto &target : targets)
+	{
+		memcpy(target.allocationInfo.pMappedData, data.data(), size);
+		vmaFlushAllocation(context.vmaAllocator, target.allocation, 0, size);
+	}
+}
+
+void uploadImagesSingleTime(const Context &context, const std::vector<ImageObject> &targets,
+							const std::vector<unsigned char> &data, uint32_t extent, float &firstMilliseconds)
+{
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(extent) * extent * 4;
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		BufferObject staging = createStagingBuffer(context, size);
+		memcpy(staging.allocationInfo.pMappedData, data.data(), size);
+
+		CommandBuffer::beginSTC(context.commandBuffer);
+		recordImageCopy(context.commandBuffer, staging.buffer, 0, targets[i].image, extent);
+		CommandBuffer::endSTC(context.commandBuffer, context.queue);
+
+		destroyBuffer(context, staging);
+
+		if (i == 0)
+			firstMilliseconds = elapsedMilliseconds(startTime);
+	}
+}
+
+void uploadImagesBatched(const Context &context, const std::vector<ImageObject> &targets,
+						 const std::vector<unsigned char> &data, uint32_t extent)
+{
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(extent) * extent * 4;
+	BufferObject staging = createStagingBuffer(context, size * targets.size());
+
+	context.commandBuffer.reset();
+	context.commandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		memcpy(static_cast<unsigned char *>(staging.allocationInfo.pMappedData) + i * size, data.data(), size);
+		recordImageCopy(context.commandBuffer, staging.buffer, i * size, targets[i].image, extent);
+	}
+	context.commandBuffer.end();
+	submitAndWait(context);
+
+	destroyBuffer(context, staging);
+}
+
+uint32_t getMipLevels(uint32_t extent)
+{
+	return static_cast<uint32_t>(std::bit_width(extent));
+}
+
+// Levels start at multiples of 16 bytes, the same layout Material stages generated chains in
+vk::DeviceSize getMipOffset(uint32_t extent, uint32_t level)
+{
+	vk::DeviceSize offset = 0;
+	for (uint32_t i = 0; i < level; i++)
+	{
+		vk::DeviceSize levelExtent = std::max(extent >> i, 1u);
+		offset += (levelExtent * levelExtent * 4 + 15) & ~vk::DeviceSize(15);
+	}
+	return offset;
+}
+
+void generateMipChain(unsigned char *chain, uint32_t extent)
+{
+	for (uint32_t level = 1; level < getMipLevels(extent); level++)
+	{
+		uint32_t levelExtent = std::max(extent >> (level - 1), 1u);
+		N::MipGenerator::downsample(chain + getMipOffset(extent, level - 1), levelExtent, levelExtent, 4,
+									N::TexelContent::SrgbColor, chain + getMipOffset(extent, level));
+	}
+}
+
+void recordMipBarrier(const vk::CommandBuffer &commandBuffer, vk::Image image, uint32_t baseLevel,
+					  uint32_t levelCount, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+					  vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask)
+{
+	vk::ImageMemoryBarrier barrier;
+	barrier.setImage(image);
+	barrier.setSubresourceRange({vk::ImageAspectFlagBits::eColor, baseLevel, levelCount, 0, 1});
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setOldLayout(oldLayout);
+	barrier.setNewLayout(newLayout);
+	barrier.setSrcAccessMask(srcAccessMask);
+	barrier.setDstAccessMask(dstAccessMask);
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands,
+								  {}, nullptr, nullptr, barrier);
+}
+
+// Copies level 0 and blits every level from the one above it, the path Material takes without CPU mip maps
+void recordBlitChain(const vk::CommandBuffer &commandBuffer, vk::Buffer source, vk::DeviceSize sourceOffset,
+					 vk::Image image, uint32_t extent)
+{
+	uint32_t mipLevels = getMipLevels(extent);
+	recordMipBarrier(commandBuffer, image, 0, mipLevels, vk::ImageLayout::eUndefined,
+					 vk::ImageLayout::eTransferDstOptimal, {}, vk::AccessFlagBits::eTransferWrite);
+
+	vk::BufferImageCopy copy;
+	copy.setBufferOffset(sourceOffset);
+	copy.setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+	copy.setImageExtent({extent, extent, 1});
+	commandBuffer.copyBufferToImage(source, image, vk::ImageLayout::eTransferDstOptimal, copy);
+
+	for (uint32_t level = 1; level < mipLevels; level++)
+	{
+		recordMipBarrier(commandBuffer, image, level - 1, 1, vk::ImageLayout::eTransferDstOptimal,
+						 vk::ImageLayout::eTransferSrcOptimal, vk::AccessFlagBits::eTransferWrite,
+						 vk::AccessFlagBits::eTransferRead);
+
+		int32_t sourceExtent = static_cast<int32_t>(std::max(extent >> (level - 1), 1u));
+		int32_t levelExtent = static_cast<int32_t>(std::max(extent >> level, 1u));
+		vk::ImageBlit blit;
+		blit.setSrcSubresource({vk::ImageAspectFlagBits::eColor, level - 1, 0, 1});
+		blit.setSrcOffsets({vk::Offset3D{0, 0, 0}, vk::Offset3D{sourceExtent, sourceExtent, 1}});
+		blit.setDstSubresource({vk::ImageAspectFlagBits::eColor, level, 0, 1});
+		blit.setDstOffsets({vk::Offset3D{0, 0, 0}, vk::Offset3D{levelExtent, levelExtent, 1}});
+		commandBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image,
+								vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+		recordMipBarrier(commandBuffer, image, level - 1, 1, vk::ImageLayout::eTransferSrcOptimal,
+						 vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eTransferRead, {});
+	}
+
+	recordMipBarrier(commandBuffer, image, mipLevels - 1, 1, vk::ImageLayout::eTransferDstOptimal,
+					 vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eTransferWrite, {});
+}
+
+// Every level of a staged chain in one copy
+void recordChainCopy(const vk::CommandBuffer &commandBuffer, vk::Buffer source, vk::DeviceSize sourceOffset,
+					 vk::Image image, uint32_t extent)
+{
+	uint32_t mipLevels = getMipLevels(extent);
+	recordMipBarrier(commandBuffer, image, 0, mipLevels, vk::ImageLayout::eUndefined,
+					 vk::ImageLayout::eTransferDstOptimal, {}, vk::AccessFlagBits::eTransferWrite);
+
+	std::vector<vk::BufferImageCopy> copies(mipLevels);
+	for (uint32_t level = 0; level < mipLevels; level++)
+	{
+		uint32_t levelExtent = std::max(extent >> level, 1u);
+		copies[level].setBufferOffset(sourceOffset + getMipOffset(extent, level));
+		copies[level].setImageSubresource({vk::ImageAspectFlagBits::eColor, level, 0, 1});
+		copies[level].setImageExtent({levelExtent, levelExtent, 1});
+	}
+	commandBuffer.copyBufferToImage(source, image, vk::ImageLayout::eTransferDstOptimal, copies);
+
+	recordMipBarrier(commandBuffer, image, 0, mipLevels, vk::ImageLayout::eTransferDstOptimal,
+					 vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eTransferWrite, {});
+}
+
+void uploadMipsBlit(const Context &context, const std::vector<ImageObject> &targets,
+					const std::vector<unsigned char> &data, uint32_t extent)
+{
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(extent) * extent * 4;
+	BufferObject staging = createStagingBuffer(context, size * targets.size());
+
+	context.commandBuffer.reset();
+	context.commandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		memcpy(static_cast<unsigned char *>(staging.allocationInfo.pMappedData) + i * size, data.data(), size);
+		recordBlitChain(context.commandBuffer, staging.buffer, i * size, targets[i].image, extent);
+	}
+	context.commandBuffer.end();
+	submitAndWait(context);
+
+	destroyBuffer(context, staging);
+}
+
+// Generates every chain on this thread first when generate is set, otherwise uploads the chain as it is
+void uploadMipsCpu(const Context &context, const std::vector<ImageObject> &targets,
+				   const std::vector<unsigned char> &data, std::vector<unsigned char> &chain, uint32_t extent,
+				   bool generate)
+{
+	vk::DeviceSize chainSize = getMipOffset(extent, getMipLevels(extent));
+	BufferObject staging = createStagingBuffer(context, chainSize * targets.size());
+
+	context.commandBuffer.reset();
+	context.commandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		if (generate)
+		{
+			memcpy(chain.data(), data.data(), static_cast<size_t>(extent) * extent * 4);
+			generateMipChain(chain.data(), extent);
+		}
+		memcpy(static_cast<unsigned char *>(staging.allocationInfo.pMappedData) + i * chainSize, chain.data(),
+			   chainSize);
+		recordChainCopy(context.commandBuffer, staging.buffer, i * chainSize, targets[i].image, extent);
+	}
+	context.commandBuffer.end();
+	submitAndWait(context);
+
+	destroyBuffer(context, staging);
+}
+
+void benchmarkBuffers(const Context &context, uint32_t iterations, std::vector<Result> &results)
+{
+	N::StagingUploaderCreateInfo uploaderCreateInfo;
+	uploaderCreateInfo.vmaAllocator = context.vmaAllocator;
+	uploaderCreateInfo.device = context.device;
+	uploaderCreateInfo.queue = context.transferQueue;
+	uploaderCreateInfo.queueFamilyIndex = context.transferQueueFamilyIndex;
+	// Nothing reads the buffers afterwards, so there is no ownership to hand over
+	uploaderCreateInfo.dstQueueFamilyIndex = context.transferQueueFamilyIndex;
+
+	N::StagingUploader uploader;
+	uploader.create(uploaderCreateInfo);
+
+	std::vector<unsigned char> data(totalBytes);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = static_cast<unsigned char>(i * 31);
+
+	for (vk::DeviceSize size = 4096; size <= totalBytes; size *= 4)
+	{
+		uint32_t count = static_cast<uint32_t>(std::clamp<vk::DeviceSize>(totalBytes / size, 1, maxBufferCount));
+
+		std::vector<BufferObject> deviceTargets;
+		std::vector<BufferObject> hostVisibleTargets;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			deviceTargets.push_back(createBuffer(context, size,
+												 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+												 VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0));
+			hostVisibleTargets.push_back(createBuffer(
+				context, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+				VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT));
+		}
+
+		VkMemoryPropertyFlags directProperties;
+		vmaGetAllocationMemoryProperties(context.vmaAllocator, hostVisibleTargets[0].allocation, &directProperties);
+
+		std::vector<float> stcTimes, stcFirstTimes, batchedTimes, ringTimes, directTimes;
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			float firstMilliseconds = 0.f;
+			auto startTime = std::chrono::high_resolution_clock::now();
+			uploadBuffersSingleTime(context, deviceTargets, data, size, firstMilliseconds);
+			stcTimes.push_back(elapsedMilliseconds(startTime));
+			stcFirstTimes.push_back(firstMilliseconds);
+
+			startTime = std::chrono::high_resolution_clock::now();
+			uploadBuffersBatched(context, deviceTargets, data, size);
+			batchedTimes.push_back(elapsedMilliseconds(startTime));
+
+			startTime = std::chrono::high_resolution_clock::now();
+			uploadBuffersRing(uploader, deviceTargets, data, size);
+			ringTimes.push_back(elapsedMilliseconds(startTime));
+
+			startTime = std::chrono::high_resolution_clock::now();
+			uploadBuffersDirect(context, hostVisibleTargets, data, size);
+			directTimes.push_back(elapsedMilliseconds(startTime));
+		}
+
+		// Only the single time strategy makes a resource usable before the whole step is done
+		results.push_back({"buffer", "single_time", size, count, median(stcTimes), median(stcFirstTimes), true});
+		results.push_back({"buffer", "batched", size, count, median(batchedTimes), median(batchedTimes), true});
+		results.push_back({"buffer", "ring", size, count, median(ringTimes), median(ringTimes), true});
+		results.push_back({"buffer", "direct", size, count, median(directTimes), median(directTimes),
+						   (directProperties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0});
+
+		for (auto &target : deviceTargets)
+			destroyBuffer(context, target);
+		for (auto &target : hostVisibleTargets)
+			destroyBuffer(context, target);
+
+		std::cerr << "buffers of " << size << " bytes done" << std::endl;
+	}
+
+	uploader.destroy();
+}
+
+void benchmarkImages(const Context &context, uint32_t iterations, std::vector<Result> &results)
+{
+	std::vector<unsigned char> data(totalBytes);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = static_cast<unsigned char>(i * 31);
+
+	for (uint32_t extent = 256; extent <= 4096; extent *= 2)
+	{
+		vk::DeviceSize size = static_cast<vk::DeviceSize>(extent) * extent * 4;
+		uint32_t count = static_cast<uint32_t>(std::clamp<vk::DeviceSize>(totalBytes / size, 1, maxImageCount));
+
+		std::vector<ImageObject> targets;
+		for (uint32_t i = 0; i < count; i++)
+			targets.push_back(createImage(context, extent));
+
+		std::vector<float> stcTimes, stcFirstTimes, batchedTimes;
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			float firstMilliseconds = 0.f;
+			auto startTime = std::chrono::high_resolution_clock::now();
+			uploadImagesSingleTime(context, targets, data, extent, firstMilliseconds);
+			stcTimes.push_back(elapsedMilliseconds(startTime));
+			stcFirstTimes.push_back(firstMilliseconds);
+
+			startTime = std::chrono::high_resolution_clock::now();
+			uploadImagesBatched(context, targets, data, extent);
+			batchedTimes.push_back(elapsedMilliseconds(startTime));
+		}
+
+		results.push_back({"image", "single_time", size, count, median(stcTimes), median(stcFirstTimes), true});
+		results.push_back({"image", "batched", size, count, median(batchedTimes), median(batchedTimes), true});
+
+		for (auto &target : targets)
+			vmaDestroyImage(context.vmaAllocator, target.image, target.allocation);
+
+		std::cerr << "images of " << extent << "x" << extent << " done" << std::endl;
+	}
+}
+
+void benchmarkMipChains(const Context &context, uint32_t iterations, std::vector<Result> &results)
+{
+	std::vector<unsigned char> data(totalBytes);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = static_cast<unsigned char>(i * 31);
+
+	for (uint32_t extent = 256; extent <= 4096; extent *= 2)
+	{
+		vk::DeviceSize size = static_cast<vk::DeviceSize>(extent) * extent * 4;
+		uint32_t count = static_cast<uint32_t>(std::clamp<vk::DeviceSize>(totalBytes / size, 1, maxImageCount));
+
+		std::vector<ImageObject> targets;
+		for (uint32_t i = 0; i < count; i++)
+			targets.push_back(createImage(context, extent, vk::Format::eR8G8B8A8Srgb, getMipLevels(extent)));
+
+		std::vector<unsigned char> chain(getMipOffset(extent, getMipLevels(extent)));
+		memcpy(chain.data(), data.data(), size);
+		generateMipChain(chain.data(), extent);
+
+		std::vector<float> blitTimes, cpuTimes, prebuiltTimes;
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			uploadMipsBlit(context, targets, data, extent);
+			blitTimes.push_back(elapsedMilliseconds(startTime));
+
+			startTime = std::chrono::high_resolution_clock::now();
+			uploadMipsCpu(context, targets, data, chain, extent, true);
+			cpuTimes.push_back(elapsedMilliseconds(startTime));
+
+			startTime = std::chrono::high_resolution_clock::now();
+			uploadMipsCpu(context, targets, data, chain, extent, false);
+			prebuiltTimes.push_back(elapsedMilliseconds(startTime));
+		}
+
+		// Sizes are of level 0, which is what both strategies start from
+		results.push_back({"mip_chain", "blit_mips", size, count, median(blitTimes), median(blitTimes), true});
+		results.push_back({"mip_chain", "cpu_mips", size, count, median(cpuTimes), median(cpuTimes), true});
+		results.push_back(
+			{"mip_chain", "prebuilt_mips", size, count, median(prebuiltTimes), median(prebuiltTimes), true});
+
+		for (auto &target : targets)
+			vmaDestroyImage(context.vmaAllocator, target.image, target.allocation);
+
+		std::cerr << "mip chains of " << extent << "x" << extent << " done" << std::endl;
+	}
+}
+
+std::string toJson(const Context &context, const std::vector<Result> &results)
+{
+	auto properties = context.physicalDevice.getProperties();
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"device\": \"" << escapeJson(properties.deviceName.data()) << "\",\n";
+	json << "  \"deviceType\": \"" << vk::to_string(properties.deviceType) << "\",\n";
+	json << "  \"apiVersion\": \"" << VK_API_VERSION_MAJOR(properties.apiVersion) << "."
+		 << VK_API_VERSION_MINOR(properties.apiVersion) << "." << VK_API_VERSION_PATCH(properties.apiVersion)
+		 << "\",\n";
+	json << "  \"dedicatedTransferQueue\": "
+		 << (context.transferQueueFamilyIndex != context.queueFamilyIndex ? "true" : "false") << ",\n";
+	json << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result &result = results[i];
+		double bytes = static_cast<double>(result.size) * result.count;
+		json << "    {\"resource\": \"" << result.resource << "\", \"strategy\": \"" << result.strategy
+			 << "\", \"size\": " << result.size << ", \"count\": " << result.count
+			 << ", \"milliseconds\": " << result.milliseconds
+			 << ", \"firstMilliseconds\": " << result.firstMilliseconds
+			 << ", \"mibPerSecond\": ";
+		// A step below the clock's resolution has no meaningful throughput, and inf is not valid JSON
+		if (result.milliseconds > 0.f)
+			json << bytes / (1024.0 * 1024.0) / (result.milliseconds / 1000.0);
+		else
+			json << "null";
+		json << ", \"deviceLocal\": " << (result.deviceLocal ? "true" : "false") << "}"
+			 << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	json << "  ]\n";
+	json << "}\n";
+	return json.str();
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t deviceIndex = 0;
+	uint32_t iterations = 5;
+	const char *outputPath = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--device" && i + 1 < argc)
+			deviceIndex = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (argument == "--iterations" && i + 1 < argc)
+			iterations = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		else if (argument == "--output" && i + 1 < argc)
+			outputPath = argv[++i];
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--device index] [--iterations count] [--output path]"
+					  << std::endl;
+			return 1;
+		}
+	}
+
+	Context context = createContext(deviceIndex);
+	std::cerr << "Benchmarking uploads on " << context.physicalDevice.getProperties().deviceName.data()
+			  << std::endl;
+
+	std::vector<Result> results;
+	benchmarkBuffers(context, iterations, results);
+	benchmarkImages(context, iterations, results);
+	benchmarkMipChains(context, iterations, results);
+
+	std::string json = toJson(context, results);
+	if (outputPath)
+	{
+		std::ofstream output(outputPath);
+		output << json;
+	}
+	else
+	{
+		std::cout << json;
+	}
+
+	destroyContext(context);
+
+	return 0;
+}
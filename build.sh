@@ -3,6 +3,7 @@
 # Compile shaders
 glslc shaders/shader.frag -o shaders/frag.spv
 glslc shaders/shader.vert -o shaders/vert.spv
+glslc shaders/shader_packed.vert -o shaders/vert_packed.spv
 
 # Compile the application
 cmake --build build -j 8
@@ -1,4 +1,6 @@
 del vert.spv
+del vert_packed.spv
 del frag.spv
 glslc shader.vert -o vert.spv
+glslc shader_packed.vert -o vert_packed.spv
 glslc shader.frag -o frag.spv
@@ -12,9 +12,10 @@ layout(set = 0, binding = 4) uniform CameraPos {
 } cameraPos;
 
 layout(set = 1, binding = 0) uniform sampler2D diffuseSampler;
-layout(set = 1, binding = 1) uniform sampler2D metallicSampler;
-layout(set = 1, binding = 2) uniform sampler2D roughnessSampler;
-layout(set = 1, binding = 3) uniform sampler2D normalSampler;
+// Ambient occlusion in r, roughness in g, metallic in b
+layout(set = 1, binding = 1) uniform sampler2D ormSampler;
+// Tangent space normal X in r and Y in g
+layout(set = 1, binding = 2) uniform sampler2D normalSampler;
 
 vec3 lightPos = vec3(-5.0, -4.0, -5.0);
 
@@ -51,12 +52,14 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0) {
 
 void main() {
 	vec3 albedo = texture(diffuseSampler, fragTexCoords).rgb;
-	float metallic = texture(metallicSampler, fragTexCoords).r;
-	float roughness = texture(roughnessSampler, fragTexCoords).r;
-	vec3 Normal = texture(normalSampler, fragTexCoords).rgb;
-	Normal = normalize(Normal * 2.0 - 1.0);
+	vec3 orm = texture(ormSampler, fragTexCoords).rgb;
+	float ao = orm.r;
+	float roughness = orm.g;
+	float metallic = orm.b;
+	// Only X and Y are stored, the tangent space normal always points out of the surface
+	vec2 normalXY = texture(normalSampler, fragTexCoords).rg * 2.0 - 1.0;
+	vec3 Normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
 	Normal = normalize(TBN * Normal);
-	float ao = 1.0;
 
 	// Camera position in local space
 	vec3 localCamPos = normalize(cameraPos.pos - worldPos);
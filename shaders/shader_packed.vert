@@ -0,0 +1,48 @@
+#version 450
+
+layout (push_constant) uniform UniformBufferOBJ {
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+	// PackedVertexDecode
+	vec4 positionOffset;
+	vec4 positionScale;
+	vec4 texCoordOffsetScale;
+} ubo;
+
+// xyz are unorm16 relative to the mesh bounds, w is the bitangent sign mapped to 0..1
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec2 inTangent;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoords;
+layout(location = 2) out vec3 worldPos;
+layout(location = 3) out mat3 TBN;
+
+// Inverse of PackedVertex::octEncode
+vec3 octDecode(vec2 encoded) {
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-direction.z, 0.0);
+	direction.x += direction.x >= 0.0 ? -fold : fold;
+	direction.y += direction.y >= 0.0 ? -fold : fold;
+	return normalize(direction);
+}
+
+void main() {
+	vec3 position = ubo.positionOffset.xyz + inPosition.xyz * ubo.positionScale.xyz;
+	vec3 normal = octDecode(inNormal);
+	vec3 tangent = octDecode(inTangent);
+	float bitangentSign = inPosition.w * 2.0 - 1.0;
+
+	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
+	fragColor = vec3(0.0);
+	fragTexCoords = ubo.texCoordOffsetScale.xy + inTexCoord * ubo.texCoordOffsetScale.zw;
+	worldPos = (ubo.model * vec4(position, 1.0)).xyz;
+	mat4 tranModel = transpose(inverse(ubo.model));
+	vec3 T = normalize(tranModel * vec4(tangent, 0.0)).xyz;
+	vec3 B = normalize(tranModel * vec4(cross(normal, tangent) * bitangentSign, 0.0)).xyz;
+	vec3 N = normalize(tranModel * vec4(normal, 0.0)).xyz;
+	TBN = mat3(T, B, N);
+}
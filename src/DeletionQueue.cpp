@@ -0,0 +1,30 @@
+#include "DeletionQueue.h"
+
+#include <stdexcept>
+
+namespace N
+{
+void DeletionQueue::push(uint64_t timelineValue, std::function<void()> &&deleter)
+{
+	if (!entries.empty() && entries.back().timelineValue > timelineValue)
+		throw std::runtime_error("Deletion queue tags must not decrease");
+
+	entries.push_back({timelineValue, std::move(deleter)});
+}
+
+void DeletionQueue::collect(uint64_t completedValue)
+{
+	while (!entries.empty() && entries.front().timelineValue <= completedValue)
+	{
+		// Pop first so a throwing deleter is not run twice
+		std::function<void()> deleter = std::move(entries.front().deleter);
+		entries.pop_front();
+		deleter();
+	}
+}
+
+void DeletionQueue::flush()
+{
+	collect(UINT64_MAX);
+}
+} // namespace N
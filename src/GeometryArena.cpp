@@ -0,0 +1,162 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace N
+{
+// Lets an index range be addressed as either 16 or 32 bit indices from offset 0 of the index buffer
+constexpr vk::DeviceSize indexAlignment = sizeof(uint32_t);
+
+void GeometryArena::create(const GeometryArenaCreateInfo &createInfo)
+{
+	vmaAllocator = createInfo.vmaAllocator;
+	vertexStride = createInfo.vertexStride;
+	vertexBlockSize = createInfo.vertexBlockSize;
+	indexBlockSize = createInfo.indexBlockSize;
+}
+
+void GeometryArena::destroy()
+{
+	for (auto &block : blocks)
+	{
+		// Whatever is left belongs to models that were never destroyed, their ranges go with the buffers
+		vmaClearVirtualBlock(block.vertexBlock);
+		vmaClearVirtualBlock(block.indexBlock);
+		vmaDestroyVirtualBlock(block.vertexBlock);
+		vmaDestroyVirtualBlock(block.indexBlock);
+
+		vmaDestroyBuffer(vmaAllocator, block.vertexBuffer, block.vertexBufferAllocation);
+		vmaDestroyBuffer(vmaAllocator, block.indexBuffer, block.indexBufferAllocation);
+	}
+	blocks.clear();
+}
+
+GeometryAllocation GeometryArena::allocate(uint32_t vertexCount, vk::DeviceSize indicesSize)
+{
+	GeometryAllocation allocation;
+
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		if (allocateFromBlock(i, vertexCount, indicesSize, allocation))
+			return allocation;
+	}
+
+	createBlock(std::max(vertexBlockSize, vertexCount * vertexStride), std::max(indexBlockSize, indicesSize));
+	if (!allocateFromBlock(static_cast<uint32_t>(blocks.size() - 1), vertexCount, indicesSize, allocation))
+		throw std::runtime_error("Failed to allocate mesh geometry from a new arena block");
+
+	return allocation;
+}
+
+void GeometryArena::free(GeometryAllocation &allocation)
+{
+	if (allocation.block == UINT32_MAX)
+		return;
+
+	vmaVirtualFree(blocks.at(allocation.block).vertexBlock, allocation.vertexAllocation);
+	vmaVirtualFree(blocks.at(allocation.block).indexBlock, allocation.indexAllocation);
+	allocation = {};
+}
+
+void GeometryArena::bind(const vk::CommandBuffer &commandBuffer, GeometryBindState &state, uint32_t block,
+						 vk::IndexType indexType) const
+{
+	if (state.block != block)
+	{
+		std::array<vk::DeviceSize, 1> offsets{0};
+		std::array<vk::Buffer, 1> vertexBuffers{blocks.at(block).vertexBuffer};
+		commandBuffer.bindVertexBuffers(0, vertexBuffers, offsets);
+		commandBuffer.bindIndexBuffer(blocks.at(block).indexBuffer, 0, indexType);
+
+		state.block = block;
+		state.indexType = indexType;
+	}
+	else if (state.indexType != indexType)
+	{
+		commandBuffer.bindIndexBuffer(blocks.at(block).indexBuffer, 0, indexType);
+		state.indexType = indexType;
+	}
+}
+
+void GeometryArena::createBlock(vk::DeviceSize vertexBufferSize, vk::DeviceSize indexBufferSize)
+{
+	// Whole vertices only, so the virtual block can hand out ranges counted in vertices
+	vk::DeviceSize vertexCapacity = vertexBufferSize / vertexStride;
+	indexBufferSize = (indexBufferSize + indexAlignment - 1) & ~(indexAlignment - 1);
+
+	Block block;
+
+	VmaAllocationCreateInfo vmaAllocCreateInfo{};
+	vmaAllocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+	vmaAllocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+	VkBufferCreateInfo vertexBufferCreateInfo{};
+	vertexBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	vertexBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	vertexBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	vertexBufferCreateInfo.size = vertexCapacity * vertexStride;
+
+	if (vmaCreateBuffer(vmaAllocator, &vertexBufferCreateInfo, &vmaAllocCreateInfo,
+						reinterpret_cast<VkBuffer *>(&block.vertexBuffer), &block.vertexBufferAllocation,
+						nullptr) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a geometry arena vertex buffer");
+	}
+
+	VkBufferCreateInfo indexBufferCreateInfo{};
+	indexBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	indexBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	indexBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	indexBufferCreateInfo.size = indexBufferSize;
+
+	if (vmaCreateBuffer(vmaAllocator, &indexBufferCreateInfo, &vmaAllocCreateInfo,
+						reinterpret_cast<VkBuffer *>(&block.indexBuffer), &block.indexBufferAllocation,
+						nullptr) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a geometry arena index buffer");
+	}
+
+	VmaVirtualBlockCreateInfo vertexBlockCreateInfo{};
+	vertexBlockCreateInfo.size = vertexCapacity;
+	vmaCreateVirtualBlock(&vertexBlockCreateInfo, &block.vertexBlock);
+
+	VmaVirtualBlockCreateInfo indexBlockCreateInfo{};
+	indexBlockCreateInfo.size = indexBufferSize;
+	vmaCreateVirtualBlock(&indexBlockCreateInfo, &block.indexBlock);
+
+	blocks.push_back(block);
+}
+
+bool GeometryArena::allocateFromBlock(uint32_t block, uint32_t vertexCount, vk::DeviceSize indicesSize,
+									  GeometryAllocation &allocation)
+{
+	// Virtual allocations cannot be empty
+	VmaVirtualAllocationCreateInfo vertexAllocCreateInfo{};
+	vertexAllocCreateInfo.size = std::max(vertexCount, 1u);
+
+	VkDeviceSize firstVertex;
+	if (vmaVirtualAllocate(blocks[block].vertexBlock, &vertexAllocCreateInfo, &allocation.vertexAllocation,
+						   &firstVertex) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	VmaVirtualAllocationCreateInfo indexAllocCreateInfo{};
+	indexAllocCreateInfo.size = std::max(indicesSize, indexAlignment);
+	indexAllocCreateInfo.alignment = indexAlignment;
+
+	if (vmaVirtualAllocate(blocks[block].indexBlock, &indexAllocCreateInfo, &allocation.indexAllocation,
+						   &allocation.indexOffset) != VK_SUCCESS)
+	{
+		vmaVirtualFree(blocks[block].vertexBlock, allocation.vertexAllocation);
+		allocation.vertexAllocation = VK_NULL_HANDLE;
+		return false;
+	}
+
+	allocation.block = block;
+	allocation.firstVertex = static_cast<uint32_t>(firstVertex);
+	return true;
+}
+} // namespace N
@@ -0,0 +1,152 @@
+#include "KtxFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace N
+{
+namespace
+{
+constexpr unsigned char ktxIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct KtxHeader
+{
+	unsigned char identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct KtxLevelIndex
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(KtxHeader) == 80, "KTX2 header must match the file layout");
+static_assert(sizeof(KtxLevelIndex) == 24, "KTX2 level index must match the file layout");
+} // namespace
+
+std::string KtxFile::getPath(const char *sourcePath)
+{
+	std::string path(sourcePath);
+
+	size_t extension = path.find_last_of('.');
+	size_t directory = path.find_last_of("/\\");
+	if (extension != std::string::npos && (directory == std::string::npos || extension > directory))
+		path.erase(extension);
+
+	return path.append(".ktx2");
+}
+
+bool KtxFile::parse(const unsigned char *data, size_t size, KtxImage &image, const char *&reason)
+{
+	KtxHeader header;
+	if (size < sizeof(header))
+	{
+		reason = "file is too small";
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.identifier, ktxIdentifier, sizeof(ktxIdentifier)) != 0)
+	{
+		reason = "not a KTX2 file";
+		return false;
+	}
+	if (header.supercompressionScheme != 0)
+	{
+		reason = "supercompressed data is not supported";
+		return false;
+	}
+	if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelHeight == 0)
+	{
+		reason = "only single 2D images are supported";
+		return false;
+	}
+
+	uint32_t blockSize = getBlockSize(static_cast<vk::Format>(header.vkFormat));
+	if (blockSize == 0)
+	{
+		reason = "only BC1, BC4, BC5 and BC7 are supported";
+		return false;
+	}
+	if (header.levelCount == 0)
+	{
+		// A level count of 0 asks the loader to generate the mips, which blits cannot do for compressed formats
+		reason = "the file has no pre-built mip levels";
+		return false;
+	}
+
+	uint32_t maxLevels = static_cast<uint32_t>(std::bit_width(std::max(header.pixelWidth, header.pixelHeight)));
+	size_t levelIndexSize = sizeof(KtxLevelIndex) * header.levelCount;
+	if (header.levelCount > maxLevels || size - sizeof(header) < levelIndexSize)
+	{
+		reason = "the level index is invalid";
+		return false;
+	}
+
+	image.format = static_cast<vk::Format>(header.vkFormat);
+	image.width = header.pixelWidth;
+	image.height = header.pixelHeight;
+	image.levels.resize(header.levelCount);
+
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		KtxLevelIndex levelIndex;
+		memcpy(&levelIndex, data + sizeof(header) + i * sizeof(levelIndex), sizeof(levelIndex));
+
+		KtxLevel &level = image.levels[i];
+		level.width = std::max(header.pixelWidth >> i, 1u);
+		level.height = std::max(header.pixelHeight >> i, 1u);
+
+		uint64_t expectedSize = static_cast<uint64_t>((level.width + 3) / 4) * ((level.height + 3) / 4) * blockSize;
+		if (levelIndex.byteLength != expectedSize || levelIndex.byteOffset > size ||
+			size - levelIndex.byteOffset < levelIndex.byteLength)
+		{
+			reason = "a mip level lies outside the file or has the wrong size";
+			return false;
+		}
+
+		level.offset = static_cast<size_t>(levelIndex.byteOffset);
+		level.size = static_cast<size_t>(levelIndex.byteLength);
+	}
+
+	return true;
+}
+
+uint32_t KtxFile::getBlockSize(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eBc1RgbUnormBlock:
+	case vk::Format::eBc1RgbSrgbBlock:
+	case vk::Format::eBc1RgbaUnormBlock:
+	case vk::Format::eBc1RgbaSrgbBlock:
+	case vk::Format::eBc4UnormBlock:
+	case vk::Format::eBc4SnormBlock:
+		return 8;
+	case vk::Format::eBc5UnormBlock:
+	case vk::Format::eBc5SnormBlock:
+	case vk::Format::eBc7UnormBlock:
+	case vk::Format::eBc7SrgbBlock:
+		return 16;
+	default:
+		return 0;
+	}
+}
+} // namespace N
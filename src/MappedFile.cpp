@@ -0,0 +1,175 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace N
+{
+MappedFile::MappedFile(MappedFile &&rhs) noexcept
+{
+	*this = std::move(rhs);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		close();
+
+		std::swap(mappedData, rhs.mappedData);
+		std::swap(mappedSize, rhs.mappedSize);
+#ifdef _WIN32
+		std::swap(fileHandle, rhs.fileHandle);
+		std::swap(mappingHandle, rhs.mappingHandle);
+#else
+		std::swap(fileDescriptor, rhs.fileDescriptor);
+#endif
+	}
+
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const char *path)
+{
+	close();
+
+	fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		close();
+		return false;
+	}
+
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files cannot be mapped, but they are still valid files
+	if (mappedSize == 0)
+		return true;
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+	{
+		close();
+		return false;
+	}
+
+	mappedData = static_cast<const unsigned char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!mappedData)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mappedData)
+		UnmapViewOfFile(mappedData);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+}
+
+void MappedFile::release(size_t offset, size_t size) const
+{
+	if (!mappedData || size == 0)
+		return;
+
+	// Unlocking pages that were never locked removes them from the working set
+	VirtualUnlock(const_cast<unsigned char *>(mappedData) + offset, size);
+}
+#else
+bool MappedFile::open(const char *path)
+{
+	close();
+
+	fileDescriptor = ::open(path, O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0)
+	{
+		close();
+		return false;
+	}
+
+	mappedSize = static_cast<size_t>(fileStat.st_size);
+
+	// Empty files cannot be mapped, but they are still valid files
+	if (mappedSize == 0)
+		return true;
+
+	void *mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	mappedData = static_cast<const unsigned char *>(mapping);
+	madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mappedData)
+		munmap(const_cast<unsigned char *>(mappedData), mappedSize);
+	if (fileDescriptor >= 0)
+		::close(fileDescriptor);
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	fileDescriptor = -1;
+}
+
+void MappedFile::release(size_t offset, size_t size) const
+{
+	if (!mappedData || size == 0)
+		return;
+
+	// madvise needs page aligned addresses, only whole pages inside the range are released
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+	size_t end = (offset + size) / pageSize * pageSize;
+	if (end <= begin)
+		return;
+
+	madvise(const_cast<unsigned char *>(mappedData) + begin, end - begin, MADV_DONTNEED);
+}
+#endif
+} // namespace N
@@ -3,12 +3,18 @@
 #include "stb_image.h"
 
 #include "CommandBuffer.h"
+#include "Hash.h"
+#include "TextureLayout.h"
 
 #include <iostream>
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <functional>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_enums.hpp>
@@ -17,310 +23,798 @@
 
 namespace N
 {
-Material::Material(const VmaAllocator &allocator, const vk::Device &device, const vk::Queue &queue,
-				   const vk::CommandBuffer &commandBuffer, const tinyobj::material_t &tinyObjMat)
+namespace
 {
-	std::tie(diffuse, diffuseAlloc) =
-		loadImage(allocator, queue, commandBuffer, vk::Format::eR8G8B8A8Srgb, tinyObjMat.diffuse_texname.c_str());
+float millisecondsSince(std::chrono::high_resolution_clock::time_point startTime)
+{
+	auto elapsedTime = std::chrono::high_resolution_clock::now() - startTime;
+	return std::chrono::duration<float, std::chrono::milliseconds::period>(elapsedTime).count();
+}
 
-	std::tie(metallic, metallicAlloc) =
-		loadImage(allocator, queue, commandBuffer, vk::Format::eR8G8B8A8Srgb, tinyObjMat.metallic_texname.c_str());
+// Formats of the images decoded from anything but KTX2, picked by what the map holds. Only albedo is color and sRGB
+// decoded, the other maps are linear data.
+constexpr vk::Format albedoFormat = vk::Format::eR8G8B8A8Srgb;
+constexpr vk::Format ormFormat = vk::Format::eR8G8B8A8Unorm;
+// Only the X and Y of the tangent space normal are stored, the shader reconstructs Z
+constexpr vk::Format normalFormat = vk::Format::eR8G8Unorm;
+// Single channel maps are only decoded to be packed into the ORM texture
+constexpr vk::Format scalarFormat = vk::Format::eR8Unorm;
+
+// Why a KTX2 file in format cannot stand in for an image decoded to slotFormat, or null when it can. The shader reads
+// albedo as sRGB color, all three channels of the ORM texture and the X and Y of normals as unsigned [0, 1] values it
+// remaps itself.
+const char *getSlotMismatch(vk::Format slotFormat, vk::Format format)
+{
+	switch (slotFormat)
+	{
+	case albedoFormat:
+		if (format == vk::Format::eBc1RgbSrgbBlock || format == vk::Format::eBc1RgbaSrgbBlock ||
+			format == vk::Format::eBc7SrgbBlock)
+			return nullptr;
+		return "albedo needs BC1 or BC7 with sRGB decoding";
+	case ormFormat:
+		if (format == vk::Format::eBc1RgbUnormBlock || format == vk::Format::eBc1RgbaUnormBlock ||
+			format == vk::Format::eBc7UnormBlock)
+			return nullptr;
+		return "the ORM map needs three channels of BC1 or BC7 without sRGB decoding";
+	case normalFormat:
+		if (format == vk::Format::eBc5UnormBlock)
+			return nullptr;
+		return "normal maps need unsigned BC5";
+	default:
+		return nullptr;
+	}
+}
 
-	std::tie(roughness, roughnessAlloc) =
-		loadImage(allocator, queue, commandBuffer, vk::Format::eR8G8B8A8Srgb, tinyObjMat.roughness_texname.c_str());
+// Bytes levels [firstLevel, endLevel) of the texture's chain take in host memory and in the staging buffer
+vk::DeviceSize getChainSize(const CachedTexture &texture, uint32_t firstLevel, uint32_t endLevel)
+{
+	return TextureLayout::getChainOffset(texture.format, texture.width, texture.height, endLevel) -
+		   TextureLayout::getChainOffset(texture.format, texture.width, texture.height, firstLevel);
+}
 
-	std::tie(normal, normalAlloc) =
-		loadImage(allocator, queue, commandBuffer, vk::Format::eR8G8B8A8Srgb, tinyObjMat.normal_texname.c_str());
+// In this renderer two channel textures are always normal maps
+TexelContent getTexelContent(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8G8B8A8Srgb:
+		return TexelContent::SrgbColor;
+	case vk::Format::eR8G8Unorm:
+		return TexelContent::NormalXY;
+	default:
+		return TexelContent::Linear;
+	}
+}
+} // namespace
 
-	VkImageSubresourceRange imageSubresourceRange{};
-	imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageSubresourceRange.baseArrayLayer = 0;
-	imageSubresourceRange.baseMipLevel = 0;
-	imageSubresourceRange.layerCount = 1;
-	imageSubresourceRange.levelCount = mipLevels;
+Material::Material(const MaterialCreateInfo &createInfo, const tinyobj::material_t &tinyObjMat)
+	: textureCache(createInfo.textureCache)
+{
+	// In descriptor binding order
+	std::array<const CachedTexture **, 3> slots{&diffuse, &occlusionRoughnessMetallic, &normal};
+
+	// The first loads fill the slots, the others are the separate maps the ORM texture is packed from when the
+	// material does not reference a pre-packed one
+	std::array<TextureLoad, 6> loads;
+	TextureLoad &packedLoad = loads[1];
+	TextureLoad &occlusionLoad = loads[3];
+	TextureLoad &roughnessLoad = loads[4];
+	TextureLoad &metallicLoad = loads[5];
+
+	loads[0].path = tinyObjMat.diffuse_texname.c_str();
+	loads[0].texture.format = albedoFormat;
+	loads[2].path = tinyObjMat.normal_texname.c_str();
+	loads[2].texture.format = normalFormat;
+	packedLoad.texture.format = ormFormat;
+	for (TextureLoad *load : {&occlusionLoad, &roughnessLoad, &metallicLoad})
+		load->texture.format = scalarFormat;
+
+	auto ormPath = tinyObjMat.unknown_parameter.find("map_ORM");
+	bool packOrm = ormPath == tinyObjMat.unknown_parameter.end();
+	if (packOrm)
+	{
+		// Without an occlusion map the red channel is left fully unoccluded
+		auto occlusionPath = tinyObjMat.unknown_parameter.find("map_AO");
+		if (occlusionPath != tinyObjMat.unknown_parameter.end())
+			occlusionLoad.path = occlusionPath->second.c_str();
+		roughnessLoad.path = tinyObjMat.roughness_texname.c_str();
+		metallicLoad.path = tinyObjMat.metallic_texname.c_str();
+	}
+	else
+	{
+		packedLoad.path = ormPath->second.c_str();
+	}
 
-	VkImageViewCreateInfo imageViewCreateInfo{};
-	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	imageViewCreateInfo.components = VkComponentMapping{};
-	imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-	imageViewCreateInfo.subresourceRange = imageSubresourceRange;
+	auto runTasks = [&createInfo](size_t count, const std::function<void(size_t)> &task) {
+		if (createInfo.threadPool)
+		{
+			createInfo.threadPool->parallelFor(count, task);
+		}
+		else
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				task(i);
+			}
+		}
+	};
+
+	// The cache is keyed by the file contents, so every file is hashed even when its texture turns out to be cached.
+	// The mapping is kept to decode or stage from on a miss.
+	runTasks(loads.size(), [&loads, &slots, &createInfo](size_t i) {
+		TextureLoad &load = loads[i];
+		if (!load.path)
+			return;
+
+		if (createInfo.compressedTextures && i < slots.size())
+			openCompressed(createInfo.physicalDevice, load.texture.format, load);
+
+		if (!load.compressed && !load.file.open(load.path))
+			throw std::runtime_error(std::string("Failed to load image: ").append(load.path));
+
+		if (load.compressed)
+			load.texture.format = load.ktxImage.format;
+		load.contentHash = hashBytes(load.file.data(), load.file.size());
+	});
+
+	if (packOrm)
+	{
+		// The packed texture is identified by the maps it is built from
+		std::array<uint64_t, 3> sourceHashes{occlusionLoad.path ? occlusionLoad.contentHash : 0,
+											 roughnessLoad.contentHash, metallicLoad.contentHash};
+		packedLoad.contentHash = hashBytes(sourceHashes.data(), sizeof(sourceHashes));
+	}
 
-	imageViewCreateInfo.image = diffuse;
-	auto res = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &diffuseView);
-	vk::resultCheck(vk::Result(res), "Could not create image view!");
+	for (const TextureLoad &load : loads)
+	{
+		if (load.fallbackReason)
+			std::cout << "Loading " << load.path << " instead of " << load.ktxPath << ", " << load.fallbackReason
+					  << std::endl;
+	}
 
-	imageViewCreateInfo.image = metallic;
-	res = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &metallicView);
-	vk::resultCheck(vk::Result(res), "Could not create image view!");
+	std::vector<TextureLoad *> misses;
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		// The same file used for two maps is only shared when both are uploaded in the same format
+		for (size_t j = 0; j < i && !loads[i].duplicateOf.has_value(); j++)
+		{
+			if (loads[j].contentHash == loads[i].contentHash && loads[j].texture.format == loads[i].texture.format &&
+				!loads[j].duplicateOf.has_value())
+				loads[i].duplicateOf = j;
+		}
+		if (loads[i].duplicateOf.has_value())
+		{
+			*slots[i] = nullptr;
+			continue;
+		}
+
+		*slots[i] = textureCache->acquire(loads[i].contentHash, loads[i].texture.format);
+		if (!*slots[i])
+			misses.push_back(&loads[i]);
+	}
 
-	imageViewCreateInfo.image = roughness;
-	res = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &roughnessView);
-	vk::resultCheck(vk::Result(res), "Could not create image view!");
+	// Only files are decoded, a packed texture that has to be built needs its source maps decoded instead
+	std::vector<TextureLoad *> decodes;
+	for (TextureLoad *load : misses)
+	{
+		if (load->path)
+			decodes.push_back(load);
+	}
+	bool buildOrm = packOrm && !*slots[1] && !packedLoad.duplicateOf.has_value();
+	if (buildOrm)
+	{
+		for (TextureLoad *load : {&occlusionLoad, &roughnessLoad, &metallicLoad})
+		{
+			if (load->path)
+				decodes.push_back(load);
+		}
+	}
 
-	// imageViewCreateInfo.format = static_cast<VkFormat>(vk::Format::eR8G8B8A8Unorm);
+	// Frees the decoded texels and drops the cache references the slots hold when loading fails partway
+	auto releaseLoads = [this, &loads, &slots]() {
+		for (TextureLoad &load : loads)
+			free(reinterpret_cast<void *>(load.texels));
+		for (const CachedTexture **slot : slots)
+		{
+			if (*slot)
+				textureCache->release(*slot);
+		}
+	};
+
+	std::vector<TextureLoad *> mipChains;
+	auto decodeStartTime = std::chrono::high_resolution_clock::now();
+	auto mipStartTime = decodeStartTime;
+
+	try
+	{
+		runTasks(decodes.size(), [&decodes](size_t i) {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			decodeImage(*decodes[i]);
+			decodes[i]->decodeMilliseconds = millisecondsSince(startTime);
+		});
+
+		if (buildOrm)
+			packOcclusionRoughnessMetallic(occlusionLoad, roughnessLoad, metallicLoad, packedLoad);
+
+		// After packing, so the ORM texture gets its chain on the workers as well
+		if (createInfo.cpuMipMaps)
+		{
+			for (TextureLoad *load : misses)
+			{
+				if (!load->compressed)
+					mipChains.push_back(load);
+			}
+		}
+
+		mipStartTime = std::chrono::high_resolution_clock::now();
+		runTasks(mipChains.size(), [&mipChains](size_t i) {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			generateMipChain(*mipChains[i]);
+			mipChains[i]->mipMilliseconds = millisecondsSince(startTime);
+		});
+	}
+	catch (...)
+	{
+		releaseLoads();
+		throw;
+	}
 
-	imageViewCreateInfo.image = normal;
-	res = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &normalView);
-	vk::resultCheck(vk::Result(res), "Could not create image view!");
-}
+	float decodeWallMilliseconds =
+		std::chrono::duration<float, std::chrono::milliseconds::period>(mipStartTime - decodeStartTime).count();
+	float mipWallMilliseconds = millisecondsSince(mipStartTime);
+
+	if (!misses.empty())
+	{
+		// If the upload fails, the images of the textures that are not in the cache yet and the staging buffer are
+		// destroyed here, the inserted and acquired textures are released through their slots. Copies already staged
+		// on the uploader are submitted and waited for first, so they do not write into destroyed images.
+		size_t createdImages = 0;
+		size_t insertedTextures = 0;
+		bool staged = false;
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VmaAllocation stagingAllocation = VK_NULL_HANDLE;
+		float submitMilliseconds = 0.f;
+
+		try
+		{
+			// Textures with every resident level staged go through the uploader's queue along with the meshes of the
+			// model. Only the textures whose mips are blitted need the graphics queue.
+			std::vector<TextureLoad *> blitted;
+			vk::DeviceSize stagingSize = 0;
+			for (TextureLoad *load : misses)
+			{
+				load->texture.contentHash = load->contentHash;
+				// Streamed textures keep their chain and start out with only the levels up to the streamer's base size
+				if (load->prebuiltMips && createInfo.textureStreamer)
+				{
+					load->texture.firstResidentLevel = createInfo.textureStreamer->getBaseLevel(load->texture);
+					keepMipChain(*load);
+				}
+				TextureCache::createImage(createInfo.vmaAllocator, createInfo.device, !load->prebuiltMips,
+										  load->texture);
+				createdImages++;
+
+				if (!load->prebuiltMips)
+				{
+					load->stagingOffset = stagingSize;
+					stagingSize += getChainSize(load->texture, 0, 1);
+					blitted.push_back(load);
+				}
+			}
+
+			for (TextureLoad *load : misses)
+			{
+				if (!load->prebuiltMips)
+					continue;
+
+				auto startTime = std::chrono::high_resolution_clock::now();
+				CachedTexture &texture = load->texture;
+
+				// Level 0 of the image is the first resident level of the chain. Block compressed levels that are not
+				// streamed go to the GPU exactly as they are stored in the file.
+				auto write = [load](void *mapped, uint32_t level, vk::DeviceSize offset, vk::DeviceSize size) {
+					const CachedTexture &texture = load->texture;
+					const unsigned char *source;
+					if (texture.chain)
+					{
+						uint32_t chainLevel = texture.firstResidentLevel + level;
+						source = texture.chain.get() + TextureLayout::getChainOffset(texture.format, texture.width,
+																					 texture.height, chainLevel);
+					}
+					else if (load->compressed)
+					{
+						source = load->file.data() + load->ktxImage.levels[level].offset;
+					}
+					else
+					{
+						source = load->texels +
+								 TextureLayout::getChainOffset(texture.format, texture.width, texture.height, level);
+					}
+					memcpy(mapped, source + offset, size);
+				};
+
+				staged = true;
+				uint32_t width = TextureLayout::getLevelExtent(texture.width, texture.firstResidentLevel);
+				uint32_t height = TextureLayout::getLevelExtent(texture.height, texture.firstResidentLevel);
+				texture.uploadTimelineValue = createInfo.stagingUploader->uploadImage(
+					texture.image, texture.format, width, height, texture.getResidentLevels(), write,
+					texture.acquireBarrier);
+
+				if (load->compressed)
+					load->file.close();
+				free(reinterpret_cast<void *>(load->texels));
+				load->texels = nullptr;
+				load->stagingMilliseconds = millisecondsSince(startTime);
+			}
+
+			if (!blitted.empty())
+			{
+				// One staging buffer for the textures blitted on the GPU so they are uploaded with a single submit
+				VkBufferCreateInfo bufferCreateInfo{};
+				bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+				bufferCreateInfo.size = stagingSize;
+
+				VmaAllocationCreateInfo allocationCreateInfo{};
+				allocationCreateInfo.flags =
+					VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_MAPPED_BIT |
+					VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+				allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+
+				VmaAllocationInfo allocInfo;
+
+				auto res = vmaCreateBuffer(createInfo.vmaAllocator, &bufferCreateInfo, &allocationCreateInfo,
+										   &stagingBuffer, &stagingAllocation, &allocInfo);
+				vk::resultCheck(vk::Result(res), "Could not create buffer!");
+
+				for (TextureLoad *load : blitted)
+				{
+					auto startTime = std::chrono::high_resolution_clock::now();
+					const CachedTexture &texture = load->texture;
+					unsigned char *staging = static_cast<unsigned char *>(allocInfo.pMappedData) + load->stagingOffset;
+					memcpy(staging, load->texels,
+						   TextureLayout::getLevelSize(texture.format, texture.width, texture.height));
+					free(reinterpret_cast<void *>(load->texels));
+					load->texels = nullptr;
+					load->stagingMilliseconds = millisecondsSince(startTime);
+				}
+				vmaFlushAllocation(createInfo.vmaAllocator, stagingAllocation, 0, VK_WHOLE_SIZE);
+
+				auto submitStartTime = std::chrono::high_resolution_clock::now();
+
+				CommandBuffer::beginSTC(createInfo.commandBuffer);
+				recordUploads(createInfo.commandBuffer, stagingBuffer, blitted);
+				recordMipMaps(createInfo.commandBuffer, blitted);
+				CommandBuffer::endSTC(createInfo.commandBuffer, createInfo.queue);
+
+				submitMilliseconds = millisecondsSince(submitStartTime);
+
+				vmaDestroyBuffer(createInfo.vmaAllocator, stagingBuffer, stagingAllocation);
+				stagingBuffer = VK_NULL_HANDLE;
+			}
+
+			for (; insertedTextures < misses.size(); insertedTextures++)
+			{
+				TextureLoad *load = misses[insertedTextures];
+				*slots[load - loads.data()] = textureCache->insert(std::move(load->texture));
+			}
+		}
+		catch (...)
+		{
+			if (staged)
+				createInfo.stagingUploader->flush();
+			if (stagingBuffer != VK_NULL_HANDLE)
+				vmaDestroyBuffer(createInfo.vmaAllocator, stagingBuffer, stagingAllocation);
+			for (size_t i = insertedTextures; i < createdImages; i++)
+			{
+				vkDestroyImageView(createInfo.device, misses[i]->texture.view, nullptr);
+				vmaDestroyImage(createInfo.vmaAllocator, misses[i]->texture.image, misses[i]->texture.allocation);
+			}
+			releaseLoads();
+			throw;
+		}
+
+		// Decode runs per texture on the workers, staged chains go out with the model's upload batch and the textures
+		// with blitted mips share one graphics queue submit
+		for (const TextureLoad *load : misses)
+		{
+			std::string name = load->compressed ? load->ktxPath
+							   : load->path	   ? load->path
+											   : tinyObjMat.name + " occlusion, roughness and metallic";
+			std::cout << "Texture " << name << " (" << load->texture.width
+					  << "x" << load->texture.height << ", " << vk::to_string(load->texture.format) << "): ";
+			if (load->compressed)
+				std::cout << load->texture.mipLevels << " pre-built mip levels";
+			else
+				std::cout << "decoded in " << load->decodeMilliseconds << " milliseconds";
+			if (load->prebuiltMips && !load->compressed)
+				std::cout << ", mip chain generated in " << load->mipMilliseconds << " milliseconds";
+			if (load->texture.firstResidentLevel > 0)
+				std::cout << ", streamed from level " << load->texture.firstResidentLevel;
+			std::cout << ", staged in " << load->stagingMilliseconds << " milliseconds" << std::endl;
+		}
+		std::cout << "Material " << tinyObjMat.name << ": decoding took " << decodeWallMilliseconds
+				  << " milliseconds, generating mip maps on the CPU took " << mipWallMilliseconds
+				  << " milliseconds, the mip blit submit took " << submitMilliseconds << " milliseconds" << std::endl;
+	}
 
-void Material::destroy(const VmaAllocator &allocator, const vk::Device &device)
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (loads[i].duplicateOf.has_value())
+			*slots[i] = textureCache->acquire(loads[i].contentHash, loads[i].texture.format);
+	}
 
+	std::cout << "Material " << tinyObjMat.name << ": " << slots.size() - misses.size() << " of " << slots.size()
+			  << " textures were already loaded, the texture cache holds " << textureCache->size() << " textures ("
+			  << textureCache->getHits() << " hits, " << textureCache->getMisses() << " misses)" << std::endl;
+
+	// Against the same textures uploaded as RGBA8 with full mip chains, which is how every map used to be stored
+	vk::DeviceSize textureMemory = 0;
+	vk::DeviceSize rgba8Memory = 0;
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (loads[i].duplicateOf.has_value())
+			continue;
+
+		const CachedTexture &texture = **slots[i];
+		textureMemory += TextureLayout::getMemorySize(texture.format, texture.width, texture.height, 0,
+													  texture.mipLevels);
+		rgba8Memory += TextureLayout::getMemorySize(
+			vk::Format::eR8G8B8A8Unorm, texture.width, texture.height, 0,
+			static_cast<uint32_t>(std::bit_width(std::max(texture.width, texture.height))));
+	}
+	std::cout << "Material " << tinyObjMat.name << ": textures take " << textureMemory / 1024 << " KiB, "
+			  << (rgba8Memory - textureMemory) / 1024 << " KiB less than as RGBA8" << std::endl;
+}
+
+void Material::destroy(const vk::Device &device)
 {
-	device.destroySampler(sampler);
+	samplerCache->release(sampler);
 
-	vkDestroyImageView(device, diffuseView, nullptr);
-	vkDestroyImageView(device, metallicView, nullptr);
-	vkDestroyImageView(device, roughnessView, nullptr);
-	vkDestroyImageView(device, normalView, nullptr);
+	for (const CachedTexture *texture : {diffuse, occlusionRoughnessMetallic, normal})
+	{
+		textureCache->release(texture);
+	}
 
-	vmaDestroyImage(allocator, diffuse, diffuseAlloc);
-	vmaDestroyImage(allocator, metallic, metallicAlloc);
-	vmaDestroyImage(allocator, roughness, roughnessAlloc);
-	vmaDestroyImage(allocator, normal, normalAlloc);
+	device.freeDescriptorSets(descriptorPool, descriptorSets);
+	descriptorSets.clear();
 }
 
-std::tuple<VkImage, VmaAllocation> Material::loadImage(const VmaAllocator &allocator, const vk::Queue &queue,
-													   const vk::CommandBuffer &commandBuffer, vk::Format format,
-													   const char *path)
+void Material::openCompressed(const vk::PhysicalDevice &physicalDevice, vk::Format slotFormat, TextureLoad &load)
 {
-	int loadedWidth, loadedHeight, channels;
-	unsigned char *data = stbi_load(path, &loadedWidth, &loadedHeight, &channels, 4);
-	height = static_cast<uint32_t>(loadedHeight);
-	width = static_cast<uint32_t>(loadedWidth);
-
-	if (!data)
-	{
-		throw std::runtime_error(std::string("Failed to load image: ").append(path));
-	}
-
-	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height))) + 1);
-
-	VkBufferCreateInfo bufferCreateInfo{};
-	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	// FIXME: not sure if this is right
-	bufferCreateInfo.size = width * height * 4;
-
-	VmaAllocationCreateInfo allocationCreateInfo{};
-	allocationCreateInfo.flags = VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_MAPPED_BIT |
-								 VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-	allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
-
-	VkBuffer stagingBuffer;
-	VmaAllocation stagingAllocation;
-	VmaAllocationInfo allocInfo;
-
-	auto res = vmaCreateBuffer(allocator, &bufferCreateInfo, &allocationCreateInfo, &stagingBuffer, &stagingAllocation,
-							   &allocInfo);
-	vk::resultCheck(vk::Result(res), "Could not create buffer!");
-
-	memcpy(allocInfo.pMappedData, data, bufferCreateInfo.size);
-
-	VkExtent3D extent;
-	extent.depth = 1;
-	extent.width = width;
-	extent.height = height;
-
-	VkImageCreateInfo imageCreateInfo{};
-	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageCreateInfo.arrayLayers = 1;
-	imageCreateInfo.extent = extent;
-	imageCreateInfo.format = static_cast<VkFormat>(format);
-	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageCreateInfo.mipLevels = mipLevels;
-	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCreateInfo.usage =
-		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-	VmaAllocationCreateInfo imageAllocationCreateInfo{};
-	imageAllocationCreateInfo.flags = VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-	imageAllocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-
-	VkImage image;
-	VmaAllocation imageAllocation;
-
-	res = vmaCreateImage(allocator, &imageCreateInfo, &imageAllocationCreateInfo, &image, &imageAllocation, nullptr);
-	vk::resultCheck(vk::Result(res), "Could not create buffer!");
-
-	// Transition to transfer dst
-
-	VkImageSubresourceRange imageSubresourceRange{};
-	imageSubresourceRange.baseArrayLayer = 0;
-	imageSubresourceRange.baseMipLevel = 0;
-	imageSubresourceRange.layerCount = 1;
-	imageSubresourceRange.levelCount = mipLevels;
-	imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-
-	VkImageMemoryBarrier imageMemoryBarrier{};
-	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imageMemoryBarrier.image = image;
-	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageMemoryBarrier.srcAccessMask = VK_ACCESS_NONE;
-	imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	imageMemoryBarrier.subresourceRange = imageSubresourceRange;
-
-	CommandBuffer::beginSTC(commandBuffer);
+	load.ktxPath = KtxFile::getPath(load.path);
+	if (!load.file.open(load.ktxPath.c_str()))
+		return;
 
-	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
-								  vk::DependencyFlagBits::eByRegion, nullptr, nullptr,
-								  vk::ImageMemoryBarrier(imageMemoryBarrier));
+	if (!KtxFile::parse(load.file.data(), load.file.size(), load.ktxImage, load.fallbackReason))
+	{
+		load.file.close();
+		return;
+	}
 
-	CommandBuffer::endSTC(commandBuffer, queue);
+	load.fallbackReason = getSlotMismatch(slotFormat, load.ktxImage.format);
+	if (load.fallbackReason)
+	{
+		load.file.close();
+		return;
+	}
 
-	//
+	// Format features are reported whether or not textureCompressionBC is enabled, enabling it is what makes using BC
+	// formats valid. The renderer enables it whenever the device supports it, this checks the device can sample and
+	// upload the format at all.
+	vk::FormatFeatureFlags requiredFeatures = vk::FormatFeatureFlagBits::eSampledImage |
+											  vk::FormatFeatureFlagBits::eSampledImageFilterLinear |
+											  vk::FormatFeatureFlagBits::eTransferDst;
+	if ((physicalDevice.getFormatProperties(load.ktxImage.format).optimalTilingFeatures & requiredFeatures) !=
+		requiredFeatures)
+	{
+		load.fallbackReason = "the device cannot sample its format";
+		load.file.close();
+		return;
+	}
 
-	// Copy image data
-	CommandBuffer::beginSTC(commandBuffer);
+	load.compressed = true;
+	load.prebuiltMips = true;
+}
 
-	vk::ImageSubresourceLayers imageSubresourceLayers{};
-	imageSubresourceLayers.setMipLevel(0);
-	imageSubresourceLayers.setLayerCount(1);
-	imageSubresourceLayers.setBaseArrayLayer(0);
-	imageSubresourceLayers.setAspectMask(vk::ImageAspectFlagBits::eColor);
+void Material::decodeImage(TextureLoad &load)
+{
+	if (load.compressed)
+	{
+		load.texture.width = load.ktxImage.width;
+		load.texture.height = load.ktxImage.height;
+		load.texture.mipLevels = static_cast<uint32_t>(load.ktxImage.levels.size());
+		return;
+	}
+
+	// stb_image turns RGB into grey and alpha when asked for two channels, so two channel maps are decoded as RGBA
+	// and their red and green kept. A single channel is the luminance, which for a greyscale map stored as RGB is its
+	// value.
+	uint32_t texelSize = TextureLayout::getTexelSize(load.texture.format);
+	int decodedChannels = texelSize == 2 ? 4 : static_cast<int>(texelSize);
+
+	int loadedWidth, loadedHeight, channels;
+	load.texels = stbi_load_from_memory(load.file.data(), static_cast<int>(load.file.size()), &loadedWidth,
+										&loadedHeight, &channels, decodedChannels);
+	load.file.close();
+
+	if (!load.texels)
+	{
+		throw std::runtime_error(std::string("Failed to load image: ").append(load.path));
+	}
 
-	vk::BufferImageCopy bufferImageCopy{};
-	bufferImageCopy.setImageSubresource(imageSubresourceLayers);
-	bufferImageCopy.setImageExtent(vk::Extent3D(width, height, 1));
-	bufferImageCopy.setImageOffset(vk::Offset3D(0, 0, 0));
+	load.texture.width = static_cast<uint32_t>(loadedWidth);
+	load.texture.height = static_cast<uint32_t>(loadedHeight);
 
-	commandBuffer.copyBufferToImage(stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal, bufferImageCopy);
+	if (texelSize == 2)
+	{
+		// In place, every texel moves to an offset at or before the one it is read from
+		size_t texelCount = static_cast<size_t>(load.texture.width) * load.texture.height;
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			load.texels[i * 2] = load.texels[i * 4];
+			load.texels[i * 2 + 1] = load.texels[i * 4 + 1];
+		}
+	}
+	load.texture.mipLevels =
+		static_cast<uint32_t>(std::floor(std::log2(std::max(load.texture.width, load.texture.height))) + 1);
+}
 
-	CommandBuffer::endSTC(commandBuffer, queue);
-	//
+void Material::packOcclusionRoughnessMetallic(TextureLoad &occlusion, TextureLoad &roughness,
+											  TextureLoad &metallic, TextureLoad &packed)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
 
-	// Transfer from transfer dst to shader optimal
-	// Commented out because we do this while generating mip maps
-	/* CommandBuffer::beginSTC(commandBuffer);
+	// Sized after the largest map, smaller maps are sampled nearest
+	uint32_t width = std::max(roughness.texture.width, metallic.texture.width);
+	uint32_t height = std::max(roughness.texture.height, metallic.texture.height);
+	if (occlusion.texels)
+	{
+		width = std::max(width, occlusion.texture.width);
+		height = std::max(height, occlusion.texture.height);
+	}
 
-	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	packed.texture.width = width;
+	packed.texture.height = height;
+	packed.texture.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height))) + 1);
+	packed.texels = static_cast<unsigned char *>(malloc(static_cast<size_t>(width) * height * 4));
+	if (!packed.texels)
+		throw std::runtime_error("Failed to allocate a packed texture");
+
+	// The maps are decoded to a single channel
+	auto sample = [width, height](const TextureLoad &source, uint32_t x, uint32_t y) {
+		uint32_t sourceX = static_cast<uint32_t>(static_cast<uint64_t>(x) * source.texture.width / width);
+		uint32_t sourceY = static_cast<uint32_t>(static_cast<uint64_t>(y) * source.texture.height / height);
+		return source.texels[static_cast<size_t>(sourceY) * source.texture.width + sourceX];
+	};
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		unsigned char *row = packed.texels + static_cast<size_t>(y) * width * 4;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			row[x * 4] = occlusion.texels ? sample(occlusion, x, y) : 255;
+			row[x * 4 + 1] = sample(roughness, x, y);
+			row[x * 4 + 2] = sample(metallic, x, y);
+			row[x * 4 + 3] = 255;
+		}
+	}
 
-	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	float packMilliseconds = millisecondsSince(startTime);
+	packed.decodeMilliseconds =
+		occlusion.decodeMilliseconds + roughness.decodeMilliseconds + metallic.decodeMilliseconds + packMilliseconds;
 
-	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-								  vk::DependencyFlagBits::eByRegion, 0, 0, vk::ImageMemoryBarrier(imageMemoryBarrier));
+	for (TextureLoad *source : {&occlusion, &roughness, &metallic})
+	{
+		free(reinterpret_cast<void *>(source->texels));
+		source->texels = nullptr;
+	}
+}
 
-	CommandBuffer::endSTC(commandBuffer, queue); */
-	//
+void Material::generateMipChain(TextureLoad &load)
+{
+	const CachedTexture &texture = load.texture;
+	vk::DeviceSize chainSize = getChainSize(texture, 0, texture.mipLevels);
+	unsigned char *chain = static_cast<unsigned char *>(realloc(load.texels, chainSize));
+	if (!chain)
+		throw std::runtime_error("Failed to allocate a mip chain");
+	load.texels = chain;
+
+	uint32_t texelSize = TextureLayout::getTexelSize(texture.format);
+	TexelContent content = getTexelContent(texture.format);
+
+	// Level 0 stays where it was decoded to, every other level is filtered from the one above it
+	unsigned char *level = chain;
+	for (uint32_t i = 1; i < texture.mipLevels; i++)
+	{
+		uint32_t width = TextureLayout::getLevelExtent(texture.width, i - 1);
+		uint32_t height = TextureLayout::getLevelExtent(texture.height, i - 1);
+		unsigned char *nextLevel =
+			level + TextureLayout::align(TextureLayout::getLevelSize(texture.format, width, height));
+		MipGenerator::downsample(level, width, height, texelSize, content, nextLevel);
+		level = nextLevel;
+	}
 
-	generateMipMaps(queue, commandBuffer, image);
+	load.prebuiltMips = true;
+}
 
-	free(reinterpret_cast<void *>(data));
+void Material::keepMipChain(TextureLoad &load)
+{
+	CachedTexture &texture = load.texture;
+	if (!load.compressed)
+	{
+		texture.chain.reset(load.texels);
+		load.texels = nullptr;
+		return;
+	}
 
-	vmaDestroyBuffer(allocator, stagingBuffer, stagingAllocation);
+	// The levels of a KTX2 file are packed tighter than the chain, which keeps every level aligned
+	texture.chain.reset(static_cast<unsigned char *>(malloc(getChainSize(texture, 0, texture.mipLevels))));
+	if (!texture.chain)
+		throw std::runtime_error("Failed to allocate a mip chain");
 
-	return std::make_tuple(image, imageAllocation);
+	for (uint32_t level = 0; level < texture.mipLevels; level++)
+	{
+		const KtxLevel &ktxLevel = load.ktxImage.levels[level];
+		memcpy(texture.chain.get() +
+				   TextureLayout::getChainOffset(texture.format, texture.width, texture.height, level),
+			   load.file.data() + ktxLevel.offset, ktxLevel.size);
+	}
+	load.file.close();
 }
 
-void Material::generateMipMaps(const vk::Queue &queue, const vk::CommandBuffer &commandBuffer, const vk::Image &image)
+void Material::recordUploads(const vk::CommandBuffer &commandBuffer, const vk::Buffer &stagingBuffer,
+							 const std::vector<TextureLoad *> &loads)
 {
-	CommandBuffer::beginSTC(commandBuffer);
+	std::vector<vk::ImageMemoryBarrier> barriers;
+	for (const TextureLoad *load : loads)
+	{
+		vk::ImageMemoryBarrier barrier{};
+		barrier.setImage(load->texture.image);
+		barrier.setSubresourceRange({vk::ImageAspectFlagBits::eColor, 0, load->texture.getResidentLevels(), 0, 1});
+		barrier.setOldLayout(vk::ImageLayout::eUndefined);
+		barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barriers.push_back(barrier);
+	}
 
-	vk::ImageSubresourceRange isr{};
-	isr.setAspectMask(vk::ImageAspectFlagBits::eColor);
-	isr.setLayerCount(1);
-	isr.setLevelCount(1);
-	isr.setBaseArrayLayer(0);
+	// Every level of every texture goes to transfer dst at once, the blits fill in the rest
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+								  vk::DependencyFlagBits::eByRegion, nullptr, nullptr, barriers);
+
+	for (const TextureLoad *load : loads)
+	{
+		vk::ImageSubresourceLayers imageSubresourceLayers{};
+		imageSubresourceLayers.setMipLevel(0);
+		imageSubresourceLayers.setLayerCount(1);
+		imageSubresourceLayers.setBaseArrayLayer(0);
+		imageSubresourceLayers.setAspectMask(vk::ImageAspectFlagBits::eColor);
+
+		vk::BufferImageCopy bufferImageCopy{};
+		bufferImageCopy.setBufferOffset(load->stagingOffset);
+		bufferImageCopy.setImageSubresource(imageSubresourceLayers);
+		bufferImageCopy.setImageExtent(vk::Extent3D(load->texture.width, load->texture.height, 1));
+		bufferImageCopy.setImageOffset(vk::Offset3D(0, 0, 0));
+
+		commandBuffer.copyBufferToImage(stagingBuffer, load->texture.image, vk::ImageLayout::eTransferDstOptimal,
+										bufferImageCopy);
+	}
+}
+
+void Material::recordMipMaps(const vk::CommandBuffer &commandBuffer, const std::vector<TextureLoad *> &loads)
+{
+	uint32_t maxMipLevels = 0;
+	for (const TextureLoad *load : loads)
+	{
+		maxMipLevels = std::max(maxMipLevels, load->texture.mipLevels);
+	}
 
 	vk::ImageMemoryBarrier barrier{};
-	barrier.setImage(image);
+	barrier.setSubresourceRange({vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
 
-	int32_t mipWidth = width;
-	int32_t mipHeight = height;
+	std::vector<vk::ImageMemoryBarrier> toSource;
+	std::vector<vk::ImageMemoryBarrier> toShader;
 
-	for (uint32_t i = 1; i < mipLevels; i++)
+	// Level by level across all textures, so each step costs two barrier calls no matter how many textures there are
+	for (uint32_t i = 1; i < maxMipLevels; i++)
 	{
-		isr.setBaseMipLevel(i - 1);
-		barrier.setSubresourceRange(isr);
-		barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
-		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
-		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
-		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		toSource.clear();
+		toShader.clear();
+
+		barrier.subresourceRange.setBaseMipLevel(i - 1);
+		for (const TextureLoad *load : loads)
+		{
+			if (i >= load->texture.mipLevels)
+				continue;
+
+			barrier.setImage(load->texture.image);
+			barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+			barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+			toSource.push_back(barrier);
+
+			barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+			barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			toShader.push_back(barrier);
+		}
+
 		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
-									  vk::DependencyFlagBits::eByRegion, nullptr, nullptr, barrier);
-
-		vk::ImageBlit blit{};
-
-		std::array<vk::Offset3D, 2> srcOffset;
-		srcOffset[0] = vk::Offset3D{0, 0, 0};
-		srcOffset[1] = vk::Offset3D{mipWidth, mipHeight, 1};
-		blit.setSrcOffsets(srcOffset);
-
-		vk::ImageSubresourceLayers srcLayers{};
-		srcLayers.setMipLevel(i - 1);
-		srcLayers.setLayerCount(1);
-		srcLayers.setBaseArrayLayer(0);
-		srcLayers.setAspectMask(vk::ImageAspectFlagBits::eColor);
-		blit.setSrcSubresource(srcLayers);
-
-		std::array<vk::Offset3D, 2> dstOffset;
-		dstOffset[0] = vk::Offset3D{0, 0, 0};
-		dstOffset[1] = vk::Offset3D{mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
-		blit.setDstOffsets(dstOffset);
-
-		vk::ImageSubresourceLayers dstLayers{};
-		dstLayers.setAspectMask(vk::ImageAspectFlagBits::eColor);
-		dstLayers.setBaseArrayLayer(0);
-		dstLayers.setLayerCount(1);
-		dstLayers.setMipLevel(i);
-		blit.setDstSubresource(dstLayers);
-
-		commandBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image,
-								vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
-
-		barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
-		barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
-		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+									  vk::DependencyFlagBits::eByRegion, nullptr, nullptr, toSource);
+
+		for (const TextureLoad *load : loads)
+		{
+			if (i >= load->texture.mipLevels)
+				continue;
+
+			int32_t mipWidth = std::max(static_cast<int32_t>(load->texture.width >> (i - 1)), 1);
+			int32_t mipHeight = std::max(static_cast<int32_t>(load->texture.height >> (i - 1)), 1);
+
+			vk::ImageBlit blit{};
+
+			std::array<vk::Offset3D, 2> srcOffset;
+			srcOffset[0] = vk::Offset3D{0, 0, 0};
+			srcOffset[1] = vk::Offset3D{mipWidth, mipHeight, 1};
+			blit.setSrcOffsets(srcOffset);
+
+			vk::ImageSubresourceLayers srcLayers{};
+			srcLayers.setMipLevel(i - 1);
+			srcLayers.setLayerCount(1);
+			srcLayers.setBaseArrayLayer(0);
+			srcLayers.setAspectMask(vk::ImageAspectFlagBits::eColor);
+			blit.setSrcSubresource(srcLayers);
+
+			std::array<vk::Offset3D, 2> dstOffset;
+			dstOffset[0] = vk::Offset3D{0, 0, 0};
+			dstOffset[1] = vk::Offset3D{mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
+			blit.setDstOffsets(dstOffset);
+
+			vk::ImageSubresourceLayers dstLayers{};
+			dstLayers.setAspectMask(vk::ImageAspectFlagBits::eColor);
+			dstLayers.setBaseArrayLayer(0);
+			dstLayers.setLayerCount(1);
+			dstLayers.setMipLevel(i);
+			blit.setDstSubresource(dstLayers);
+
+			commandBuffer.blitImage(load->texture.image, vk::ImageLayout::eTransferSrcOptimal, load->texture.image,
+									vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+		}
 
 		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-									  vk::DependencyFlagBits::eByRegion, nullptr, nullptr, barrier);
-
-		if (mipWidth > 1)
-			mipWidth /= 2;
-		if (mipHeight > 1)
-			mipHeight /= 2;
+									  vk::DependencyFlagBits::eByRegion, nullptr, nullptr, toShader);
 	}
 
-	isr.setBaseMipLevel(mipLevels - 1);
-	barrier.setSubresourceRange(isr);
-	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
-	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-	barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
-	barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	// The last level was only ever written to
+	toShader.clear();
+	for (const TextureLoad *load : loads)
+	{
+		barrier.setImage(load->texture.image);
+		barrier.subresourceRange.setBaseMipLevel(load->texture.mipLevels - 1);
+		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+		toShader.push_back(barrier);
+	}
 
 	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-								  vk::DependencyFlagBits::eByRegion, nullptr, nullptr, barrier);
-
-	CommandBuffer::endSTC(commandBuffer, queue);
+								  vk::DependencyFlagBits::eByRegion, nullptr, nullptr, toShader);
 }
 
-void Material::createSampler(const vk::Device &device, float maxAnisotropy)
+void Material::createSampler(SamplerCache &samplerCache, float maxAnisotropy)
 {
-	vk::SamplerCreateInfo samplerCreateInfo{};
-	samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
-	samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
-	samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
-	samplerCreateInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
-	samplerCreateInfo.setAnisotropyEnable(vk::True);
-	samplerCreateInfo.setCompareEnable(vk::False);
-	samplerCreateInfo.setCompareOp(vk::CompareOp::eAlways);
-	samplerCreateInfo.setUnnormalizedCoordinates(vk::False);
-	samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eLinear);
-	samplerCreateInfo.setMagFilter(vk::Filter::eLinear);
-	samplerCreateInfo.setMinFilter(vk::Filter::eLinear);
-	samplerCreateInfo.setMaxAnisotropy(maxAnisotropy);
-	samplerCreateInfo.setMaxLod(mipLevels);
-	samplerCreateInfo.setMinLod(0.f);
-	this->sampler = device.createSampler(samplerCreateInfo);
+	// Every level of the views is sampled, so the LOD is left unclamped and all materials share the same state
+	SamplerState samplerState{};
+	samplerState.addressMode = vk::SamplerAddressMode::eClampToEdge;
+	samplerState.maxAnisotropy = maxAnisotropy;
+
+	this->samplerCache = &samplerCache;
+	sampler = samplerCache.acquire(samplerState);
 }
 
 void Material::bind(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout) const
@@ -330,32 +824,58 @@ void Material::bind(const vk::CommandBuffer &commandBuffer, const vk::PipelineLa
 
 void Material::createDescriptorSets(const vk::Device &device, const vk::DescriptorPool &pool,
 									const vk::DescriptorSetLayout &setLayout)
+{
+	descriptorPool = pool;
+	descriptorSetLayout = setLayout;
+	writeDescriptorSets(device);
+}
+
+void Material::refreshDescriptorSets(const vk::Device &device, DeletionQueue &deletionQueue, uint64_t timelineValue)
+{
+	if (boundViews == std::array<VkImageView, 3>{diffuse->view, occlusionRoughnessMetallic->view, normal->view})
+		return;
+
+	// Frames still in flight may have bound the old sets, a set cannot be updated while it is in use
+	deletionQueue.push(timelineValue, [device, pool = descriptorPool, sets = std::move(descriptorSets)]() {
+		device.freeDescriptorSets(pool, sets);
+	});
+	writeDescriptorSets(device);
+}
+
+void Material::requestTextures(TextureStreamer &textureStreamer, float pixels) const
+{
+	for (const CachedTexture *texture : {diffuse, occlusionRoughnessMetallic, normal})
+		textureStreamer.request(texture, pixels);
+}
+
+void Material::trackTextures(TextureStreamer &textureStreamer) const
+{
+	for (const CachedTexture *texture : {diffuse, occlusionRoughnessMetallic, normal})
+		textureStreamer.track(texture);
+}
+
+void Material::writeDescriptorSets(const vk::Device &device)
 {
 	vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{};
-	descriptorSetAllocateInfo.setDescriptorPool(pool);
-	descriptorSetAllocateInfo.setSetLayouts(setLayout);
+	descriptorSetAllocateInfo.setDescriptorPool(descriptorPool);
+	descriptorSetAllocateInfo.setSetLayouts(descriptorSetLayout);
 
 	descriptorSets = device.allocateDescriptorSets(descriptorSetAllocateInfo);
 
 	vk::DescriptorImageInfo diffuseImageInfo;
 	diffuseImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
 	diffuseImageInfo.setSampler(sampler);
-	diffuseImageInfo.setImageView(diffuseView);
-
-	vk::DescriptorImageInfo metallicImageInfo;
-	metallicImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	metallicImageInfo.setSampler(sampler);
-	metallicImageInfo.setImageView(metallicView);
+	diffuseImageInfo.setImageView(diffuse->view);
 
-	vk::DescriptorImageInfo roughnessImageInfo;
-	roughnessImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	roughnessImageInfo.setSampler(sampler);
-	roughnessImageInfo.setImageView(roughnessView);
+	vk::DescriptorImageInfo ormImageInfo;
+	ormImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	ormImageInfo.setSampler(sampler);
+	ormImageInfo.setImageView(occlusionRoughnessMetallic->view);
 
 	vk::DescriptorImageInfo normalImageInfo;
 	normalImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
 	normalImageInfo.setSampler(sampler);
-	normalImageInfo.setImageView(normalView);
+	normalImageInfo.setImageView(normal->view);
 
 	vk::WriteDescriptorSet writeDiffuse{};
 	writeDiffuse.setDescriptorCount(1);
@@ -365,23 +885,19 @@ void Material::createDescriptorSets(const vk::Device &device, const vk::Descript
 	writeDiffuse.setDstSet(descriptorSets.at(0));
 	writeDiffuse.setImageInfo(diffuseImageInfo);
 
-	vk::WriteDescriptorSet writeMetallic = writeDiffuse;
-	writeMetallic.setDstBinding(1);
-	writeMetallic.setDstSet(descriptorSets.at(0));
-	writeMetallic.setImageInfo(metallicImageInfo);
-
-	vk::WriteDescriptorSet writeRoughness = writeDiffuse;
-	writeRoughness.setDstBinding(2);
-	writeRoughness.setDstSet(descriptorSets.at(0));
-	writeRoughness.setImageInfo(roughnessImageInfo);
+	vk::WriteDescriptorSet writeOrm = writeDiffuse;
+	writeOrm.setDstBinding(1);
+	writeOrm.setDstSet(descriptorSets.at(0));
+	writeOrm.setImageInfo(ormImageInfo);
 
 	vk::WriteDescriptorSet writeNormal = writeDiffuse;
-	writeNormal.setDstBinding(3);
+	writeNormal.setDstBinding(2);
 	writeNormal.setDstSet(descriptorSets.at(0));
 	writeNormal.setImageInfo(normalImageInfo);
 
-	std::array<vk::WriteDescriptorSet, 4> writeDescriptorSets{writeDiffuse, writeMetallic, writeRoughness, writeNormal};
+	std::array<vk::WriteDescriptorSet, 3> writeDescriptorSets{writeDiffuse, writeOrm, writeNormal};
 
 	device.updateDescriptorSets(writeDescriptorSets, nullptr);
+	boundViews = {diffuse->view, occlusionRoughnessMetallic->view, normal->view};
 }
 } // namespace N
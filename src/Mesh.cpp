@@ -1,23 +1,28 @@
 #include "Mesh.h"
 
-#include "CommandBuffer.h"
+#include "MeshSimplifier.h"
+#include "PBRPipeline.h"
+#include "TangentGenerator.h"
+#include "VertexDedupTable.h"
 #include <glm/gtx/dual_quaternion.hpp>
 #include <vulkan/vulkan_core.h>
 
 #include <glm/gtx/string_cast.hpp>
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 Mesh::Mesh(const tinyobj::shape_t &shape, const tinyobj::attrib_t &attrib, int materialId)
 {
 	this->materialId = materialId;
 
-	std::unordered_map<Vertex, uint16_t> uniqueVertices;
-
-	srand(time(NULL));
+	VertexDedupTable uniqueVertices(shape.mesh.indices.size());
+	indices.reserve(shape.mesh.indices.size());
 
 	for (const auto &index : shape.mesh.indices)
 	{
-		Vertex vertex;
+		Vertex vertex{};
 		vertex.pos[0] = attrib.vertices.at(3 * index.vertex_index);
 		vertex.pos[1] = attrib.vertices.at(3 * index.vertex_index + 1);
 		vertex.pos[2] = attrib.vertices.at(3 * index.vertex_index + 2);
@@ -43,125 +48,243 @@ Mesh::Mesh(const tinyobj::shape_t &shape, const tinyobj::attrib_t &attrib, int m
 			vertex.texCoords = glm::vec2(0.f);
 		}
 
-		if (uniqueVertices.count(vertex) == 0)
-		{
-			uniqueVertices[vertex] = static_cast<uint16_t>(vertices.size());
-			vertices.push_back(vertex);
-		}
+		indices.push_back(uniqueVertices.findOrInsert(vertex, vertices));
+	}
+
+	selectIndexType();
+	calcBounds();
+	TangentGenerator::generate(vertices, indices);
+
+	lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.f});
+}
+
+Mesh::Mesh(std::vector<Vertex> &&vertices, std::vector<uint32_t> &&indices, int materialId,
+		   const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, std::vector<MeshLod> &&lods)
+	: vertices(std::move(vertices)), indices(std::move(indices)), materialId(materialId), boundsMin(boundsMin),
+	  boundsMax(boundsMax), lods(std::move(lods))
+{
+	selectIndexType();
 
-		indices.push_back(uniqueVertices.at(vertex));
+	if (this->lods.empty())
+		this->lods.push_back({0, static_cast<uint32_t>(this->indices.size()), 0.f});
+}
+
+void Mesh::selectIndexType()
+{
+	if (vertices.size() <= size_t{std::numeric_limits<uint16_t>::max()} + 1)
+		indexType = vk::IndexType::eUint16;
+	else
+		indexType = vk::IndexType::eUint32;
+}
+
+void Mesh::calcBounds()
+{
+	boundsMin = glm::vec3{std::numeric_limits<float>::max()};
+	boundsMax = glm::vec3{std::numeric_limits<float>::lowest()};
+
+	for (const auto &vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
 	}
+}
 
-	calcTangents();
+std::pair<VertexCacheStats, VertexCacheStats> Mesh::optimize(bool overdraw)
+{
+	VertexCacheStats before = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+
+	MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+	if (overdraw)
+		MeshOptimizer::optimizeOverdraw(indices, vertices);
+	MeshOptimizer::optimizeVertexFetch(vertices, indices);
+
+	VertexCacheStats after = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+
+	return {before, after};
 }
 
-void Mesh::calcTangents()
+void Mesh::buildLods(uint32_t maxLevels, float maxRelativeError)
 {
-	for (int i = 0; i < indices.size(); i += 3)
+	// Below this there is little vertex work left to save
+	constexpr size_t minLodTriangles = 64;
+	// A level has to drop at least this fraction of the previous one to be worth its index memory
+	constexpr float minReduction = 0.1f;
+
+	float maxError = glm::length(boundsMax - boundsMin) * maxRelativeError;
+
+	std::vector<uint32_t> lodIndices(indices.begin() + lods.back().indexOffset,
+									 indices.begin() + lods.back().indexOffset + lods.back().indexCount);
+	float lodError = lods.back().error;
+
+	while (lods.size() < maxLevels && lodIndices.size() / 3 > minLodTriangles)
 	{
-		auto &vert1 = vertices.at(indices.at(i));
-		auto &vert2 = vertices.at(indices.at(i + 1));
-		auto &vert3 = vertices.at(indices.at(i + 2));
+		size_t targetIndexCount = lodIndices.size() / 6 * 3;
 
-		glm::vec3 edge1 = vert2.pos - vert1.pos;
-		glm::vec3 edge2 = vert3.pos - vert1.pos;
-		glm::vec2 deltaUV1 = vert2.texCoords - vert1.texCoords;
-		glm::vec2 deltaUV2 = vert3.texCoords - vert1.texCoords;
+		// Simplifying from the previous level is much cheaper than from level 0, so its error adds on top
+		float error;
+		std::vector<uint32_t> simplified =
+			MeshSimplifier::simplify(vertices, lodIndices, targetIndexCount, maxError - lodError, error);
+		if (simplified.size() > lodIndices.size() * (1.f - minReduction))
+			break;
 
-		float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+		MeshOptimizer::optimizeVertexCache(simplified, vertices.size());
 
-		glm::vec3 newTan{};
-		newTan.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-		newTan.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-		newTan.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+		lodError += error;
+		lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), lodError});
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
 
-		vert1.tangent += newTan;
-		vert2.tangent += newTan;
-		vert3.tangent += newTan;
+		lodIndices = std::move(simplified);
 	}
 }
 
-void Mesh::draw(const vk::CommandBuffer &commandBuffer) const
+uint32_t Mesh::selectLod(const glm::mat4 &model, const LodSelectInfo &lodSelectInfo) const
 {
-	bind(commandBuffer);
-	commandBuffer.drawIndexed(static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	// Conservative for non-uniform scale, the largest axis scale is applied to the error
+	float scale = std::max({glm::length(glm::vec3{model[0]}), glm::length(glm::vec3{model[1]}),
+							glm::length(glm::vec3{model[2]})});
+
+	glm::vec3 center{model * glm::vec4{(boundsMin + boundsMax) * 0.5f, 1.f}};
+	float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+
+	// The closest point of the bounding sphere decides, inside it the full resolution level is always used
+	float distance = glm::length(center - lodSelectInfo.cameraPos) - radius;
+	if (distance <= 0.f)
+		return 0;
+
+	uint32_t lod = 0;
+	while (lod + 1 < lods.size())
+	{
+		float projectedError = lods[lod + 1].error * scale / distance * lodSelectInfo.projectionScale;
+		if (projectedError > lodSelectInfo.errorThreshold)
+			break;
+		lod++;
+	}
+
+	return lod;
 }
 
-void Mesh::bind(const vk::CommandBuffer &commandBuffer) const
+float Mesh::getProjectedSize(const glm::mat4 &model, const LodSelectInfo &lodSelectInfo) const
 {
-	std::array<vk::DeviceSize, 1> offsets{0};
-	std::array<vk::Buffer, 1> vertexBuffers{vertexBuffer};
-	commandBuffer.bindVertexBuffers(0, vertexBuffers, offsets);
-	commandBuffer.bindIndexBuffer(indexBuffer, 0, vk::IndexType::eUint16);
+	float scale = std::max({glm::length(glm::vec3{model[0]}), glm::length(glm::vec3{model[1]}),
+							glm::length(glm::vec3{model[2]})});
+
+	glm::vec3 center{model * glm::vec4{(boundsMin + boundsMax) * 0.5f, 1.f}};
+	float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+
+	// Measured at the closest point of the bounding sphere, like the level of detail
+	float distance = glm::length(center - lodSelectInfo.cameraPos) - radius;
+	if (distance <= 0.f)
+		return std::numeric_limits<float>::infinity();
+
+	return 2.f * radius / distance * lodSelectInfo.projectionScale;
 }
 
-void Mesh::destroy(const VmaAllocator &vmaAllocator)
+void Mesh::buildMeshlets(uint32_t maxVertices, uint32_t maxTriangles)
 {
-	vmaDestroyBuffer(vmaAllocator, vertexBuffer, vertexBufferAllocation);
-	vmaDestroyBuffer(vmaAllocator, indexBuffer, indexBufferAllocation);
+	if (lods.size() == 1)
+	{
+		meshletData = MeshletBuilder::build(vertices, indices, maxVertices, maxTriangles);
+	}
+	else
+	{
+		std::vector<uint32_t> fullIndices(indices.begin(), indices.begin() + lods[0].indexCount);
+		meshletData = MeshletBuilder::build(vertices, fullIndices, maxVertices, maxTriangles);
+	}
+}
+
+PackedVertexDecode Mesh::calcPackedVertexDecode() const
+{
+	glm::vec2 texCoordsMin{std::numeric_limits<float>::max()};
+	glm::vec2 texCoordsMax{std::numeric_limits<float>::lowest()};
+
+	for (const auto &vertex : vertices)
+	{
+		texCoordsMin = glm::min(texCoordsMin, vertex.texCoords);
+		texCoordsMax = glm::max(texCoordsMax, vertex.texCoords);
+	}
+
+	PackedVertexDecode decode;
+	decode.positionOffset = glm::vec4{boundsMin, 0.f};
+	decode.positionScale = glm::vec4{boundsMax - boundsMin, 0.f};
+	decode.texCoordOffsetScale = glm::vec4{texCoordsMin.x, texCoordsMin.y, texCoordsMax.x - texCoordsMin.x,
+										   texCoordsMax.y - texCoordsMin.y};
+
+	return decode;
+}
+
+void Mesh::draw(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout,
+				const N::GeometryArena &geometryArena, N::GeometryBindState &bindState, uint32_t lod) const
+{
+	if (vertexFormat == VertexFormat::ePacked)
+	{
+		commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex, sizeof(N::MVPPushConstant),
+									sizeof(PackedVertexDecode), &packedVertexDecode);
+	}
+
+	geometryArena.bind(commandBuffer, bindState, geometry.block, indexType);
+
+	VkDeviceSize indexSize = indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	uint32_t firstIndex = static_cast<uint32_t>(geometry.indexOffset / indexSize) + lods[lod].indexOffset;
+	commandBuffer.drawIndexed(lods[lod].indexCount, 1, firstIndex, static_cast<int32_t>(geometry.firstVertex), 0);
 }
 
-void Mesh::uploadMesh(const VmaAllocator &vmaAllocator, const vk::Queue &queue, const vk::CommandBuffer &commandBuffer)
+void Mesh::destroy(N::GeometryArena &geometryArena)
 {
-	VkDeviceSize verticesSize = vertices.size() * sizeof(Vertex);
-	VkDeviceSize indicesSize = indices.size() * sizeof(uint16_t);
-
-	// We will allocate a buffer of the bigger size so we can use the same buffer for both indices and vertices
-	VkDeviceSize stagingBufferSize = std::max(verticesSize, indicesSize);
-
-	VkBufferCreateInfo stagingBufferCreateInfo{};
-	stagingBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	stagingBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	stagingBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	stagingBufferCreateInfo.size = stagingBufferSize;
-
-	VmaAllocationCreateInfo vmaStagingBufferAllocCreateInfo{};
-	vmaStagingBufferAllocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
-	vmaStagingBufferAllocCreateInfo.flags =
-		VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-
-	// Create the staging buffer
-	VkBuffer stagingBuffer;
-	VmaAllocation stagingBufferAllocation;
-	VmaAllocationInfo stagingBufferAllocInfo;
-	vmaCreateBuffer(vmaAllocator, &stagingBufferCreateInfo, &vmaStagingBufferAllocCreateInfo, &stagingBuffer,
-					&stagingBufferAllocation, &stagingBufferAllocInfo);
-
-	VkBufferCreateInfo vertexBufferCreateInfo{};
-	vertexBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	vertexBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	vertexBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-	vertexBufferCreateInfo.size = verticesSize;
-
-	VmaAllocationCreateInfo vmaAllocCreateInfo{};
-	vmaAllocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-
-	vmaCreateBuffer(vmaAllocator, &vertexBufferCreateInfo, &vmaAllocCreateInfo,
-					reinterpret_cast<VkBuffer *>(&vertexBuffer), &vertexBufferAllocation, nullptr);
-
-	VkBufferCreateInfo indexBufferCreateInfo{};
-	indexBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	indexBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	indexBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-	indexBufferCreateInfo.size = indicesSize;
-
-	vmaCreateBuffer(vmaAllocator, &indexBufferCreateInfo, &vmaAllocCreateInfo,
-					reinterpret_cast<VkBuffer *>(&indexBuffer), &indexBufferAllocation, nullptr);
-
-	memcpy(stagingBufferAllocInfo.pMappedData, vertices.data(), verticesSize);
-
-	CommandBuffer::beginSTC(commandBuffer);
-	vk::BufferCopy bufferCopy;
-	bufferCopy.setSize(verticesSize);
-	commandBuffer.copyBuffer(stagingBuffer, vertexBuffer, bufferCopy);
-	CommandBuffer::endSTC(commandBuffer, queue);
-
-	memcpy(stagingBufferAllocInfo.pMappedData, indices.data(), indicesSize);
-
-	CommandBuffer::beginSTC(commandBuffer);
-	bufferCopy.setSize(indicesSize);
-	commandBuffer.copyBuffer(stagingBuffer, indexBuffer, bufferCopy);
-	CommandBuffer::endSTC(commandBuffer, queue);
-
-	vmaDestroyBuffer(vmaAllocator, stagingBuffer, stagingBufferAllocation);
+	geometryArena.free(geometry);
+}
+
+void Mesh::uploadMesh(N::GeometryArena &geometryArena, N::StagingUploader &uploader, VertexFormat vertexFormat)
+{
+	this->vertexFormat = vertexFormat;
+
+	VkDeviceSize vertexSize = vertexFormat == VertexFormat::ePacked ? sizeof(PackedVertex) : sizeof(Vertex);
+	VkDeviceSize verticesSize = vertices.size() * vertexSize;
+	VkDeviceSize indexSize = indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	VkDeviceSize indicesSize = indices.size() * indexSize;
+
+	if (geometryArena.getVertexStride() != vertexSize)
+		throw std::runtime_error("Mesh vertex format does not match the geometry arena");
+
+	geometry = geometryArena.allocate(static_cast<uint32_t>(vertices.size()), indicesSize);
+	vk::Buffer vertexBuffer = geometryArena.getVertexBuffer(geometry.block);
+	vk::Buffer indexBuffer = geometryArena.getIndexBuffer(geometry.block);
+	VkDeviceSize verticesOffset = geometry.firstVertex * vertexSize;
+
+	if (vertexFormat == VertexFormat::ePacked)
+	{
+		// Quantize straight into the staging buffer, the packed vertices are never needed on the CPU
+		packedVertexDecode = calcPackedVertexDecode();
+
+		uploader.upload(vertexBuffer, verticesOffset, verticesSize, vertexSize,
+						[this](void *mapped, VkDeviceSize offset, VkDeviceSize size) {
+							auto *stagingVertices = static_cast<PackedVertex *>(mapped);
+							size_t first = offset / sizeof(PackedVertex);
+							for (size_t i = 0; i < size / sizeof(PackedVertex); i++)
+							{
+								stagingVertices[i] = PackedVertex::pack(vertices[first + i], packedVertexDecode);
+							}
+						});
+	}
+	else
+	{
+		uploader.upload(vertexBuffer, verticesOffset, vertices.data(), verticesSize);
+	}
+
+	if (indexType == vk::IndexType::eUint16)
+	{
+		// Narrow straight into the staging buffer instead of keeping a second 16 bit copy of the indices around
+		uploader.upload(indexBuffer, geometry.indexOffset, indicesSize, indexSize,
+						[this](void *mapped, VkDeviceSize offset, VkDeviceSize size) {
+							auto *stagingIndices = static_cast<uint16_t *>(mapped);
+							size_t first = offset / sizeof(uint16_t);
+							for (size_t i = 0; i < size / sizeof(uint16_t); i++)
+							{
+								stagingIndices[i] = static_cast<uint16_t>(indices[first + i]);
+							}
+						});
+	}
+	else
+	{
+		uploader.upload(indexBuffer, geometry.indexOffset, indices.data(), indicesSize);
+	}
 }
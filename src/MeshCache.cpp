@@ -0,0 +1,301 @@
+#include "MeshCache.h"
+
+#include "Hash.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace N
+{
+namespace
+{
+constexpr char cacheMagic[4] = {'N', 'M', 'S', 'H'};
+// Bytes of the source file hashed before their pages are released
+constexpr size_t hashChunkSize = 16 << 20;
+
+// Bounds checked reads out of the mapped cache file
+class CacheReader
+{
+  public:
+	CacheReader(const unsigned char *data, size_t size) : data(data), size(size)
+	{
+	}
+
+	template <typename T> bool read(T &value)
+	{
+		return readBytes(&value, sizeof(T));
+	}
+
+	bool readBytes(void *dst, size_t count)
+	{
+		if (count > size - offset)
+			return false;
+
+		memcpy(dst, data + offset, count);
+		offset += count;
+		return true;
+	}
+
+	bool readString(std::string &value)
+	{
+		uint32_t length;
+		if (!read(length) || length > size - offset)
+			return false;
+
+		value.assign(reinterpret_cast<const char *>(data + offset), length);
+		offset += length;
+		return true;
+	}
+
+  private:
+	const unsigned char *data;
+	size_t size;
+	size_t offset = 0;
+};
+
+void writeString(std::ofstream &file, const std::string &value)
+{
+	uint32_t length = static_cast<uint32_t>(value.size());
+	file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+	file.write(value.data(), length);
+}
+
+// Calls function with the trimmed name of every mtllib line in an OBJ file
+template <typename F> void forEachMaterialLibrary(const char *begin, const char *end, F &&function)
+{
+	constexpr std::string_view keyword = "mtllib";
+
+	while (begin < end)
+	{
+		const char *lineEnd = static_cast<const char *>(memchr(begin, '\n', end - begin));
+		if (!lineEnd)
+			lineEnd = end;
+
+		const char *p = begin;
+		while (p < lineEnd && (*p == ' ' || *p == '\t'))
+			p++;
+
+		if (static_cast<size_t>(lineEnd - p) > keyword.size() && std::string_view(p, keyword.size()) == keyword &&
+			(p[keyword.size()] == ' ' || p[keyword.size()] == '\t'))
+		{
+			const char *nameBegin = p + keyword.size();
+			const char *nameEnd = lineEnd;
+			while (nameBegin < nameEnd && isspace(static_cast<unsigned char>(*nameBegin)))
+				nameBegin++;
+			while (nameEnd > nameBegin && isspace(static_cast<unsigned char>(nameEnd[-1])))
+				nameEnd--;
+
+			if (nameBegin < nameEnd)
+				function(std::string(nameBegin, nameEnd));
+		}
+
+		begin = lineEnd + 1;
+	}
+}
+} // namespace
+
+std::string MeshCache::getCachePath(const char *sourcePath)
+{
+	return std::string(sourcePath).append(".meshcache");
+}
+
+uint64_t MeshCache::hashSourceFile(const char *sourcePath)
+{
+	MappedFile sourceFile;
+	if (!sourceFile.open(sourcePath))
+		return 0;
+
+	std::string directory(sourcePath);
+	size_t separator = directory.find_last_of("/\\");
+	directory.resize(separator != std::string::npos ? separator + 1 : 0);
+
+	// The file is hashed in chunks that end at line boundaries and their pages are released right after, so hashing a
+	// large OBJ file does not leave all of it resident. The cached material list comes from the material libraries,
+	// so their content is part of the key. A library that cannot be read still changes the hash, which then changes
+	// again once it appears.
+	const auto *text = reinterpret_cast<const char *>(sourceFile.data());
+	size_t size = sourceFile.size();
+	uint64_t hash = hashBytes(&size, sizeof(size));
+	for (size_t begin = 0; begin < size;)
+	{
+		size_t end = std::min(begin + hashChunkSize, size);
+		const void *lineEnd = memchr(text + end, '\n', size - end);
+		end = lineEnd ? static_cast<const char *>(lineEnd) - text + 1 : size;
+
+		hash = hashBytes(text + begin, end - begin, hash);
+		forEachMaterialLibrary(text + begin, text + end, [&](const std::string &library) {
+			MappedFile libraryFile;
+			uint64_t libraryHash = libraryFile.open((directory + library).c_str())
+									   ? hashBytes(libraryFile.data(), libraryFile.size())
+									   : 0;
+			hash = hashBytes(&libraryHash, sizeof(libraryHash), hash);
+		});
+
+		sourceFile.release(begin, end - begin);
+		begin = end;
+	}
+
+	return hash;
+}
+
+bool MeshCache::load(const std::string &cachePath, uint64_t sourceHash, uint32_t buildFlags,
+					 std::vector<tinyobj::material_t> &materials, std::vector<Mesh> &meshes)
+{
+	MappedFile cacheFile;
+	if (!cacheFile.open(cachePath.c_str()))
+		return false;
+
+	CacheReader reader(cacheFile.data(), cacheFile.size());
+
+	Header header;
+	if (!reader.read(header) || memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+		header.version != version || header.sourceHash != sourceHash || header.vertexSize != sizeof(Vertex) ||
+		header.buildFlags != buildFlags)
+	{
+		return false;
+	}
+
+	std::vector<tinyobj::material_t> loadedMaterials(header.materialCount);
+	for (auto &material : loadedMaterials)
+	{
+		uint32_t parameterCount;
+		bool valid = reader.readString(material.name) && reader.readString(material.diffuse_texname) &&
+					 reader.readString(material.metallic_texname) && reader.readString(material.roughness_texname) &&
+					 reader.readString(material.normal_texname) && reader.readString(material.ambient_texname) &&
+					 reader.read(parameterCount);
+
+		for (uint32_t i = 0; valid && i < parameterCount; i++)
+		{
+			std::string key, value;
+			valid = reader.readString(key) && reader.readString(value);
+			material.unknown_parameter.emplace(std::move(key), std::move(value));
+		}
+
+		if (!valid)
+			return false;
+	}
+
+	std::vector<Mesh> loadedMeshes;
+	loadedMeshes.reserve(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; i++)
+	{
+		MeshHeader meshHeader;
+		if (!reader.read(meshHeader))
+			return false;
+
+		// Guard the resizes below against a truncated or corrupted file before allocating anything
+		if (meshHeader.vertexCount > cacheFile.size() / sizeof(Vertex) ||
+			meshHeader.indexCount > cacheFile.size() / sizeof(uint32_t) ||
+			meshHeader.lodCount > cacheFile.size() / sizeof(MeshLod))
+		{
+			return false;
+		}
+
+		std::vector<Vertex> vertices(meshHeader.vertexCount);
+		std::vector<uint32_t> indices(meshHeader.indexCount);
+		std::vector<MeshLod> lods(meshHeader.lodCount);
+		if (!reader.readBytes(vertices.data(), vertices.size() * sizeof(Vertex)) ||
+			!reader.readBytes(indices.data(), indices.size() * sizeof(uint32_t)) ||
+			!reader.readBytes(lods.data(), lods.size() * sizeof(MeshLod)))
+		{
+			return false;
+		}
+
+		for (const auto &lod : lods)
+		{
+			if (uint64_t{lod.indexOffset} + lod.indexCount > indices.size())
+				return false;
+		}
+
+		loadedMeshes.emplace_back(std::move(vertices), std::move(indices), meshHeader.materialId, meshHeader.boundsMin,
+								  meshHeader.boundsMax, std::move(lods));
+	}
+
+	materials = std::move(loadedMaterials);
+	meshes = std::move(loadedMeshes);
+
+	return true;
+}
+
+void MeshCache::store(const std::string &cachePath, uint64_t sourceHash, uint32_t buildFlags,
+					  const std::vector<tinyobj::material_t> &materials, const std::vector<Mesh> &meshes)
+{
+	// Write to a temporary file first so a crash mid write never leaves a truncated cache with a valid header behind
+	std::string tempPath = cachePath + ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "Could not write mesh cache " << cachePath << std::endl;
+			return;
+		}
+
+		Header header{};
+		memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+		header.version = version;
+		header.sourceHash = sourceHash;
+		header.vertexSize = sizeof(Vertex);
+		header.materialCount = static_cast<uint32_t>(materials.size());
+		header.meshCount = static_cast<uint32_t>(meshes.size());
+		header.buildFlags = buildFlags;
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+		for (const auto &material : materials)
+		{
+			writeString(file, material.name);
+			writeString(file, material.diffuse_texname);
+			writeString(file, material.metallic_texname);
+			writeString(file, material.roughness_texname);
+			writeString(file, material.normal_texname);
+			writeString(file, material.ambient_texname);
+
+			uint32_t parameterCount = static_cast<uint32_t>(material.unknown_parameter.size());
+			file.write(reinterpret_cast<const char *>(&parameterCount), sizeof(parameterCount));
+			for (const auto &[key, value] : material.unknown_parameter)
+			{
+				writeString(file, key);
+				writeString(file, value);
+			}
+		}
+
+		for (const auto &mesh : meshes)
+		{
+			MeshHeader meshHeader{};
+			meshHeader.materialId = mesh.getMaterialId();
+			meshHeader.lodCount = static_cast<uint32_t>(mesh.getLods().size());
+			meshHeader.vertexCount = mesh.getVertices().size();
+			meshHeader.indexCount = mesh.getIndices().size();
+			meshHeader.boundsMin = mesh.getBoundsMin();
+			meshHeader.boundsMax = mesh.getBoundsMax();
+			file.write(reinterpret_cast<const char *>(&meshHeader), sizeof(meshHeader));
+
+			file.write(reinterpret_cast<const char *>(mesh.getVertices().data()),
+					   mesh.getVertices().size() * sizeof(Vertex));
+			file.write(reinterpret_cast<const char *>(mesh.getIndices().data()),
+					   mesh.getIndices().size() * sizeof(uint32_t));
+			file.write(reinterpret_cast<const char *>(mesh.getLods().data()), mesh.getLods().size() * sizeof(MeshLod));
+		}
+
+		if (!file.good())
+		{
+			std::cerr << "Could not write mesh cache " << cachePath << std::endl;
+			file.close();
+			std::remove(tempPath.c_str());
+			return;
+		}
+	}
+
+	std::remove(cachePath.c_str());
+	if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+	{
+		std::cerr << "Could not write mesh cache " << cachePath << std::endl;
+		std::remove(tempPath.c_str());
+	}
+}
+} // namespace N
@@ -0,0 +1,352 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+constexpr int forsythCacheSize = 32;
+constexpr float forsythCacheDecayPower = 1.5f;
+constexpr float forsythLastTriangleScore = 0.75f;
+constexpr float forsythValenceBoostScale = 2.f;
+constexpr float forsythValenceBoostPower = 0.5f;
+
+float forsythVertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	// Vertices without remaining triangles should never attract the next pick
+	if (remainingTriangles == 0)
+		return -1.f;
+
+	float score = 0.f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// The most recent triangle's vertices get a fixed score so its neighbours are not always preferred
+			score = forsythLastTriangleScore;
+		}
+		else
+		{
+			float scaler = 1.f / (forsythCacheSize - 3);
+			score = std::pow(1.f - (cachePosition - 3) * scaler, forsythCacheDecayPower);
+		}
+	}
+
+	// Boost vertices with few triangles left so they are finished off and do not leave lone triangles behind
+	score += forsythValenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -forsythValenceBoostPower);
+
+	return score;
+}
+} // namespace
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Vertex to triangle adjacency in CSR form. The first remainingTriangles entries of a vertex's range are the
+	// triangles that still have to be emitted.
+	std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		remainingTriangles[index]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	std::partial_sum(remainingTriangles.begin(), remainingTriangles.end(), adjacencyOffsets.begin() + 1);
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			adjacency[fill[indices[triangle * 3 + corner]]++] = static_cast<uint32_t>(triangle);
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		vertexScores[vertex] = forsythVertexScore(-1, remainingTriangles[vertex]);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> optimized;
+	optimized.reserve(indices.size());
+
+	// Three extra slots hold vertices that are pushed out of the cache by the triangle just emitted
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	cache.reserve(forsythCacheSize + 3);
+	nextCache.reserve(forsythCacheSize + 3);
+
+	size_t restartCursor = 0;
+	int64_t bestTriangle = -1;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		if (bestTriangle < 0)
+		{
+			// Dead end, nothing in the cache touches a remaining triangle. Continue with the next one in input order,
+			// which keeps the whole pass linear.
+			while (emitted[restartCursor])
+				restartCursor++;
+			bestTriangle = static_cast<int64_t>(restartCursor);
+		}
+
+		const uint32_t *triangleIndices = &indices[bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		optimized.insert(optimized.end(), triangleIndices, triangleIndices + 3);
+
+		nextCache.clear();
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = triangleIndices[corner];
+			nextCache.push_back(vertex);
+
+			// Remove the triangle from the vertex's remaining adjacency
+			uint32_t *begin = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t *end = begin + remainingTriangles[vertex];
+			uint32_t *it = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+			std::swap(*it, *(end - 1));
+			remainingTriangles[vertex]--;
+		}
+
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangleIndices[0] && vertex != triangleIndices[1] && vertex != triangleIndices[2])
+				nextCache.push_back(vertex);
+		}
+
+		for (size_t position = forsythCacheSize; position < nextCache.size(); position++)
+		{
+			cachePositions[nextCache[position]] = -1;
+			vertexScores[nextCache[position]] = forsythVertexScore(-1, remainingTriangles[nextCache[position]]);
+		}
+		nextCache.resize(std::min<size_t>(nextCache.size(), forsythCacheSize));
+		std::swap(cache, nextCache);
+
+		for (size_t position = 0; position < cache.size(); position++)
+		{
+			uint32_t vertex = cache[position];
+			cachePositions[vertex] = static_cast<int>(position);
+			vertexScores[vertex] = forsythVertexScore(static_cast<int>(position), remainingTriangles[vertex]);
+		}
+
+		// Only triangles touching the cache changed score, the best of them is the next pick
+		bestTriangle = -1;
+		float bestScore = -1.f;
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t i = 0; i < remainingTriangles[vertex]; i++)
+			{
+				uint32_t triangle = adjacency[adjacencyOffsets[vertex] + i];
+				float score = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] +
+							  vertexScores[indices[triangle * 3 + 2]];
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = triangle;
+				}
+			}
+		}
+	}
+
+	indices = std::move(optimized);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices,
+									 float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	float inputAcmr = analyzeVertexCache(indices, vertices.size()).acmr();
+
+	// Hard boundaries are where the cache simulation over the whole order sees all three vertices of a triangle miss,
+	// the vertex cache optimization restarted there and nothing is lost by moving the pieces apart
+	std::vector<uint32_t> hardStarts;
+	std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+	uint32_t time = analysisCacheSize + 1;
+
+	auto simulateTriangle = [&indices, &cacheTimestamps, &time](size_t triangle) {
+		uint32_t misses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = indices[triangle * 3 + corner];
+			if (time - cacheTimestamps[vertex] > analysisCacheSize)
+			{
+				cacheTimestamps[vertex] = time++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+	// Moving time past every timestamp empties the cache, a cluster drawn after any other starts out cold
+	auto flushCache = [&time]() { time += analysisCacheSize + 1; };
+
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		if (simulateTriangle(triangle) == 3 || triangle == 0)
+			hardStarts.push_back(static_cast<uint32_t>(triangle));
+	}
+	hardStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+	// Soft boundaries split a hard cluster as soon as the piece since the last split, simulated from an empty cache,
+	// has come down to within threshold of the ACMR of the whole hard cluster simulated the same way
+	std::vector<uint32_t> clusterStarts;
+	for (size_t hard = 0; hard + 1 < hardStarts.size(); hard++)
+	{
+		uint32_t begin = hardStarts[hard];
+		uint32_t end = hardStarts[hard + 1];
+
+		flushCache();
+		uint32_t hardMisses = 0;
+		for (uint32_t triangle = begin; triangle < end; triangle++)
+			hardMisses += simulateTriangle(triangle);
+		float clusterThreshold = threshold * static_cast<float>(hardMisses) / static_cast<float>(end - begin);
+
+		flushCache();
+		clusterStarts.push_back(begin);
+		uint32_t clusterStart = begin;
+		uint32_t clusterMisses = 0;
+		for (uint32_t triangle = begin; triangle < end; triangle++)
+		{
+			clusterMisses += simulateTriangle(triangle);
+			if (triangle + 1 < end &&
+				static_cast<float>(clusterMisses) / static_cast<float>(triangle + 1 - clusterStart) <= clusterThreshold)
+			{
+				clusterStart = triangle + 1;
+				clusterStarts.push_back(clusterStart);
+				clusterMisses = 0;
+				flushCache();
+			}
+		}
+	}
+
+	size_t clusterCount = clusterStarts.size();
+	clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+	glm::vec3 meshCentroid{0.f};
+	float meshArea = 0.f;
+
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3{0.f});
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3{0.f});
+
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		float clusterArea = 0.f;
+
+		for (uint32_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++)
+		{
+			const glm::vec3 &p0 = vertices[indices[triangle * 3]].pos;
+			const glm::vec3 &p1 = vertices[indices[triangle * 3 + 1]].pos;
+			const glm::vec3 &p2 = vertices[indices[triangle * 3 + 2]].pos;
+
+			// The cross product is twice the area weighted normal, the factor cancels out everywhere below
+			glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(areaNormal);
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.f;
+
+			clusterCentroids[cluster] += centroid * area;
+			clusterNormals[cluster] += areaNormal;
+			clusterArea += area;
+		}
+
+		meshCentroid += clusterCentroids[cluster];
+		meshArea += clusterArea;
+
+		if (clusterArea > 0.f)
+			clusterCentroids[cluster] /= clusterArea;
+	}
+
+	if (meshArea > 0.f)
+		meshCentroid /= meshArea;
+
+	// Clusters far out along their own facing direction are likely to occlude the rest, so they go first
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		float normalLength = glm::length(clusterNormals[cluster]);
+		glm::vec3 normal = normalLength > 0.f ? clusterNormals[cluster] / normalLength : glm::vec3{0.f};
+		sortKeys[cluster] = glm::dot(clusterCentroids[cluster] - meshCentroid, normal);
+	}
+
+	std::vector<uint32_t> clusterOrder(clusterCount);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+					 [&sortKeys](uint32_t lhs, uint32_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+	std::vector<uint32_t> optimized;
+	optimized.reserve(indices.size());
+	for (uint32_t cluster : clusterOrder)
+	{
+		optimized.insert(optimized.end(), indices.begin() + clusterStarts[cluster] * 3,
+						 indices.begin() + clusterStarts[cluster + 1] * 3);
+	}
+
+	// The clusters are cut where their own ACMR is close to the input's, but the cache state at the seams between
+	// them differs after sorting. An order that lost more than threshold is not worth the overdraw it may save.
+	if (analyzeVertexCache(optimized, vertices.size()).acmr() > threshold * inputAcmr)
+		return;
+
+	indices = std::move(optimized);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+	constexpr uint32_t unassigned = UINT32_MAX;
+
+	std::vector<uint32_t> remap(vertices.size(), unassigned);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t &index : indices)
+	{
+		if (remap[index] == unassigned)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices = std::move(reordered);
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount,
+												   uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	stats.triangles = indices.size() / 3;
+
+	// A vertex is in the FIFO cache if fewer than cacheSize misses happened since it was last loaded
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t time = cacheSize + 1;
+
+	for (uint32_t index : indices)
+	{
+		if (time - cacheTimestamps[index] > cacheSize)
+		{
+			cacheTimestamps[index] = time++;
+			stats.misses++;
+		}
+
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			stats.vertices++;
+		}
+	}
+
+	return stats;
+}
@@ -0,0 +1,387 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+// Symmetric 4x4 matrix summing squared distances to a set of planes, weighted by triangle area
+struct Quadric
+{
+	double a2 = 0, ab = 0, ac = 0, ad = 0;
+	double b2 = 0, bc = 0, bd = 0;
+	double c2 = 0, cd = 0;
+	double d2 = 0;
+	double weight = 0;
+
+	Quadric &operator+=(const Quadric &rhs)
+	{
+		a2 += rhs.a2, ab += rhs.ab, ac += rhs.ac, ad += rhs.ad;
+		b2 += rhs.b2, bc += rhs.bc, bd += rhs.bd;
+		c2 += rhs.c2, cd += rhs.cd;
+		d2 += rhs.d2;
+		weight += rhs.weight;
+		return *this;
+	}
+
+	static Quadric fromPlane(const glm::vec3 &normal, float distance, float weight)
+	{
+		double a = normal.x, b = normal.y, c = normal.z, d = distance;
+
+		Quadric quadric;
+		quadric.a2 = weight * a * a, quadric.ab = weight * a * b, quadric.ac = weight * a * c;
+		quadric.ad = weight * a * d;
+		quadric.b2 = weight * b * b, quadric.bc = weight * b * c, quadric.bd = weight * b * d;
+		quadric.c2 = weight * c * c, quadric.cd = weight * c * d;
+		quadric.d2 = weight * d * d;
+		quadric.weight = weight;
+		return quadric;
+	}
+
+	// Mean squared distance of point to the planes
+	double evaluate(const glm::vec3 &point) const
+	{
+		double x = point.x, y = point.y, z = point.z;
+		double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x + b2 * y * y + 2 * bc * y * z +
+					   2 * bd * y + c2 * z * z + 2 * cd * z + d2;
+		return weight > 0 ? std::max(error, 0.0) / weight : 0.0;
+	}
+};
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	double error;
+};
+
+// Maps every vertex to the first vertex with the same position, so quadrics and borders ignore attribute seams
+std::vector<uint32_t> buildPositionRemap(const std::vector<Vertex> &vertices)
+{
+	std::vector<uint32_t> order(vertices.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	auto lessPosition = [&](uint32_t a, uint32_t b) {
+		const glm::vec3 &pa = vertices[a].pos;
+		const glm::vec3 &pb = vertices[b].pos;
+		if (pa.x != pb.x)
+			return pa.x < pb.x;
+		if (pa.y != pb.y)
+			return pa.y < pb.y;
+		if (pa.z != pb.z)
+			return pa.z < pb.z;
+		return a < b;
+	};
+	std::sort(order.begin(), order.end(), lessPosition);
+
+	std::vector<uint32_t> remap(vertices.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		bool samePosition = i > 0 && vertices[order[i]].pos == vertices[order[i - 1]].pos;
+		remap[order[i]] = samePosition ? remap[order[i - 1]] : order[i];
+	}
+
+	return remap;
+}
+
+// Vertices on an edge used by a single triangle, compared by position so attribute seams do not count as borders
+std::vector<bool> findBorderVertices(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &positionRemap)
+{
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	edgeUses.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t a = positionRemap[indices[i + corner]];
+			uint32_t b = positionRemap[indices[i + (corner + 1) % 3]];
+			edgeUses[(uint64_t{std::min(a, b)} << 32) | std::max(a, b)]++;
+		}
+	}
+
+	std::vector<bool> borderPosition(positionRemap.size(), false);
+	for (const auto &[edge, uses] : edgeUses)
+	{
+		if (uses == 1)
+		{
+			borderPosition[edge >> 32] = true;
+			borderPosition[edge & UINT32_MAX] = true;
+		}
+	}
+
+	std::vector<bool> border(positionRemap.size());
+	for (uint32_t vertex = 0; vertex < positionRemap.size(); vertex++)
+	{
+		border[vertex] = borderPosition[positionRemap[vertex]];
+	}
+
+	return border;
+}
+
+glm::vec3 triangleNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+{
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+// Rejects collapses that would turn a triangle around vertex from over
+bool flipsTriangles(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+					const std::vector<uint32_t> &triangles, uint32_t from, uint32_t to)
+{
+	const glm::vec3 &target = vertices[to].pos;
+
+	for (uint32_t triangle : triangles)
+	{
+		const uint32_t *corners = &indices[triangle * 3];
+		if (corners[0] == to || corners[1] == to || corners[2] == to)
+			continue;
+
+		glm::vec3 positions[3] = {vertices[corners[0]].pos, vertices[corners[1]].pos, vertices[corners[2]].pos};
+		glm::vec3 before = triangleNormal(positions[0], positions[1], positions[2]);
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (corners[corner] == from)
+				positions[corner] = target;
+		}
+		glm::vec3 after = triangleNormal(positions[0], positions[1], positions[2]);
+
+		if (glm::dot(before, after) <= 0.f)
+			return true;
+	}
+
+	return false;
+}
+} // namespace
+
+std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<Vertex> &vertices,
+											   const std::vector<uint32_t> &indices, size_t targetIndexCount,
+											   float maxError, float &resultError)
+{
+	resultError = 0.f;
+
+	std::vector<uint32_t> result = indices;
+	if (result.size() <= targetIndexCount)
+		return result;
+
+	std::vector<uint32_t> positionRemap = buildPositionRemap(vertices);
+	std::vector<bool> border = findBorderVertices(indices, positionRemap);
+
+	// Vertices grouped by position, a group with more than one vertex lies on an attribute seam
+	std::vector<uint32_t> positionOffsets(vertices.size() + 1, 0);
+	for (uint32_t position : positionRemap)
+	{
+		positionOffsets[position + 1]++;
+	}
+	std::partial_sum(positionOffsets.begin(), positionOffsets.end(), positionOffsets.begin());
+
+	std::vector<uint32_t> positionVertices(vertices.size());
+	{
+		std::vector<uint32_t> fill(positionOffsets.begin(), positionOffsets.end() - 1);
+		for (uint32_t vertex = 0; vertex < vertices.size(); vertex++)
+		{
+			positionVertices[fill[positionRemap[vertex]]++] = vertex;
+		}
+	}
+
+	// Accumulated per position so every vertex of a seam sees the whole surface around it
+	std::vector<Quadric> quadrics(vertices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const glm::vec3 &p0 = vertices[indices[i]].pos;
+		const glm::vec3 &p1 = vertices[indices[i + 1]].pos;
+		const glm::vec3 &p2 = vertices[indices[i + 2]].pos;
+
+		glm::vec3 normal = triangleNormal(p0, p1, p2);
+		float doubleArea = glm::length(normal);
+		if (doubleArea == 0.f)
+			continue;
+
+		normal /= doubleArea;
+		Quadric quadric = Quadric::fromPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5f);
+		for (int corner = 0; corner < 3; corner++)
+		{
+			quadrics[positionRemap[indices[i + corner]]] += quadric;
+		}
+	}
+
+	double maxQuadricError = static_cast<double>(maxError) * maxError;
+
+	std::vector<uint32_t> triangleOffsets(vertices.size() + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertices.size());
+	std::vector<bool> touched(vertices.size());
+	std::vector<std::pair<uint32_t, uint32_t>> collapsePairs;
+	// Triangles around the vertex a collapse is checked for, reused across collapses
+	std::vector<uint32_t> collapseTriangles;
+
+	auto triangleRange = [&](uint32_t vertex) {
+		return std::make_pair(vertexTriangles.begin() + triangleOffsets[vertex],
+							  vertexTriangles.begin() + triangleOffsets[vertex + 1]);
+	};
+
+	// Vertices at the position of vertex that are still referenced by the current index list
+	auto liveSiblings = [&](uint32_t vertex, std::vector<uint32_t> &siblings) {
+		siblings.clear();
+		uint32_t position = positionRemap[vertex];
+		for (uint32_t i = positionOffsets[position]; i < positionOffsets[position + 1]; i++)
+		{
+			uint32_t sibling = positionVertices[i];
+			if (triangleOffsets[sibling] != triangleOffsets[sibling + 1])
+				siblings.push_back(sibling);
+		}
+	};
+
+	std::vector<uint32_t> fromSiblings, toSiblings;
+
+	// A seam vertex only moves along the seam: every copy of it has to collapse onto a neighbouring copy of the target,
+	// otherwise one side of the seam would be stretched across the other
+	auto findCollapsePairs = [&](uint32_t from, uint32_t to) {
+		collapsePairs.clear();
+
+		liveSiblings(from, fromSiblings);
+		if (fromSiblings.size() == 1)
+		{
+			collapsePairs.emplace_back(from, to);
+			return true;
+		}
+
+		liveSiblings(to, toSiblings);
+		if (toSiblings.size() != fromSiblings.size())
+			return false;
+
+		for (uint32_t fromSibling : fromSiblings)
+		{
+			auto [begin, end] = triangleRange(fromSibling);
+			auto neighbour = std::find_if(toSiblings.begin(), toSiblings.end(), [&](uint32_t toSibling) {
+				return std::any_of(begin, end, [&](uint32_t triangle) {
+					return result[triangle * 3] == toSibling || result[triangle * 3 + 1] == toSibling ||
+						   result[triangle * 3 + 2] == toSibling;
+				});
+			});
+			if (neighbour == toSiblings.end())
+				return false;
+
+			collapsePairs.emplace_back(fromSibling, *neighbour);
+		}
+
+		return true;
+	};
+
+	// Every pass collapses a set of edges with disjoint neighbourhoods, then rebuilds the index list
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : result)
+		{
+			triangleOffsets[index + 1]++;
+		}
+		std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+		vertexTriangles.resize(result.size());
+		std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			vertexTriangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t from = result[i + corner];
+				uint32_t to = result[i + (corner + 1) % 3];
+				if (border[from] || positionRemap[from] == positionRemap[to])
+					continue;
+
+				Quadric merged = quadrics[positionRemap[from]];
+				merged += quadrics[positionRemap[to]];
+
+				double error = merged.evaluate(vertices[to].pos);
+				if (error <= maxQuadricError)
+					collapses.push_back({from, to, error});
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(),
+				  [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Each collapse of an interior edge removes two triangles
+		size_t collapsesNeeded = (triangleCount - targetIndexCount / 3 + 1) / 2;
+		size_t collapsesDone = 0;
+
+		for (const auto &collapse : collapses)
+		{
+			if (collapsesDone >= collapsesNeeded)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+			if (!findCollapsePairs(collapse.from, collapse.to))
+				continue;
+
+			bool valid = true;
+			for (const auto &[from, to] : collapsePairs)
+			{
+				auto [begin, end] = triangleRange(from);
+				collapseTriangles.assign(begin, end);
+				if (touched[from] || touched[to] || flipsTriangles(vertices, result, collapseTriangles, from, to))
+				{
+					valid = false;
+					break;
+				}
+			}
+			if (!valid)
+				continue;
+
+			for (const auto &[from, to] : collapsePairs)
+			{
+				remap[from] = to;
+
+				// Freeze the whole neighbourhood so the flip checks of later collapses in this pass stay valid
+				auto [begin, end] = triangleRange(from);
+				for (auto triangle = begin; triangle != end; ++triangle)
+				{
+					for (int corner = 0; corner < 3; corner++)
+					{
+						touched[result[*triangle * 3 + corner]] = true;
+					}
+				}
+			}
+
+			quadrics[positionRemap[collapse.to]] += quadrics[positionRemap[collapse.from]];
+			resultError = std::max(resultError, static_cast<float>(std::sqrt(collapse.error)));
+			collapsesDone++;
+		}
+
+		if (collapsesDone == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i]];
+			uint32_t b = remap[result[i + 1]];
+			uint32_t c = remap[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	return result;
+}
@@ -0,0 +1,181 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+MeshletData MeshletBuilder::build(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+								  uint32_t maxVertices, uint32_t maxTriangles)
+{
+	if (maxVertices < 3 || maxVertices > 256 || maxTriangles < 1)
+		throw std::runtime_error("Invalid meshlet limits!");
+
+	constexpr uint32_t unused = UINT32_MAX;
+
+	MeshletData data;
+
+	// Local index of every mesh vertex in the meshlet being built. Only the entries of the current meshlet's vertices
+	// are ever set, and they are cleared again when it is finished, so this is never refilled as a whole.
+	std::vector<uint32_t> localIndices(vertices.size(), unused);
+
+	Meshlet current{};
+
+	auto finishMeshlet = [&]() {
+		if (current.triangleCount == 0)
+			return;
+
+		for (uint32_t i = 0; i < current.vertexCount; i++)
+		{
+			localIndices[data.vertices[current.vertexOffset + i]] = unused;
+		}
+
+		computeBounds(current, data, vertices);
+		data.meshlets.push_back(current);
+
+		current = Meshlet{};
+		current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+		current.triangleOffset = static_cast<uint32_t>(data.triangles.size() / 3);
+	};
+
+	for (size_t triangle = 0; triangle + 2 < indices.size(); triangle += 3)
+	{
+		const uint32_t *corners = &indices[triangle];
+
+		uint32_t newVertices = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			bool duplicate = (corner > 0 && corners[corner] == corners[0]) ||
+							 (corner > 1 && corners[corner] == corners[1]);
+			if (localIndices[corners[corner]] == unused && !duplicate)
+				newVertices++;
+		}
+
+		if (current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles)
+			finishMeshlet();
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t &local = localIndices[corners[corner]];
+			if (local == unused)
+			{
+				local = current.vertexCount++;
+				data.vertices.push_back(corners[corner]);
+			}
+
+			data.triangles.push_back(static_cast<uint8_t>(local));
+		}
+
+		current.triangleCount++;
+	}
+
+	finishMeshlet();
+
+	return data;
+}
+
+void MeshletBuilder::computeBounds(Meshlet &meshlet, const MeshletData &data, const std::vector<Vertex> &vertices)
+{
+	auto position = [&](uint32_t local) -> const glm::vec3 & {
+		return vertices[data.vertices[meshlet.vertexOffset + local]].pos;
+	};
+
+	// Ritter's bounding sphere: start from two far apart points, then grow to take in any point still outside
+	const glm::vec3 &first = position(0);
+
+	uint32_t farthest = 0;
+	float farthestDistance = 0.f;
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+	{
+		float distance = glm::distance(first, position(i));
+		if (distance > farthestDistance)
+		{
+			farthestDistance = distance;
+			farthest = i;
+		}
+	}
+
+	uint32_t opposite = farthest;
+	float oppositeDistance = 0.f;
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+	{
+		float distance = glm::distance(position(farthest), position(i));
+		if (distance > oppositeDistance)
+		{
+			oppositeDistance = distance;
+			opposite = i;
+		}
+	}
+
+	glm::vec3 center = (position(farthest) + position(opposite)) * 0.5f;
+	float radius = oppositeDistance * 0.5f;
+
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+	{
+		float distance = glm::distance(center, position(i));
+		if (distance > radius)
+		{
+			float newRadius = (radius + distance) * 0.5f;
+			center += (position(i) - center) * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+
+	meshlet.center = center;
+	meshlet.radius = radius;
+
+	// The cone axis is the average of the triangle normals, its spread is the smallest dot product with any of them
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangleCount);
+
+	glm::vec3 normalSum{0.f};
+	for (uint32_t triangle = 0; triangle < meshlet.triangleCount; triangle++)
+	{
+		const uint8_t *corners = &data.triangles[(meshlet.triangleOffset + triangle) * 3];
+
+		glm::vec3 normal = glm::cross(position(corners[1]) - position(corners[0]),
+									  position(corners[2]) - position(corners[0]));
+		float length = glm::length(normal);
+
+		// Degenerate triangles are never rasterized, so they do not constrain the cone
+		if (length > 0.f)
+		{
+			normals.push_back(normal / length);
+			normalSum += normals.back();
+		}
+	}
+
+	float sumLength = glm::length(normalSum);
+	meshlet.coneAxis = sumLength > 0.f ? normalSum / sumLength : glm::vec3{0.f, 0.f, 1.f};
+	meshlet.coneCutoff = 1.f;
+
+	if (sumLength == 0.f)
+		return;
+
+	float minDot = 1.f;
+	for (const auto &normal : normals)
+	{
+		minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+	}
+
+	// A cone wider than a hemisphere always has a triangle facing the camera, leave it unculled
+	if (minDot > 0.f)
+		meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+}
+
+bool MeshletBuilder::isBackfacing(const Meshlet &meshlet, const glm::vec3 &cameraPos)
+{
+	// Conservative test that holds for every point of the bounding sphere, not just its center
+	glm::vec3 toCenter = meshlet.center - cameraPos;
+	return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
+
+bool MeshletBuilder::isOutsideFrustum(const Meshlet &meshlet, const std::array<glm::vec4, 6> &frustumPlanes)
+{
+	for (const auto &plane : frustumPlanes)
+	{
+		if (glm::dot(glm::vec3{plane.x, plane.y, plane.z}, meshlet.center) + plane.w < -meshlet.radius)
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,282 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace N
+{
+namespace
+{
+// Linear values are encoded back to sRGB through a table this fine, which keeps every byte that is averaged with
+// itself unchanged
+constexpr int linearSteps = 8192;
+
+struct SrgbTables
+{
+	float toLinear[256];
+	unsigned char fromLinear[linearSteps];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < linearSteps; i++)
+		{
+			float l = static_cast<float>(i) / (linearSteps - 1);
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+			fromLinear[i] = static_cast<unsigned char>(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+		}
+	}
+};
+
+const SrgbTables &getSrgbTables()
+{
+	static const SrgbTables tables;
+	return tables;
+}
+
+float decodeNormal(unsigned char value)
+{
+	return value * (2.f / 255.f) - 1.f;
+}
+
+unsigned char encodeNormal(float value)
+{
+	return static_cast<unsigned char>(std::clamp(value * 127.5f + 128.f, 0.f, 255.f));
+}
+
+#ifdef MIP_GENERATOR_SSE
+// X and Y of eight RG8 texels, even texels in the first of each pair, odd texels in the second
+inline void loadNormals(const unsigned char *texels, __m128 &evenX, __m128 &evenY, __m128 &oddX, __m128 &oddY)
+{
+	__m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels));
+	__m128i x = _mm_and_si128(pairs, _mm_set1_epi16(0xFF));
+	__m128i y = _mm_srli_epi16(pairs, 8);
+	__m128i lowHalf = _mm_set1_epi32(0xFFFF);
+
+	__m128 scale = _mm_set1_ps(2.f / 255.f);
+	__m128 one = _mm_set1_ps(1.f);
+	evenX = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(x, lowHalf)), scale), one);
+	evenY = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(y, lowHalf)), scale), one);
+	oddX = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 16)), scale), one);
+	oddY = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(y, 16)), scale), one);
+}
+
+inline void addNormal(__m128 x, __m128 y, __m128 &sumX, __m128 &sumY, __m128 &sumZ)
+{
+	__m128 zSquared = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+	sumX = _mm_add_ps(sumX, x);
+	sumY = _mm_add_ps(sumY, y);
+	sumZ = _mm_add_ps(sumZ, _mm_sqrt_ps(_mm_max_ps(zSquared, _mm_setzero_ps())));
+}
+#endif
+} // namespace
+
+void MipGenerator::downsample(const unsigned char *source, uint32_t width, uint32_t height, uint32_t texelSize,
+							  TexelContent content, unsigned char *destination)
+{
+	if ((content == TexelContent::SrgbColor && texelSize != 4) ||
+		(content == TexelContent::NormalXY && texelSize != 2) || texelSize == 0 || texelSize > 4)
+	{
+		throw std::runtime_error("Mip maps cannot be generated for this texel layout");
+	}
+
+	uint32_t mipWidth = std::max(width / 2, 1u);
+	uint32_t mipHeight = std::max(height / 2, 1u);
+	size_t rowSize = static_cast<size_t>(width) * texelSize;
+	size_t mipRowSize = static_cast<size_t>(mipWidth) * texelSize;
+
+	for (uint32_t y = 0; y < mipHeight; y++)
+	{
+		const unsigned char *row0 = source + 2 * y * rowSize;
+		// A level one texel high is only filtered horizontally
+		const unsigned char *row1 = height > 1 ? row0 + rowSize : row0;
+		unsigned char *mipRow = destination + y * mipRowSize;
+
+		switch (content)
+		{
+		case TexelContent::SrgbColor:
+			downsampleSrgb(row0, row1, width, mipRow);
+			break;
+		case TexelContent::Linear:
+			downsampleLinear(row0, row1, width, texelSize, mipRow);
+			break;
+		case TexelContent::NormalXY:
+			downsampleNormal(row0, row1, width, mipRow);
+			break;
+		}
+	}
+}
+
+void MipGenerator::downsampleLinear(const unsigned char *row0, const unsigned char *row1, uint32_t width,
+									uint32_t texelSize, unsigned char *destination)
+{
+	uint32_t mipWidth = std::max(width / 2, 1u);
+	uint32_t x = 0;
+
+#ifdef MIP_GENERATOR_SSE
+	if (texelSize == 4 && width > 1)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i rounding = _mm_set1_epi16(2);
+
+		// Eight source texels of both rows make four mip texels
+		for (; x + 4 <= mipWidth; x += 4)
+		{
+			__m128i sums[2];
+			for (int half = 0; half < 2; half++)
+			{
+				size_t offset = (2 * static_cast<size_t>(x) + 4 * half) * 4;
+				__m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + offset));
+				__m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + offset));
+
+				// Texels 0 and 1, then 2 and 3, widened to 16 bits and summed vertically
+				__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				// Texel 0 + texel 1 and texel 2 + texel 3
+				sums[half] = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+				sums[half] = _mm_srli_epi16(_mm_add_epi16(sums[half], rounding), 2);
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + static_cast<size_t>(x) * 4),
+							 _mm_packus_epi16(sums[0], sums[1]));
+		}
+	}
+#endif
+
+	for (; x < mipWidth; x++)
+	{
+		const unsigned char *left = row0 + 2 * static_cast<size_t>(x) * texelSize;
+		size_t next = width > 1 ? texelSize : 0;
+		const unsigned char *bottomLeft = row1 + 2 * static_cast<size_t>(x) * texelSize;
+
+		for (uint32_t channel = 0; channel < texelSize; channel++)
+		{
+			uint32_t sum = left[channel] + left[next + channel] + bottomLeft[channel] + bottomLeft[next + channel];
+			destination[x * texelSize + channel] = static_cast<unsigned char>((sum + 2) / 4);
+		}
+	}
+}
+
+void MipGenerator::downsampleSrgb(const unsigned char *row0, const unsigned char *row1, uint32_t width,
+								  unsigned char *destination)
+{
+	const SrgbTables &tables = getSrgbTables();
+	uint32_t mipWidth = std::max(width / 2, 1u);
+	size_t next = width > 1 ? 4 : 0;
+
+	for (uint32_t x = 0; x < mipWidth; x++)
+	{
+		const unsigned char *texels[4] = {row0 + 8 * static_cast<size_t>(x), row0 + 8 * static_cast<size_t>(x) + next,
+										  row1 + 8 * static_cast<size_t>(x), row1 + 8 * static_cast<size_t>(x) + next};
+		unsigned char *mipTexel = destination + 4 * static_cast<size_t>(x);
+
+#ifdef MIP_GENERATOR_SSE
+		// Color decoded to linear and alpha as stored, so all four channels are averaged with one add per texel
+		__m128 sum = _mm_setzero_ps();
+		for (const unsigned char *texel : texels)
+		{
+			sum = _mm_add_ps(sum, _mm_setr_ps(tables.toLinear[texel[0]], tables.toLinear[texel[1]],
+											  tables.toLinear[texel[2]], static_cast<float>(texel[3])));
+		}
+
+		__m128 scale = _mm_setr_ps(0.25f * (linearSteps - 1), 0.25f * (linearSteps - 1), 0.25f * (linearSteps - 1),
+								   0.25f);
+		alignas(16) int32_t encoded[4];
+		_mm_store_si128(reinterpret_cast<__m128i *>(encoded),
+						_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(sum, scale), _mm_set1_ps(0.5f))));
+
+		mipTexel[0] = tables.fromLinear[encoded[0]];
+		mipTexel[1] = tables.fromLinear[encoded[1]];
+		mipTexel[2] = tables.fromLinear[encoded[2]];
+		mipTexel[3] = static_cast<unsigned char>(encoded[3]);
+#else
+		for (int channel = 0; channel < 3; channel++)
+		{
+			float sum = 0.f;
+			for (const unsigned char *texel : texels)
+				sum += tables.toLinear[texel[channel]];
+			mipTexel[channel] = tables.fromLinear[static_cast<int>(sum * 0.25f * (linearSteps - 1) + 0.5f)];
+		}
+
+		uint32_t alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+		mipTexel[3] = static_cast<unsigned char>((alpha + 2) / 4);
+#endif
+	}
+}
+
+void MipGenerator::downsampleNormal(const unsigned char *row0, const unsigned char *row1, uint32_t width,
+									unsigned char *destination)
+{
+	uint32_t mipWidth = std::max(width / 2, 1u);
+	uint32_t x = 0;
+
+#ifdef MIP_GENERATOR_SSE
+	if (width > 1)
+	{
+		// Eight source texels of both rows make four mip texels, one per lane
+		for (; x + 4 <= mipWidth; x += 4)
+		{
+			__m128 sumX = _mm_setzero_ps();
+			__m128 sumY = _mm_setzero_ps();
+			__m128 sumZ = _mm_setzero_ps();
+			for (const unsigned char *row : {row0, row1})
+			{
+				__m128 evenX, evenY, oddX, oddY;
+				loadNormals(row + 4 * static_cast<size_t>(x), evenX, evenY, oddX, oddY);
+				addNormal(evenX, evenY, sumX, sumY, sumZ);
+				addNormal(oddX, oddY, sumX, sumY, sumZ);
+			}
+
+			// Normals that cancel out leave X and Y at zero, which the shader reads as pointing straight out
+			__m128 length = _mm_sqrt_ps(
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(sumX, sumX), _mm_mul_ps(sumY, sumY)), _mm_mul_ps(sumZ, sumZ)));
+			__m128 valid = _mm_cmpgt_ps(length, _mm_setzero_ps());
+			__m128 inverseLength = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), length));
+
+			__m128 scale = _mm_set1_ps(127.5f);
+			__m128 bias = _mm_set1_ps(128.f);
+			__m128i encodedX = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(sumX, inverseLength), scale), bias));
+			__m128i encodedY = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(sumY, inverseLength), scale), bias));
+
+			// X0 X1 X2 X3 Y0 Y1 Y2 Y3 interleaved into X0 Y0 X1 Y1 ...
+			__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(encodedX, encodedY), _mm_setzero_si128());
+			__m128i texels = _mm_unpacklo_epi8(bytes, _mm_srli_si128(bytes, 4));
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(destination + 2 * static_cast<size_t>(x)), texels);
+		}
+	}
+#endif
+
+	size_t next = width > 1 ? 2 : 0;
+	for (; x < mipWidth; x++)
+	{
+		const unsigned char *texels[4] = {row0 + 4 * static_cast<size_t>(x), row0 + 4 * static_cast<size_t>(x) + next,
+										  row1 + 4 * static_cast<size_t>(x), row1 + 4 * static_cast<size_t>(x) + next};
+
+		float sumX = 0.f, sumY = 0.f, sumZ = 0.f;
+		for (const unsigned char *texel : texels)
+		{
+			float normalX = decodeNormal(texel[0]);
+			float normalY = decodeNormal(texel[1]);
+			sumX += normalX;
+			sumY += normalY;
+			sumZ += std::sqrt(std::max(1.f - normalX * normalX - normalY * normalY, 0.f));
+		}
+
+		float length = std::sqrt(sumX * sumX + sumY * sumY + sumZ * sumZ);
+		float inverseLength = length > 0.f ? 1.f / length : 0.f;
+		destination[2 * x] = encodeNormal(sumX * inverseLength);
+		destination[2 * x + 1] = encodeNormal(sumY * inverseLength);
+	}
+}
+} // namespace N
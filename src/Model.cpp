@@ -1,58 +1,298 @@
 #include "Model.h"
 
+#include "MeshCache.h"
+#include "ObjParser.h"
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
 namespace N
 {
-Model::Model(const ModelCreateInfo &createInfo, const char *path)
+Model::Model(const ModelCreateInfo &createInfo, const char *path) : textureCache(createInfo.textureCache)
 {
-	tinyobj::ObjReaderConfig objReaderConfig;
-	objReaderConfig.triangulate = true;
+	std::vector<tinyobj::material_t> objMaterials;
+
+	uint64_t sourceHash = createInfo.useMeshCache ? MeshCache::hashSourceFile(path) : 0;
+	std::string cachePath = MeshCache::getCachePath(path);
 
-	tinyobj::ObjReader objReader;
-	objReader.ParseFromFile(path, objReaderConfig);
+	uint32_t buildFlags = 0;
+	if (createInfo.optimizeMeshes)
+		buildFlags |= MeshCache::optimizedFlag;
+	if (createInfo.optimizeMeshes && createInfo.optimizeOverdraw)
+		buildFlags |= MeshCache::overdrawFlag;
+	if (createInfo.generateLods)
+		buildFlags |= MeshCache::lodFlag;
 
-	for (const auto &material : objReader.GetMaterials())
+	if (sourceHash != 0 && MeshCache::load(cachePath, sourceHash, buildFlags, objMaterials, meshes))
 	{
-		Material cur(createInfo.vmaAllocator, createInfo.device, createInfo.queue, createInfo.commandBuffer, material);
-		cur.createSampler(createInfo.device, createInfo.maxAnisotropy);
-		cur.createDescriptorSets(createInfo.device, createInfo.descriptorPool, createInfo.descriptorSetLayout);
-		materials.push_back(std::move(cur));
+		std::cout << "Loaded " << meshes.size() << " meshes from " << cachePath << std::endl;
 	}
+	else
+	{
+		if (createInfo.parallelObjParsing)
+		{
+			auto parseStartTime = std::chrono::high_resolution_clock::now();
 
-	for (const auto &shape : objReader.GetShapes())
+			ObjData objData = ObjParser::parse(path, createInfo.threadPool);
+
+			auto parseEndTime = std::chrono::high_resolution_clock::now();
+			auto elapsedTime = static_cast<std::chrono::duration<float, std::chrono::milliseconds::period>>(
+				parseEndTime - parseStartTime);
+			std::cout << "Parsed " << path << " in " << elapsedTime.count() << " milliseconds" << std::endl;
+
+			objMaterials = std::move(objData.materials);
+			buildMeshes(createInfo, objData.shapes, objData.attrib);
+		}
+		else
+		{
+			tinyobj::ObjReaderConfig objReaderConfig;
+			objReaderConfig.triangulate = true;
+
+			tinyobj::ObjReader objReader;
+			objReader.ParseFromFile(path, objReaderConfig);
+
+			objMaterials = objReader.GetMaterials();
+			buildMeshes(createInfo, objReader.GetShapes(), objReader.GetAttrib());
+		}
+
+		if (sourceHash != 0)
+			MeshCache::store(cachePath, sourceHash, buildFlags, objMaterials, meshes);
+	}
+
+	// Meshes are not split, indices past the limit would be undefined to draw
+	for (const auto &mesh : meshes)
 	{
-		meshes.emplace_back(shape, objReader.GetAttrib(), shape.mesh.material_ids.at(0));
+		size_t vertexCount = mesh.getVertices().size();
+		if (vertexCount > static_cast<size_t>(createInfo.maxDrawIndexedIndexValue) + 1)
+			throw std::runtime_error(std::string("A mesh of ") + path + " has " + std::to_string(vertexCount) +
+									 " vertices, more than the device can index");
 	}
 
+	if (createInfo.buildMeshlets)
+		buildMeshlets(createInfo);
+
+	MaterialCreateInfo materialCreateInfo{};
+	materialCreateInfo.vmaAllocator = createInfo.vmaAllocator;
+	materialCreateInfo.physicalDevice = createInfo.physicalDevice;
+	materialCreateInfo.device = createInfo.device;
+	materialCreateInfo.stagingUploader = createInfo.stagingUploader;
+	materialCreateInfo.queue = createInfo.queue;
+	materialCreateInfo.commandBuffer = createInfo.commandBuffer;
+	materialCreateInfo.threadPool = createInfo.threadPool;
+	materialCreateInfo.textureCache = createInfo.textureCache;
+	materialCreateInfo.compressedTextures = createInfo.compressedTextures;
+	materialCreateInfo.cpuMipMaps = createInfo.cpuMipMaps;
+	materialCreateInfo.textureStreamer = createInfo.textureStreamer;
+
+	for (const auto &material : objMaterials)
+	{
+		Material cur(materialCreateInfo, material);
+		cur.createSampler(*createInfo.samplerCache, createInfo.maxAnisotropy);
+		cur.createDescriptorSets(createInfo.device, createInfo.descriptorPool, createInfo.descriptorSetLayout);
+		materials.push_back(std::move(cur));
+	}
+
+	// Submits the staged textures along with the meshes
 	uploadMeshes(createInfo);
 }
 
-void Model::draw(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout) const
+uint64_t Model::draw(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout,
+					 const LodSelectInfo &lodSelectInfo, GeometryBindState &bindState) const
 {
+	uint64_t triangleCount = 0;
+
 	for (const auto &mesh : meshes)
 	{
+		uint32_t lod = mesh.selectLod(model, lodSelectInfo);
+		triangleCount += mesh.getLods()[lod].indexCount / 3;
+
 		materials.at(mesh.getMaterialId()).bind(commandBuffer, pipelineLayout);
-		mesh.draw(commandBuffer);
+		mesh.draw(commandBuffer, pipelineLayout, *geometryArena, bindState, lod);
+	}
+
+	return triangleCount;
+}
+
+void Model::requestTextures(TextureStreamer &textureStreamer, const LodSelectInfo &lodSelectInfo) const
+{
+	for (const auto &mesh : meshes)
+	{
+		// Assumes the texture is mapped across the mesh once
+		float pixels = mesh.getProjectedSize(model, lodSelectInfo);
+		materials.at(mesh.getMaterialId()).requestTextures(textureStreamer, pixels);
+	}
+}
+
+void Model::refreshMaterials(const vk::Device &device, DeletionQueue &deletionQueue, uint64_t timelineValue)
+{
+	for (auto &material : materials)
+	{
+		material.refreshDescriptorSets(device, deletionQueue, timelineValue);
+	}
+}
+
+void Model::trackTextures(TextureStreamer &textureStreamer) const
+{
+	for (const auto &material : materials)
+	{
+		material.trackTextures(textureStreamer);
 	}
 }
 
+bool Model::acquireUploads(const vk::CommandBuffer &commandBuffer, uint64_t completedUploadValue)
+{
+	if (drawable)
+		return true;
+	if (meshUpload.timelineValue > completedUploadValue)
+		return false;
+
+	if (!meshUpload.acquireBarriers.empty())
+	{
+		// The submit this is recorded into waits for the upload timeline at vertex input
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eVertexInput,
+									  {}, nullptr, meshUpload.acquireBarriers, nullptr);
+	}
+	// Also takes the textures staged by the materials, and those of models that were destroyed before they were drawn
+	textureCache->acquireUploads(commandBuffer, meshUpload.timelineValue);
+
+	auto elapsedTime = static_cast<std::chrono::duration<float>>(std::chrono::high_resolution_clock::now() -
+																 meshUpload.startTime);
+	std::cout << "Uploaded " << meshUpload.bytes / (1024.f * 1024.f) << " MiB of mesh and texture data in "
+			  << meshUpload.submits << " submits within " << elapsedTime.count() * 1000.f << " milliseconds, "
+			  << meshUpload.bytes / (1024.f * 1024.f) / elapsedTime.count() << " MiB/s" << std::endl;
+
+	meshUpload = {};
+	drawable = true;
+	return true;
+}
+
 void Model::destroy(const VmaAllocator &vmaAllocator, const vk::Device &device)
 {
 	for (auto &mat : materials)
 	{
-		mat.destroy(vmaAllocator, device);
+		mat.destroy(device);
 	}
 
 	for (auto &mesh : meshes)
 	{
-		mesh.destroy(vmaAllocator);
+		mesh.destroy(*geometryArena);
+	}
+}
+
+void Model::buildMeshes(const ModelCreateInfo &createInfo, const std::vector<tinyobj::shape_t> &shapes,
+						const tinyobj::attrib_t &attrib)
+{
+	auto buildStartTime = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::optional<Mesh>> builtMeshes(shapes.size());
+	std::vector<std::pair<VertexCacheStats, VertexCacheStats>> cacheStats(shapes.size());
+
+	auto buildMesh = [&](size_t i) {
+		builtMeshes[i].emplace(shapes[i], attrib, shapes[i].mesh.material_ids.at(0));
+
+		if (createInfo.optimizeMeshes)
+			cacheStats[i] = builtMeshes[i]->optimize(createInfo.optimizeOverdraw);
+
+		if (createInfo.generateLods)
+			builtMeshes[i]->buildLods();
+	};
+
+	if (createInfo.threadPool)
+	{
+		// Shapes are independent of each other so they can be built in any order, then moved over in file order
+		createInfo.threadPool->parallelFor(shapes.size(), buildMesh);
+	}
+	else
+	{
+		for (size_t i = 0; i < shapes.size(); i++)
+		{
+			buildMesh(i);
+		}
+	}
+
+	meshes.reserve(shapes.size());
+	for (auto &mesh : builtMeshes)
+	{
+		meshes.push_back(std::move(mesh.value()));
+	}
+
+	auto buildEndTime = std::chrono::high_resolution_clock::now();
+	auto elapsedTime =
+		static_cast<std::chrono::duration<float, std::chrono::milliseconds::period>>(buildEndTime - buildStartTime);
+
+	uint32_t threadCount = createInfo.threadPool ? createInfo.threadPool->getThreadCount() : 1;
+	std::cout << "Built " << meshes.size() << " meshes on " << threadCount << " threads in " << elapsedTime.count()
+			  << " milliseconds" << std::endl;
+
+	if (createInfo.generateLods)
+	{
+		size_t lodCount = 0;
+		for (const auto &mesh : meshes)
+		{
+			lodCount += mesh.getLods().size() - 1;
+		}
+
+		std::cout << "Generated " << lodCount << " levels of detail" << std::endl;
+	}
+
+	if (createInfo.optimizeMeshes)
+	{
+		VertexCacheStats before, after;
+		for (size_t i = 0; i < cacheStats.size(); i++)
+		{
+			const auto &[meshBefore, meshAfter] = cacheStats[i];
+			std::cout << "Mesh " << shapes[i].name << ": vertex cache ACMR " << meshBefore.acmr() << " -> "
+					  << meshAfter.acmr() << ", ATVR " << meshBefore.atvr() << " -> " << meshAfter.atvr() << std::endl;
+			before += meshBefore;
+			after += meshAfter;
+		}
+
+		std::cout << "Vertex cache ACMR " << before.acmr() << " -> " << after.acmr() << ", ATVR " << before.atvr()
+				  << " -> " << after.atvr() << std::endl;
+	}
+}
+
+void Model::buildMeshlets(const ModelCreateInfo &createInfo)
+{
+	auto buildStartTime = std::chrono::high_resolution_clock::now();
+
+	if (createInfo.threadPool)
+	{
+		createInfo.threadPool->parallelFor(meshes.size(), [this](size_t i) { meshes[i].buildMeshlets(); });
+	}
+	else
+	{
+		for (auto &mesh : meshes)
+		{
+			mesh.buildMeshlets();
+		}
 	}
+
+	auto buildEndTime = std::chrono::high_resolution_clock::now();
+	auto elapsedTime =
+		static_cast<std::chrono::duration<float, std::chrono::milliseconds::period>>(buildEndTime - buildStartTime);
+
+	size_t meshletCount = 0;
+	for (const auto &mesh : meshes)
+	{
+		meshletCount += mesh.getMeshletData().meshlets.size();
+	}
+
+	std::cout << "Built " << meshletCount << " meshlets in " << elapsedTime.count() << " milliseconds" << std::endl;
 }
 
 void Model::uploadMeshes(const ModelCreateInfo &createInfo)
 {
+	geometryArena = createInfo.geometryArena;
+
 	for (auto &mesh : meshes)
 	{
-		mesh.uploadMesh(createInfo.vmaAllocator, createInfo.queue, createInfo.commandBuffer);
+		mesh.uploadMesh(*geometryArena, *createInfo.stagingUploader, createInfo.vertexFormat);
 	}
+
+	meshUpload = createInfo.stagingUploader->submitBatch();
 }
 } // namespace N
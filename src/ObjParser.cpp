@@ -0,0 +1,464 @@
+#include "ObjParser.h"
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+namespace N
+{
+namespace
+{
+constexpr size_t chunkSize = 16 << 20;
+
+// A run of faces sharing one object name and material. Every o, g or usemtl line starts a new segment, the first
+// segment of a chunk continues whatever state the previous chunk ended with.
+struct Segment
+{
+	std::optional<std::string> name;
+	std::optional<std::string> material;
+	size_t triangleCount = 0;
+
+	// Filled in between the passes
+	size_t shapeIndex = 0;
+	size_t triangleOffset = 0;
+};
+
+struct Chunk
+{
+	size_t begin;
+	size_t end;
+
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t texCoordCount = 0;
+	std::vector<Segment> segments;
+	std::vector<std::string> materialLibraries;
+
+	// Global index of the first attribute of each kind in this chunk, needed to resolve relative indices
+	size_t positionBase = 0;
+	size_t normalBase = 0;
+	size_t texCoordBase = 0;
+};
+
+enum class LineType
+{
+	eOther,
+	ePosition,
+	eNormal,
+	eTexCoord,
+	eFace,
+	eObject,
+	eMaterial,
+	eMaterialLibrary
+};
+
+bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *skipSpaces(const char *p, const char *end)
+{
+	while (p < end && isSpace(*p))
+		p++;
+	return p;
+}
+
+const char *skipToken(const char *p, const char *end)
+{
+	while (p < end && !isSpace(*p))
+		p++;
+	return p;
+}
+
+std::string_view trimmed(const char *p, const char *end)
+{
+	p = skipSpaces(p, end);
+	while (end > p && isSpace(end[-1]))
+		end--;
+	return std::string_view(p, end - p);
+}
+
+// Classifies the line and moves p past its keyword
+LineType classifyLine(const char *&p, const char *end)
+{
+	p = skipSpaces(p, end);
+	const char *keywordEnd = skipToken(p, end);
+	std::string_view keyword(p, keywordEnd - p);
+	p = keywordEnd;
+
+	if (keyword == "v")
+		return LineType::ePosition;
+	if (keyword == "vn")
+		return LineType::eNormal;
+	if (keyword == "vt")
+		return LineType::eTexCoord;
+	if (keyword == "f")
+		return LineType::eFace;
+	if (keyword == "o" || keyword == "g")
+		return LineType::eObject;
+	if (keyword == "usemtl")
+		return LineType::eMaterial;
+	if (keyword == "mtllib")
+		return LineType::eMaterialLibrary;
+	return LineType::eOther;
+}
+
+template <typename F> void forEachLine(const char *begin, const char *end, F &&function)
+{
+	while (begin < end)
+	{
+		const char *lineEnd = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+		if (!lineEnd)
+			lineEnd = end;
+
+		function(begin, lineEnd);
+		begin = lineEnd + 1;
+	}
+}
+
+size_t countTokens(const char *p, const char *end)
+{
+	size_t count = 0;
+	for (p = skipSpaces(p, end); p < end; p = skipSpaces(skipToken(p, end), end))
+		count++;
+	return count;
+}
+
+float parseFloat(const char *&p, const char *end)
+{
+	p = skipSpaces(p, end);
+	if (p < end && *p == '+')
+		p++;
+
+	float value = 0.f;
+	p = std::from_chars(p, end, value).ptr;
+	return value;
+}
+
+// Converts a 1 based or negative relative OBJ index to a 0 based one, returns false for invalid indices
+bool parseIndex(const char *&p, const char *end, size_t count, int &index)
+{
+	int value = 0;
+	auto [next, error] = std::from_chars(p, end, value);
+	if (error != std::errc{} || value == 0)
+		return false;
+
+	p = next;
+	index = value > 0 ? value - 1 : static_cast<int>(count) + value;
+	return index >= 0;
+}
+
+// v, v/vt, v//vn or v/vt/vn
+bool parseCorner(const char *&p, const char *end, const size_t counts[3], tinyobj::index_t &corner)
+{
+	corner = {-1, -1, -1};
+
+	if (!parseIndex(p, end, counts[0], corner.vertex_index))
+		return false;
+
+	if (p < end && *p == '/')
+	{
+		p++;
+		if (p < end && *p != '/' && !isSpace(*p) && !parseIndex(p, end, counts[1], corner.texcoord_index))
+			return false;
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (!parseIndex(p, end, counts[2], corner.normal_index))
+				return false;
+		}
+	}
+
+	return p == end || isSpace(*p);
+}
+
+std::vector<Chunk> splitChunks(const MappedFile &file)
+{
+	const char *data = reinterpret_cast<const char *>(file.data());
+	size_t size = file.size();
+
+	std::vector<Chunk> chunks;
+	size_t begin = 0;
+	while (begin < size)
+	{
+		size_t end = std::min(begin + chunkSize, size);
+
+		// Move the split to the end of the line it landed in
+		if (end < size)
+		{
+			const char *newline = static_cast<const char *>(std::memchr(data + end, '\n', size - end));
+			end = newline ? static_cast<size_t>(newline - data) + 1 : size;
+		}
+
+		Chunk chunk;
+		chunk.begin = begin;
+		chunk.end = end;
+		chunks.push_back(std::move(chunk));
+
+		begin = end;
+	}
+
+	return chunks;
+}
+
+void countChunk(const char *data, Chunk &chunk)
+{
+	chunk.segments.emplace_back();
+
+	forEachLine(data + chunk.begin, data + chunk.end, [&](const char *p, const char *end) {
+		switch (classifyLine(p, end))
+		{
+		case LineType::ePosition:
+			chunk.positionCount++;
+			break;
+		case LineType::eNormal:
+			chunk.normalCount++;
+			break;
+		case LineType::eTexCoord:
+			chunk.texCoordCount++;
+			break;
+		case LineType::eFace: {
+			size_t cornerCount = countTokens(p, end);
+			if (cornerCount >= 3)
+				chunk.segments.back().triangleCount += cornerCount - 2;
+			break;
+		}
+		case LineType::eObject:
+			chunk.segments.emplace_back().name = trimmed(p, end);
+			break;
+		case LineType::eMaterial:
+			chunk.segments.emplace_back().material = trimmed(p, end);
+			break;
+		case LineType::eMaterialLibrary:
+			chunk.materialLibraries.emplace_back(trimmed(p, end));
+			break;
+		case LineType::eOther:
+			break;
+		}
+	});
+}
+
+void parseChunk(const char *data, const Chunk &chunk, ObjData &objData)
+{
+	auto &attrib = objData.attrib;
+
+	size_t positionIndex = chunk.positionBase;
+	size_t normalIndex = chunk.normalBase;
+	size_t texCoordIndex = chunk.texCoordBase;
+
+	size_t segmentIndex = 0;
+	size_t triangleIndex = chunk.segments[0].triangleOffset;
+
+	std::vector<tinyobj::index_t> corners;
+
+	forEachLine(data + chunk.begin, data + chunk.end, [&](const char *line, const char *end) {
+		const char *p = line;
+		switch (classifyLine(p, end))
+		{
+		case LineType::ePosition:
+			for (int i = 0; i < 3; i++)
+				attrib.vertices[3 * positionIndex + i] = parseFloat(p, end);
+			positionIndex++;
+			break;
+		case LineType::eNormal:
+			for (int i = 0; i < 3; i++)
+				attrib.normals[3 * normalIndex + i] = parseFloat(p, end);
+			normalIndex++;
+			break;
+		case LineType::eTexCoord:
+			for (int i = 0; i < 2; i++)
+				attrib.texcoords[2 * texCoordIndex + i] = parseFloat(p, end);
+			texCoordIndex++;
+			break;
+		case LineType::eFace: {
+			// Relative indices count from the attributes defined before this line
+			size_t counts[3] = {positionIndex, texCoordIndex, normalIndex};
+
+			corners.clear();
+			for (p = skipSpaces(p, end); p < end; p = skipSpaces(p, end))
+			{
+				if (!parseCorner(p, end, counts, corners.emplace_back()))
+					throw std::runtime_error("Invalid face: " + std::string(trimmed(line, end)));
+			}
+
+			if (corners.size() < 3)
+				break;
+
+			// Other chunks write to the same shape, but never to the same triangles
+			auto &indices = objData.shapes[chunk.segments[segmentIndex].shapeIndex].mesh.indices;
+			for (size_t i = 1; i + 1 < corners.size(); i++)
+			{
+				indices[3 * triangleIndex] = corners[0];
+				indices[3 * triangleIndex + 1] = corners[i];
+				indices[3 * triangleIndex + 2] = corners[i + 1];
+				triangleIndex++;
+			}
+			break;
+		}
+		case LineType::eObject:
+		case LineType::eMaterial:
+			segmentIndex++;
+			triangleIndex = chunk.segments[segmentIndex].triangleOffset;
+			break;
+		case LineType::eMaterialLibrary:
+		case LineType::eOther:
+			break;
+		}
+	});
+}
+
+std::vector<tinyobj::material_t> loadMaterials(const std::string &objPath,
+											   const std::vector<std::string> &materialLibraries,
+											   std::map<std::string, int> &materialIds)
+{
+	std::string directory;
+	size_t separator = objPath.find_last_of("/\\");
+	if (separator != std::string::npos)
+		directory = objPath.substr(0, separator + 1);
+
+	std::vector<tinyobj::material_t> materials;
+	for (const auto &library : materialLibraries)
+	{
+		std::ifstream stream(directory + library);
+		if (!stream)
+			continue;
+
+		std::string warning, error;
+		tinyobj::LoadMtl(&materialIds, &materials, &stream, &warning, &error);
+	}
+
+	return materials;
+}
+
+// Walks the segments in file order, assigning each one its shape and triangle offset and every chunk its attribute
+// bases, then sizes all output arrays
+void layoutShapes(std::vector<Chunk> &chunks, const std::map<std::string, int> &materialIds, ObjData &objData)
+{
+	std::string name;
+	std::string material;
+
+	std::vector<size_t> triangleCounts;
+	std::vector<std::string> shapeMaterials;
+	std::optional<size_t> currentShape;
+	std::string currentMaterial;
+
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t texCoordCount = 0;
+
+	for (auto &chunk : chunks)
+	{
+		chunk.positionBase = positionCount;
+		chunk.normalBase = normalCount;
+		chunk.texCoordBase = texCoordCount;
+		positionCount += chunk.positionCount;
+		normalCount += chunk.normalCount;
+		texCoordCount += chunk.texCoordCount;
+
+		for (auto &segment : chunk.segments)
+		{
+			if (segment.name)
+			{
+				name = *segment.name;
+				currentShape.reset();
+			}
+			if (segment.material)
+			{
+				material = *segment.material;
+				if (material != currentMaterial)
+					currentShape.reset();
+			}
+
+			if (segment.triangleCount == 0)
+				continue;
+
+			if (!currentShape)
+			{
+				currentShape = objData.shapes.size();
+				currentMaterial = material;
+				objData.shapes.emplace_back().name = name;
+				shapeMaterials.push_back(material);
+				triangleCounts.push_back(0);
+			}
+
+			segment.shapeIndex = *currentShape;
+			segment.triangleOffset = triangleCounts[*currentShape];
+			triangleCounts[*currentShape] += segment.triangleCount;
+		}
+	}
+
+	objData.attrib.vertices.resize(3 * positionCount);
+	objData.attrib.normals.resize(3 * normalCount);
+	objData.attrib.texcoords.resize(2 * texCoordCount);
+
+	for (size_t i = 0; i < objData.shapes.size(); i++)
+	{
+		auto &mesh = objData.shapes[i].mesh;
+		auto materialId = materialIds.find(shapeMaterials[i]);
+
+		mesh.indices.resize(3 * triangleCounts[i]);
+		mesh.num_face_vertices.assign(triangleCounts[i], 3);
+		mesh.material_ids.assign(triangleCounts[i], materialId == materialIds.end() ? -1 : materialId->second);
+	}
+}
+} // namespace
+
+ObjData ObjParser::parse(const char *path, ThreadPool *threadPool)
+{
+	MappedFile file;
+	if (!file.open(path))
+		throw std::runtime_error(std::string("Failed to open OBJ file: ").append(path));
+
+	const char *data = reinterpret_cast<const char *>(file.data());
+	std::vector<Chunk> chunks = splitChunks(file);
+
+	auto forEachChunk = [&](const std::function<void(size_t)> &function) {
+		if (threadPool)
+		{
+			threadPool->parallelFor(chunks.size(), function);
+		}
+		else
+		{
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				function(i);
+			}
+		}
+	};
+
+	forEachChunk([&](size_t i) {
+		countChunk(data, chunks[i]);
+		file.release(chunks[i].begin, chunks[i].end - chunks[i].begin);
+	});
+
+	std::vector<std::string> materialLibraries;
+	for (const auto &chunk : chunks)
+	{
+		materialLibraries.insert(materialLibraries.end(), chunk.materialLibraries.begin(),
+								 chunk.materialLibraries.end());
+	}
+
+	ObjData objData;
+	std::map<std::string, int> materialIds;
+	objData.materials = loadMaterials(path, materialLibraries, materialIds);
+
+	layoutShapes(chunks, materialIds, objData);
+
+	forEachChunk([&](size_t i) {
+		parseChunk(data, chunks[i], objData);
+		file.release(chunks[i].begin, chunks[i].end - chunks[i].begin);
+	});
+
+	return objData;
+}
+} // namespace N
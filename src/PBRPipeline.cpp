@@ -8,7 +8,7 @@ namespace N
 {
 void PBRPipeline::create(const PBRPipelineCreateInfo &createInfo)
 {
-	createShaderModules(createInfo.device);
+	createShaderModules(createInfo.device, createInfo.vertexFormat);
 
 	// Shader Stages
 	vk::PipelineShaderStageCreateInfo vertexShaderStageCreateInfo;
@@ -34,8 +34,12 @@ void PBRPipeline::create(const PBRPipelineCreateInfo &createInfo)
 	pipelineDynamicStateCreateInfo.setDynamicStates(dynamicStates);
 
 	// Vertex Input
-	auto vertexAttributeDescription = Vertex::getAttributeDescription();
-	auto vertexBindingDescription = Vertex::getBindingDescription();
+	auto vertexAttributeDescription = createInfo.vertexFormat == VertexFormat::ePacked
+										  ? PackedVertex::getAttributeDescription()
+										  : Vertex::getAttributeDescription();
+	auto vertexBindingDescription = createInfo.vertexFormat == VertexFormat::ePacked
+										? PackedVertex::getBindingDescription()
+										: Vertex::getBindingDescription();
 
 	vk::PipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo;
 	pipelineVertexInputStateCreateInfo.setVertexAttributeDescriptionCount(vertexAttributeDescription.size());
@@ -93,7 +97,10 @@ void PBRPipeline::create(const PBRPipelineCreateInfo &createInfo)
 	// Push Constants
 	vk::PushConstantRange pushConstants;
 	pushConstants.setOffset(0);
-	pushConstants.setSize(sizeof(MVPPushConstant));
+	// Packed vertices need their per mesh decode constants right after the MVP matrices
+	pushConstants.setSize(createInfo.vertexFormat == VertexFormat::ePacked
+							  ? sizeof(MVPPushConstant) + sizeof(PackedVertexDecode)
+							  : sizeof(MVPPushConstant));
 	pushConstants.setStageFlags(vk::ShaderStageFlagBits::eVertex);
 
 	// Descriptor Set Layouts
@@ -103,26 +110,21 @@ void PBRPipeline::create(const PBRPipelineCreateInfo &createInfo)
 	diffuseSamplerBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
 	diffuseSamplerBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
-	vk::DescriptorSetLayoutBinding metallicSamplerBinding{};
-	metallicSamplerBinding.setBinding(1);
-	metallicSamplerBinding.setDescriptorCount(1);
-	metallicSamplerBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-	metallicSamplerBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
-
-	vk::DescriptorSetLayoutBinding roughnessSamplerBinding{};
-	roughnessSamplerBinding.setBinding(2);
-	roughnessSamplerBinding.setDescriptorCount(1);
-	roughnessSamplerBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-	roughnessSamplerBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+	// Occlusion, roughness and metallic packed into one texture
+	vk::DescriptorSetLayoutBinding ormSamplerBinding{};
+	ormSamplerBinding.setBinding(1);
+	ormSamplerBinding.setDescriptorCount(1);
+	ormSamplerBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	ormSamplerBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
 	vk::DescriptorSetLayoutBinding normalSamplerBinding{};
-	normalSamplerBinding.setBinding(3);
+	normalSamplerBinding.setBinding(2);
 	normalSamplerBinding.setDescriptorCount(1);
 	normalSamplerBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
 	normalSamplerBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
-	std::array<vk::DescriptorSetLayoutBinding, 4> textureBindings{diffuseSamplerBinding, metallicSamplerBinding,
-																  roughnessSamplerBinding, normalSamplerBinding};
+	std::array<vk::DescriptorSetLayoutBinding, 3> textureBindings{diffuseSamplerBinding, ormSamplerBinding,
+																  normalSamplerBinding};
 
 	vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
 	descriptorSetLayoutCI.setBindingCount(textureBindings.size());
@@ -134,7 +136,8 @@ void PBRPipeline::create(const PBRPipelineCreateInfo &createInfo)
 	renderInfoBinding.setBinding(4);
 	renderInfoBinding.setDescriptorCount(1);
 	renderInfoBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
-	renderInfoBinding.setDescriptorType(vk::DescriptorType::eUniformBuffer);
+	// Per frame data lives in the uniform ring, the offset of the current frame is given when binding
+	renderInfoBinding.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic);
 
 	descriptorSetLayoutCI.setBindingCount(1);
 	descriptorSetLayoutCI.setBindings(renderInfoBinding);
@@ -184,9 +187,10 @@ void PBRPipeline::destroy(const vk::Device &device)
 	device.destroyPipeline(pipeline);
 }
 
-void PBRPipeline::createShaderModules(const vk::Device &device)
+void PBRPipeline::createShaderModules(const vk::Device &device, VertexFormat vertexFormat)
 {
-	auto vertexShaderCode = loadShaderCode("shaders/vert.spv");
+	auto vertexShaderCode =
+		loadShaderCode(vertexFormat == VertexFormat::ePacked ? "shaders/vert_packed.spv" : "shaders/vert.spv");
 	auto fragmentShaderCode = loadShaderCode("shaders/frag.spv");
 
 	vk::ShaderModuleCreateInfo vertexShaderModuleCreateInfo;
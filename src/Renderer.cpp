@@ -16,20 +16,34 @@
 #include <vulkan/vulkan_handles.hpp>
 #include <vulkan/vulkan_structs.hpp>
 #include <vulkan/vulkan_to_string.hpp>
+#include <memory>
 #include <optional>
+#include <string_view>
 
 namespace N
 {
-Renderer::Renderer(GLFWwindow *window)
+Renderer::Renderer(GLFWwindow *window, const RendererSettings &settings)
+	: settings(settings), threadPool(settings.workerThreadCount)
 {
 	this->window = window;
 
 	createInstance();
 	selectPhysicalDevice();
 	selectGraphicsQueue();
+	selectTransferQueue();
 	createDevice();
 
 	graphicsQueue = device.getQueue(graphicsQueueIndex, 0);
+	if (transferQueueIndex != graphicsQueueIndex)
+	{
+		transferQueue = device.getQueue(transferQueueIndex, 0);
+	}
+	else
+	{
+		// A second queue of the graphics family still keeps uploads from queueing behind frames
+		uint32_t queueCount = physicalDevice.getQueueFamilyProperties().at(graphicsQueueIndex).queueCount;
+		transferQueue = device.getQueue(graphicsQueueIndex, queueCount > 1 ? 1 : 0);
+	}
 
 	createCommandPool();
 	createCommandBuffers();
@@ -41,6 +55,8 @@ Renderer::Renderer(GLFWwindow *window)
 	vmaCreateInfo.instance = instance;
 	vmaCreateInfo.physicalDevice = physicalDevice;
 	vmaCreateInfo.vulkanApiVersion = vk::enumerateInstanceVersion();
+	if (memoryBudgetSupported)
+		vmaCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 	vmaCreateAllocator(&vmaCreateInfo, &vmaAllocator);
 
 	glfwCreateWindowSurface(instance, window, nullptr, reinterpret_cast<VkSurfaceKHR *>(&surface));
@@ -62,10 +78,19 @@ Renderer::Renderer(GLFWwindow *window)
 	renderPassCreateInfo.samples = samples;
 	renderPass.create(renderPassCreateInfo);
 
+	if (settings.vertexFormat == VertexFormat::ePacked && physicalDevice.getProperties().limits.maxPushConstantsSize <
+													  sizeof(N::MVPPushConstant) + sizeof(PackedVertexDecode))
+	{
+		std::cerr << "Packed vertices need more push constant space than the device has, using full vertices"
+				  << std::endl;
+		this->settings.vertexFormat = VertexFormat::eFull;
+	}
+
 	N::PBRPipelineCreateInfo pipelineCreateInfo;
 	pipelineCreateInfo.device = device;
 	pipelineCreateInfo.renderPass = renderPass.get();
 	pipelineCreateInfo.samples = samples;
+	pipelineCreateInfo.vertexFormat = this->settings.vertexFormat;
 	pipeline.create(pipelineCreateInfo);
 
 	createDepthObjects();
@@ -73,6 +98,44 @@ Renderer::Renderer(GLFWwindow *window)
 	createFrameBuffers();
 	createSyncObjects();
 	createDescriptorSet();
+
+	StagingUploaderCreateInfo stagingUploaderCreateInfo;
+	stagingUploaderCreateInfo.vmaAllocator = vmaAllocator;
+	stagingUploaderCreateInfo.device = device;
+	stagingUploaderCreateInfo.queue = transferQueue;
+	stagingUploaderCreateInfo.queueFamilyIndex = transferQueueIndex;
+	stagingUploaderCreateInfo.dstQueueFamilyIndex = graphicsQueueIndex;
+	stagingUploaderCreateInfo.minImageTransferGranularity =
+		physicalDevice.getQueueFamilyProperties().at(transferQueueIndex).minImageTransferGranularity;
+	stagingUploader.create(stagingUploaderCreateInfo);
+
+	GeometryArenaCreateInfo geometryArenaCreateInfo;
+	geometryArenaCreateInfo.vmaAllocator = vmaAllocator;
+	geometryArenaCreateInfo.vertexStride =
+		this->settings.vertexFormat == VertexFormat::ePacked ? sizeof(PackedVertex) : sizeof(Vertex);
+	geometryArena.create(geometryArenaCreateInfo);
+
+	TextureCacheCreateInfo textureCacheCreateInfo;
+	textureCacheCreateInfo.vmaAllocator = vmaAllocator;
+	textureCacheCreateInfo.device = device;
+	textureCache.create(textureCacheCreateInfo);
+
+	TextureStreamerCreateInfo textureStreamerCreateInfo;
+	textureStreamerCreateInfo.vmaAllocator = vmaAllocator;
+	textureStreamerCreateInfo.device = device;
+	textureStreamerCreateInfo.textureCache = &textureCache;
+	textureStreamerCreateInfo.deletionQueue = &deletionQueue;
+	textureStreamerCreateInfo.baseSize = settings.textureStreamingBaseSize;
+	textureStreamerCreateInfo.budgetFraction = settings.textureBudgetFraction;
+	textureStreamerCreateInfo.memoryLimit = settings.textureMemoryLimit;
+	textureStreamerCreateInfo.uploadLimit = settings.textureUploadLimit;
+	textureStreamerCreateInfo.holdFrames = settings.textureStreamingHoldFrames;
+	textureStreamer.create(textureStreamerCreateInfo);
+
+	SamplerCacheCreateInfo samplerCacheCreateInfo;
+	samplerCacheCreateInfo.device = device;
+	samplerCache.create(samplerCacheCreateInfo);
+
 	initializeImGui();
 
 	vk::Extent2D extent = physicalDevice.getSurfaceCapabilitiesKHR(surface).currentExtent;
@@ -98,28 +161,20 @@ void Renderer::createDescriptorSet()
 
 	cameraSettingsSet = device.allocateDescriptorSets(dsAllocInfo).at(0);
 
-	vk::BufferCreateInfo bCreateInfo{};
-	bCreateInfo.setUsage(vk::BufferUsageFlagBits::eUniformBuffer);
-	bCreateInfo.setSharingMode(vk::SharingMode::eExclusive);
-	bCreateInfo.setSize(sizeof(CameraSettings));
-
-	VmaAllocationCreateInfo bAllocInfo{};
-	bAllocInfo.usage = VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
-	bAllocInfo.flags = VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_MAPPED_BIT |
-					   VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-
-	vmaCreateBuffer(vmaAllocator, reinterpret_cast<VkBufferCreateInfo *>(&bCreateInfo), &bAllocInfo,
-					reinterpret_cast<VkBuffer *>(&cameraSettingsBuffer), &cameraSettingsBufferAllocation,
-					&cameraSettingsAllocInfo);
+	UniformRingCreateInfo uniformRingCreateInfo;
+	uniformRingCreateInfo.vmaAllocator = vmaAllocator;
+	uniformRingCreateInfo.framesInFlight = framesInFlight;
+	uniformRingCreateInfo.offsetAlignment = physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+	uniformRing.create(uniformRingCreateInfo);
 
 	vk::DescriptorBufferInfo dBufferInfo{};
-	dBufferInfo.setBuffer(cameraSettingsBuffer);
+	dBufferInfo.setBuffer(uniformRing.getBuffer());
 	dBufferInfo.setOffset(0);
 	dBufferInfo.setRange(sizeof(CameraSettings));
 
 	vk::WriteDescriptorSet write{};
 	write.setDescriptorCount(1);
-	write.setDescriptorType(vk::DescriptorType::eUniformBuffer);
+	write.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic);
 	write.setDstArrayElement(0);
 	write.setDstBinding(4);
 	write.setDstSet(cameraSettingsSet);
@@ -183,10 +238,12 @@ Renderer::~Renderer()
 {
 	device.waitIdle();
 
+	deletionQueue.flush();
+
 	device.resetDescriptorPool(descriptorPool);
 	device.destroyDescriptorPool(descriptorPool);
 
-	vmaDestroyBuffer(vmaAllocator, cameraSettingsBuffer, cameraSettingsBufferAllocation);
+	uniformRing.destroy();
 
 	for (int i = 0; i < framesInFlight; i++)
 	{
@@ -202,8 +259,15 @@ Renderer::~Renderer()
 		device.destroySemaphore(renderFinishedSemaphores[i]);
 		device.destroyFence(inFlightFences[i]);
 	}
+	device.destroySemaphore(frameTimeline);
 
 	device.freeCommandBuffers(commandPool, commandBuffers);
+	device.freeCommandBuffers(commandPool, uploadCommandBuffer);
+	stagingUploader.destroy();
+	geometryArena.destroy();
+	textureStreamer.destroy();
+	textureCache.destroy();
+	samplerCache.destroy();
 
 	vmaDestroyAllocator(vmaAllocator);
 
@@ -247,11 +311,20 @@ void Renderer::selectDepthFormat()
 
 void Renderer::createDescriptorPool()
 {
-	std::vector<vk::DescriptorPoolSize> poolSizes = {{vk::DescriptorType::eUniformBuffer, 100},
-													 {vk::DescriptorType::eCombinedImageSampler, 100}};
+	// Every material holds a set with its three textures. A streamed texture changing residency gives its material a
+	// new set while the old one waits in the deletion queue until the frames in flight using it complete, so room is
+	// left for that many replaced sets per material. The rest is the camera set and the ImGui font.
+	uint32_t materialSets = settings.maxMaterials * (framesInFlight + 1);
+
+	std::vector<vk::DescriptorPoolSize> poolSizes = {
+		{vk::DescriptorType::eUniformBuffer, 100},
+		{vk::DescriptorType::eUniformBufferDynamic, 10},
+		{vk::DescriptorType::eCombinedImageSampler, materialSets * 3 + 100}};
 
 	vk::DescriptorPoolCreateInfo createInfo;
-	createInfo.setMaxSets(100);
+	// Material descriptor sets are freed when their model is unloaded or their textures change residency
+	createInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+	createInfo.setMaxSets(materialSets + 100);
 	createInfo.setPoolSizeCount(poolSizes.size());
 	createInfo.setPoolSizes(poolSizes);
 
@@ -266,6 +339,9 @@ void Renderer::createCommandBuffers()
 	createInfo.setCommandBufferCount(framesInFlight);
 
 	commandBuffers = device.allocateCommandBuffers(createInfo);
+
+	createInfo.setCommandBufferCount(1);
+	uploadCommandBuffer = device.allocateCommandBuffers(createInfo).at(0);
 }
 
 void Renderer::createCommandPool()
@@ -325,20 +401,48 @@ void Renderer::createDevice()
 
 	std::vector<float> queuePriorities(queueFamilyProperties.queueCount, 1.f);
 
-	vk::DeviceQueueCreateInfo deviceQueueCreateInfo;
-	deviceQueueCreateInfo.setQueueFamilyIndex(graphicsQueueIndex);
-	deviceQueueCreateInfo.setQueueCount(queueFamilyProperties.queueCount);
-	deviceQueueCreateInfo.setQueuePriorities(queuePriorities);
+	std::vector<vk::DeviceQueueCreateInfo> deviceQueueCreateInfos(1);
+	deviceQueueCreateInfos[0].setQueueFamilyIndex(graphicsQueueIndex);
+	deviceQueueCreateInfos[0].setQueueCount(queueFamilyProperties.queueCount);
+	deviceQueueCreateInfos[0].setQueuePriorities(queuePriorities);
+
+	if (transferQueueIndex != graphicsQueueIndex)
+	{
+		vk::DeviceQueueCreateInfo transferQueueCreateInfo;
+		transferQueueCreateInfo.setQueueFamilyIndex(transferQueueIndex);
+		transferQueueCreateInfo.setQueueCount(1);
+		transferQueueCreateInfo.setQueuePriorities(queuePriorities.front());
+		deviceQueueCreateInfos.push_back(transferQueueCreateInfo);
+	}
 
 	std::vector<const char *> enabledExtensions{"VK_KHR_swapchain"};
 
+	// Texture streaming stays within the budget the driver reports, without it VMA estimates one from the heap sizes
+	for (const auto &extension : physicalDevice.enumerateDeviceExtensionProperties())
+	{
+		if (std::string_view(extension.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+		{
+			enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			memoryBudgetSupported = true;
+		}
+	}
+
 	vk::PhysicalDeviceFeatures physicalDeviceFeatures;
 	physicalDeviceFeatures.setSamplerAnisotropy(vk::True);
 	physicalDeviceFeatures.setSampleRateShading(vk::True);
+	// Lets a single draw address every vertex of a mesh that needed 32 bit indices
+	physicalDeviceFeatures.setFullDrawIndexUint32(physicalDevice.getFeatures().fullDrawIndexUint32);
+	// Compressed KTX2 textures fall back to their source images on devices without it
+	physicalDeviceFeatures.setTextureCompressionBC(physicalDevice.getFeatures().textureCompressionBC);
+
+	// Mesh uploads signal a timeline semaphore that frames and the staging ring wait on
+	vk::PhysicalDeviceVulkan12Features vulkan12Features;
+	vulkan12Features.setTimelineSemaphore(vk::True);
 
 	vk::DeviceCreateInfo deviceCreateInfo;
-	deviceCreateInfo.setQueueCreateInfoCount(1);
-	deviceCreateInfo.setQueueCreateInfos(deviceQueueCreateInfo);
+	deviceCreateInfo.setPNext(&vulkan12Features);
+	deviceCreateInfo.setQueueCreateInfoCount(deviceQueueCreateInfos.size());
+	deviceCreateInfo.setQueueCreateInfos(deviceQueueCreateInfos);
 	deviceCreateInfo.setEnabledExtensionCount(enabledExtensions.size());
 	deviceCreateInfo.setPEnabledExtensionNames(enabledExtensions);
 	deviceCreateInfo.setPEnabledFeatures(&physicalDeviceFeatures);
@@ -360,6 +464,35 @@ void Renderer::selectGraphicsQueue()
 	}
 }
 
+void Renderer::selectTransferQueue()
+{
+	transferQueueIndex = graphicsQueueIndex;
+	if (!settings.dedicatedTransferQueue)
+		return;
+
+	auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+
+	// Prefer a family that can only transfer, which usually maps to the copy engines, then any non graphics one
+	std::optional<int> transferOnly;
+	std::optional<int> nonGraphics;
+	for (size_t i = 0; i < queueFamilies.size(); i++)
+	{
+		vk::QueueFlags flags = queueFamilies[i].queueFlags;
+		if (!(flags & vk::QueueFlagBits::eTransfer) || (flags & vk::QueueFlagBits::eGraphics))
+			continue;
+
+		if (!(flags & vk::QueueFlagBits::eCompute) && !transferOnly.has_value())
+			transferOnly = static_cast<int>(i);
+		else if (!nonGraphics.has_value())
+			nonGraphics = static_cast<int>(i);
+	}
+
+	if (transferOnly.has_value())
+		transferQueueIndex = transferOnly.value();
+	else if (nonGraphics.has_value())
+		transferQueueIndex = nonGraphics.value();
+}
+
 void Renderer::detectSampleCounts()
 {
 	vk::SampleCountFlags colorSamples = physicalDevice.getProperties().limits.framebufferColorSampleCounts;
@@ -379,7 +512,11 @@ void Renderer::detectSampleCounts()
 
 void Renderer::destroy()
 {
-	device.waitIdle();
+	// ImGui's resources are only used by frames, the transfer queue can keep going
+	vk::SemaphoreWaitInfo waitInfo;
+	waitInfo.setSemaphores(frameTimeline);
+	waitInfo.setValues(frameTimelineValue);
+	vk::resultCheck(device.waitSemaphores(waitInfo, UINT64_MAX), "Could not wait for the last frame!");
 
 	ImGui_ImplVulkan_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
@@ -388,9 +525,13 @@ void Renderer::destroy()
 
 void Renderer::destroyModel(Model &model)
 {
-	device.waitIdle();
+	// Only a model whose upload is still in flight waits, and only for the transfer queue
+	stagingUploader.wait(model.getUploadTimelineValue());
 
-	model.destroy(vmaAllocator, device);
+	// The deleter has to be copyable, so the model is moved into a shared pointer
+	auto retiredModel = std::make_shared<Model>(std::move(model));
+	deletionQueue.push(frameTimelineValue,
+					   [this, retiredModel]() { retiredModel->destroy(vmaAllocator, device); });
 }
 
 void Renderer::render(std::vector<Model> &models, glm::vec3 cameraPos, glm::mat4 view)
@@ -399,11 +540,15 @@ void Renderer::render(std::vector<Model> &models, glm::vec3 cameraPos, glm::mat4
 	vk::resultCheck(res, "error encountered while waiting for fence!");
 	device.resetFences(inFlightFences[currentFrame]);
 
+	uint64_t completedFrameValue = device.getSemaphoreCounterValue(frameTimeline);
+	deletionQueue.collect(completedFrameValue);
+
 	const vk::CommandBuffer &cb = commandBuffers[currentFrame];
 
 	CameraSettings cs;
 	cs.pos = cameraPos;
-	memcpy(cameraSettingsAllocInfo.pMappedData, &cs, sizeof(cs));
+	uniformRing.beginFrame(currentFrame);
+	uint32_t cameraSettingsOffset = uniformRing.push(cs);
 
 	// IMGUI NEW FRAME
 
@@ -420,6 +565,34 @@ void Renderer::render(std::vector<Model> &models, glm::vec3 cameraPos, glm::mat4
 	ImGui::SliderFloat("Camera Y", &modelSettings.pos.y, -50.f, 50.f);
 	ImGui::SliderFloat("Camera Z", &modelSettings.pos.z, -50.f, 50.f);
 	bool resetPressed = ImGui::Button("Reset", {100.f, 25.f});
+	ImGui::Text("Level of Detail");
+	ImGui::SliderFloat("Error Threshold (px)", &settings.lodErrorThreshold, 0.f, 16.f);
+	ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(drawnTriangles));
+	ImGui::Text("Cached textures: %zu (%llu hits, %llu misses)", textureCache.size(),
+				static_cast<unsigned long long>(textureCache.getHits()),
+				static_cast<unsigned long long>(textureCache.getMisses()));
+	ImGui::Text("Samplers: %zu of %u allowed, %llu references (%llu hits, %llu misses)", samplerCache.size(),
+				physicalDevice.getProperties().limits.maxSamplerAllocationCount,
+				static_cast<unsigned long long>(samplerCache.getReferences()),
+				static_cast<unsigned long long>(samplerCache.getHits()),
+				static_cast<unsigned long long>(samplerCache.getMisses()));
+	if (settings.streamTextures)
+	{
+		const TextureStreamerStats &streamerStats = textureStreamer.getStats();
+		ImGui::Text("Texture Streaming");
+		ImGui::Text("Streamed textures: %zu, %u of %u levels resident", streamerStats.streamedTextures,
+					streamerStats.residentLevels, streamerStats.totalLevels);
+		ImGui::Text("Resident: %llu of %llu MiB", static_cast<unsigned long long>(streamerStats.residentBytes >> 20),
+					static_cast<unsigned long long>(streamerStats.fullBytes >> 20));
+		ImGui::Text("Device memory: %llu of %llu MiB budget, %llu MiB being released",
+					static_cast<unsigned long long>(streamerStats.usageBytes >> 20),
+					static_cast<unsigned long long>(streamerStats.budgetBytes >> 20),
+					static_cast<unsigned long long>(streamerStats.releasingBytes >> 20));
+		ImGui::Text("Levels raised: %llu, dropped: %llu", static_cast<unsigned long long>(streamerStats.raisedLevels),
+					static_cast<unsigned long long>(streamerStats.droppedLevels));
+		ImGui::Text("Uploaded last frame: %llu KiB",
+					static_cast<unsigned long long>(streamerStats.uploadedBytes >> 10));
+	}
 	ImGui::End();
 
 	// IMGUI END NEW FRAME
@@ -435,12 +608,43 @@ void Renderer::render(std::vector<Model> &models, glm::vec3 cameraPos, glm::mat4
 	cb.begin(cbBeginInfo);
 	vk::resultCheck(res, "Could not begin the current command buffer!");
 
+	// Models whose uploads are done take ownership of their buffers and textures here, before they are drawn or
+	// streamed for the first time
+	uint64_t completedUploadValue = stagingUploader.getCompletedValue();
+	for (auto &model : models)
+	{
+		model.acquireUploads(cb, completedUploadValue);
+	}
+
+	const vk::Rect2D renderArea{{0, 0}, physicalDevice.getSurfaceCapabilitiesKHR(surface).currentExtent};
+
+	LodSelectInfo lodSelectInfo;
+	lodSelectInfo.cameraPos = cameraPos;
+	lodSelectInfo.projectionScale = mvpPushConstant.projection[1][1] * renderArea.extent.height * 0.5f;
+	lodSelectInfo.errorThreshold = settings.lodErrorThreshold;
+
+	// Residency changes copy between images, so they are recorded before the render pass. Descriptor sets of the
+	// earlier frames are freed once this one retired, like the images they pointed at. Only the materials of these
+	// models refresh their sets, textures other models share are left alone by the streamer.
+	if (settings.streamTextures)
+	{
+		for (const auto &model : models)
+		{
+			model.trackTextures(textureStreamer);
+			if (model.isDrawable())
+				model.requestTextures(textureStreamer, lodSelectInfo);
+		}
+		textureStreamer.update(cb, frameTimelineValue + 1);
+		for (auto &model : models)
+		{
+			model.refreshMaterials(device, deletionQueue, frameTimelineValue + 1);
+		}
+	}
+
 	cb.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.getPipeline());
 
 	cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.getPipelineLayout(), 0, cameraSettingsSet,
-						  nullptr);
-
-	const vk::Rect2D renderArea{{0, 0}, physicalDevice.getSurfaceCapabilitiesKHR(surface).currentExtent};
+						  cameraSettingsOffset);
 
 	vk::RenderPassBeginInfo rpInfo;
 	rpInfo.setRenderPass(renderPass.get());
@@ -460,14 +664,19 @@ void Renderer::render(std::vector<Model> &models, glm::vec3 cameraPos, glm::mat4
 	cb.setScissor(0, renderArea);
 	cb.setViewport(0, viewport);
 
+	GeometryBindState geometryBindState;
+	drawnTriangles = 0;
 	for (auto &model : models)
 	{
+		if (!model.isDrawable())
+			continue;
+
 		mvpPushConstant.model = model.getModel();
 		mvpPushConstant.view = view;
 		vkCmdPushConstants(commandBuffers[currentFrame], pipeline.getPipelineLayout(),
 						   VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(N::MVPPushConstant),
 						   &mvpPushConstant);
-		model.draw(cb, pipeline.getPipelineLayout());
+		drawnTriangles += model.draw(cb, pipeline.getPipelineLayout(), lodSelectInfo, geometryBindState);
 	}
 
 	ImGui::Render();
@@ -476,16 +685,33 @@ void Renderer::render(std::vector<Model> &models, glm::vec3 cameraPos, glm::mat4
 	cb.endRenderPass();
 	cb.end();
 
-	std::vector<vk::PipelineStageFlags> pipelineStageFlags{vk::PipelineStageFlagBits::eColorAttachmentOutput};
+	uniformRing.endFrame();
+
+	// The upload timeline has already reached the value waited for, the wait only orders the acquired buffers and
+	// images, which streaming may copy out of as well
+	std::vector<vk::Semaphore> waitSemaphores{imageAvailableSemaphores[currentFrame],
+											  stagingUploader.getTimelineSemaphore()};
+	std::vector<vk::PipelineStageFlags> pipelineStageFlags{
+		vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eTransfer |
+			vk::PipelineStageFlagBits::eFragmentShader};
+	std::vector<uint64_t> waitValues{0, completedUploadValue};
+	std::vector<vk::Semaphore> signalSemaphores{renderFinishedSemaphores[currentFrame], frameTimeline};
+	std::vector<uint64_t> signalValues{0, ++frameTimelineValue};
+
+	vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+	timelineSubmitInfo.setWaitSemaphoreValues(waitValues);
+	timelineSubmitInfo.setSignalSemaphoreValues(signalValues);
 
 	vk::SubmitInfo submitInfo;
-	submitInfo.setWaitSemaphoreCount(1);
-	submitInfo.setWaitSemaphores(imageAvailableSemaphores[currentFrame]);
+	submitInfo.setPNext(&timelineSubmitInfo);
+	submitInfo.setWaitSemaphoreCount(waitSemaphores.size());
+	submitInfo.setWaitSemaphores(waitSemaphores);
 	submitInfo.setWaitDstStageMask(pipelineStageFlags);
 	submitInfo.setCommandBufferCount(1);
 	submitInfo.setCommandBuffers(cb);
-	submitInfo.setSignalSemaphoreCount(1);
-	submitInfo.setSignalSemaphores(renderFinishedSemaphores[currentFrame]);
+	submitInfo.setSignalSemaphoreCount(signalSemaphores.size());
+	submitInfo.setSignalSemaphores(signalSemaphores);
 
 	graphicsQueue.submit(submitInfo, inFlightFences[currentFrame]);
 
@@ -526,9 +752,9 @@ void Renderer::initializeImGui()
 	ImGui_ImplVulkan_Init(&imGuiImplVulkanInitInfo, renderPass.get());
 
 	// FIXME: change the command buffers variable
-	CommandBuffer::beginSTC(commandBuffers[0]);
-	ImGui_ImplVulkan_CreateFontsTexture(commandBuffers[0]);
-	CommandBuffer::endSTC(commandBuffers[0], graphicsQueue);
+	CommandBuffer::beginSTC(uploadCommandBuffer);
+	ImGui_ImplVulkan_CreateFontsTexture(uploadCommandBuffer);
+	CommandBuffer::endSTC(uploadCommandBuffer, graphicsQueue);
 
 	ImGui_ImplVulkan_DestroyFontUploadObjects();
 }
@@ -544,6 +770,14 @@ void Renderer::createSyncObjects()
 		renderFinishedSemaphores.push_back(device.createSemaphore({}));
 		inFlightFences.push_back(device.createFence(fenceCreateInfo));
 	}
+
+	vk::SemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+	semaphoreTypeCreateInfo.setSemaphoreType(vk::SemaphoreType::eTimeline);
+	semaphoreTypeCreateInfo.setInitialValue(0);
+
+	vk::SemaphoreCreateInfo semaphoreCreateInfo;
+	semaphoreCreateInfo.setPNext(&semaphoreTypeCreateInfo);
+	frameTimeline = device.createSemaphore(semaphoreCreateInfo);
 }
 
 void Renderer::createDepthObjects()
@@ -642,13 +876,30 @@ void Renderer::createRenderTargets()
 Model Renderer::createModel(const char *path)
 {
 	N::ModelCreateInfo createInfo{};
-	createInfo.commandBuffer = commandBuffers[0];
+	createInfo.commandBuffer = uploadCommandBuffer;
+	createInfo.geometryArena = &geometryArena;
+	createInfo.stagingUploader = &stagingUploader;
+	createInfo.textureCache = &textureCache;
+	createInfo.samplerCache = &samplerCache;
 	createInfo.descriptorPool = descriptorPool;
 	createInfo.descriptorSetLayout = pipeline.getTextureSetLayout();
 	createInfo.device = device;
 	createInfo.queue = graphicsQueue;
 	createInfo.vmaAllocator = vmaAllocator;
+	createInfo.physicalDevice = physicalDevice;
 	createInfo.maxAnisotropy = physicalDevice.getProperties().limits.maxSamplerAnisotropy;
+	createInfo.threadPool = &threadPool;
+	createInfo.useMeshCache = settings.useMeshCache;
+	createInfo.parallelObjParsing = settings.parallelObjParsing;
+	createInfo.optimizeMeshes = settings.optimizeMeshes;
+	createInfo.optimizeOverdraw = settings.optimizeOverdraw;
+	createInfo.buildMeshlets = settings.buildMeshlets;
+	createInfo.generateLods = settings.generateLods;
+	createInfo.vertexFormat = settings.vertexFormat;
+	createInfo.maxDrawIndexedIndexValue = physicalDevice.getProperties().limits.maxDrawIndexedIndexValue;
+	createInfo.compressedTextures = settings.compressedTextures;
+	createInfo.cpuMipMaps = settings.cpuMipMaps;
+	createInfo.textureStreamer = settings.streamTextures ? &textureStreamer : nullptr;
 	return Model(createInfo, path);
 }
 } // namespace N
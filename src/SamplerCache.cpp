@@ -0,0 +1,88 @@
+#include "SamplerCache.h"
+
+#include <bit>
+#include <stdexcept>
+
+namespace N
+{
+size_t SamplerCache::StateHash::operator()(const SamplerState &state) const
+{
+	uint64_t hash = static_cast<uint64_t>(state.magFilter);
+	for (uint64_t value : {static_cast<uint64_t>(state.minFilter), static_cast<uint64_t>(state.mipmapMode),
+						   static_cast<uint64_t>(state.addressMode),
+						   static_cast<uint64_t>(std::bit_cast<uint32_t>(state.maxAnisotropy)),
+						   static_cast<uint64_t>(std::bit_cast<uint32_t>(state.maxLod))})
+	{
+		hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+void SamplerCache::create(const SamplerCacheCreateInfo &createInfo)
+{
+	device = createInfo.device;
+}
+
+void SamplerCache::destroy()
+{
+	for (const auto &[state, entry] : entries)
+	{
+		device.destroySampler(entry.sampler);
+	}
+	entries.clear();
+	states.clear();
+	references = 0;
+}
+
+vk::Sampler SamplerCache::acquire(const SamplerState &state)
+{
+	references++;
+
+	auto entry = entries.find(state);
+	if (entry != entries.end())
+	{
+		hits++;
+		entry->second.references++;
+		return entry->second.sampler;
+	}
+
+	misses++;
+
+	vk::SamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.setAddressModeU(state.addressMode);
+	samplerCreateInfo.setAddressModeV(state.addressMode);
+	samplerCreateInfo.setAddressModeW(state.addressMode);
+	samplerCreateInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
+	samplerCreateInfo.setAnisotropyEnable(state.maxAnisotropy > 1.f);
+	samplerCreateInfo.setCompareEnable(vk::False);
+	samplerCreateInfo.setCompareOp(vk::CompareOp::eAlways);
+	samplerCreateInfo.setUnnormalizedCoordinates(vk::False);
+	samplerCreateInfo.setMipmapMode(state.mipmapMode);
+	samplerCreateInfo.setMagFilter(state.magFilter);
+	samplerCreateInfo.setMinFilter(state.minFilter);
+	samplerCreateInfo.setMaxAnisotropy(state.maxAnisotropy);
+	samplerCreateInfo.setMaxLod(state.maxLod);
+	samplerCreateInfo.setMinLod(0.f);
+	vk::Sampler sampler = device.createSampler(samplerCreateInfo);
+
+	entries.emplace(state, Entry{sampler, 1});
+	states.emplace(static_cast<VkSampler>(sampler), state);
+	return sampler;
+}
+
+void SamplerCache::release(vk::Sampler sampler)
+{
+	auto state = states.find(static_cast<VkSampler>(sampler));
+	if (state == states.end())
+		throw std::runtime_error("Released a sampler that is not in the cache");
+
+	auto entry = entries.find(state->second);
+	references--;
+	if (--entry->second.references == 0)
+	{
+		device.destroySampler(entry->second.sampler);
+		entries.erase(entry);
+		states.erase(state);
+	}
+}
+} // namespace N
@@ -0,0 +1,376 @@
+#include "StagingUploader.h"
+
+#include "KtxFile.h"
+#include "TextureLayout.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace N
+{
+// Keeps every staged range aligned for the widest element type written into it
+constexpr vk::DeviceSize stagingAlignment = 16;
+
+void StagingUploader::create(const StagingUploaderCreateInfo &createInfo)
+{
+	vmaAllocator = createInfo.vmaAllocator;
+	device = createInfo.device;
+	queue = createInfo.queue;
+	queueFamilyIndex = createInfo.queueFamilyIndex;
+	dstQueueFamilyIndex = createInfo.dstQueueFamilyIndex;
+	minImageTransferGranularity = createInfo.minImageTransferGranularity;
+	capacity = createInfo.capacity;
+
+	VkBufferCreateInfo stagingBufferCreateInfo{};
+	stagingBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	stagingBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	stagingBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	stagingBufferCreateInfo.size = capacity;
+
+	VmaAllocationCreateInfo vmaStagingBufferAllocCreateInfo{};
+	vmaStagingBufferAllocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+	vmaStagingBufferAllocCreateInfo.flags =
+		VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+	VmaAllocationInfo stagingBufferAllocInfo;
+	if (vmaCreateBuffer(vmaAllocator, &stagingBufferCreateInfo, &vmaStagingBufferAllocCreateInfo,
+						reinterpret_cast<VkBuffer *>(&stagingBuffer), &stagingBufferAllocation,
+						&stagingBufferAllocInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the staging buffer");
+	}
+	stagingData = static_cast<unsigned char *>(stagingBufferAllocInfo.pMappedData);
+
+	vk::CommandPoolCreateInfo commandPoolCreateInfo;
+	commandPoolCreateInfo.setQueueFamilyIndex(queueFamilyIndex);
+	commandPoolCreateInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer |
+								   vk::CommandPoolCreateFlagBits::eTransient);
+	commandPool = device.createCommandPool(commandPoolCreateInfo);
+
+	vk::SemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+	semaphoreTypeCreateInfo.setSemaphoreType(vk::SemaphoreType::eTimeline);
+	semaphoreTypeCreateInfo.setInitialValue(0);
+
+	vk::SemaphoreCreateInfo semaphoreCreateInfo;
+	semaphoreCreateInfo.setPNext(&semaphoreTypeCreateInfo);
+	timelineSemaphore = device.createSemaphore(semaphoreCreateInfo);
+}
+
+void StagingUploader::destroy()
+{
+	flush();
+
+	// Destroying the pool frees every command buffer allocated from it
+	device.destroyCommandPool(commandPool);
+	device.destroySemaphore(timelineSemaphore);
+	vmaDestroyBuffer(vmaAllocator, stagingBuffer, stagingBufferAllocation);
+}
+
+void StagingUploader::upload(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, vk::DeviceSize size,
+							 vk::DeviceSize elementSize, const WriteFunction &write)
+{
+	stage(size, elementSize, write, [&](vk::DeviceSize offset, vk::DeviceSize written, vk::DeviceSize pieceSize) {
+		vk::BufferCopy bufferCopy;
+		bufferCopy.setSrcOffset(offset);
+		bufferCopy.setDstOffset(dstOffset + written);
+		bufferCopy.setSize(pieceSize);
+		commandBuffer.copyBuffer(stagingBuffer, dstBuffer, bufferCopy);
+
+		if (queueFamilyIndex != dstQueueFamilyIndex)
+		{
+			vk::BufferMemoryBarrier barrier;
+			barrier.setSrcQueueFamilyIndex(queueFamilyIndex);
+			barrier.setDstQueueFamilyIndex(dstQueueFamilyIndex);
+			barrier.setBuffer(dstBuffer);
+			barrier.setOffset(dstOffset + written);
+			barrier.setSize(pieceSize);
+
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			releaseBarriers.push_back(barrier);
+
+			barrier.setSrcAccessMask({});
+			barrier.setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead);
+			batch.acquireBarriers.push_back(barrier);
+		}
+	});
+}
+
+void StagingUploader::upload(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, const void *data, vk::DeviceSize size)
+{
+	upload(dstBuffer, dstOffset, size, 1, [data](void *mapped, vk::DeviceSize offset, vk::DeviceSize size) {
+		memcpy(mapped, static_cast<const unsigned char *>(data) + offset, size);
+	});
+}
+
+uint64_t StagingUploader::uploadImage(vk::Image image, vk::Format format, uint32_t width, uint32_t height,
+									  uint32_t levelCount, const ImageWriteFunction &write,
+									  std::optional<vk::ImageMemoryBarrier> &acquireBarrier)
+{
+	vk::ImageMemoryBarrier barrier;
+	barrier.setImage(image);
+	barrier.setSubresourceRange({vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1});
+	bool transitioned = false;
+
+	// Bands start at whole rows of 4 by 4 blocks for block compressed formats and at multiples of the queue's
+	// granularity, both powers of two
+	uint32_t blockHeight = KtxFile::getBlockSize(format) ? 4 : 1;
+	uint32_t bandHeight = std::max(blockHeight, minImageTransferGranularity.height);
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		uint32_t levelWidth = TextureLayout::getLevelExtent(width, level);
+		uint32_t levelHeight = TextureLayout::getLevelExtent(height, level);
+		vk::DeviceSize blockRowSize = TextureLayout::getLevelSize(format, levelWidth, 1);
+		vk::DeviceSize bandSize = minImageTransferGranularity.height == 0 || bandHeight >= levelHeight
+									  ? TextureLayout::getLevelSize(format, levelWidth, levelHeight)
+									  : TextureLayout::getLevelSize(format, levelWidth, bandHeight);
+
+		auto writeLevel = [&](void *mapped, vk::DeviceSize offset, vk::DeviceSize size) {
+			write(mapped, level, offset, size);
+		};
+
+		stage(TextureLayout::getLevelSize(format, levelWidth, levelHeight), bandSize, writeLevel,
+			  [&](vk::DeviceSize offset, vk::DeviceSize written, vk::DeviceSize pieceSize) {
+				  if (!transitioned)
+				  {
+					  // Recorded ahead of the first copy, later submits on this queue are ordered behind it
+					  barrier.setOldLayout(vk::ImageLayout::eUndefined);
+					  barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+					  barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+					  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+													vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr,
+													barrier);
+					  transitioned = true;
+				  }
+
+				  // Only the last piece of a level may end in a partial band, it covers the rest of the level
+				  uint32_t firstRow = static_cast<uint32_t>(written / blockRowSize) * blockHeight;
+				  uint32_t rows = static_cast<uint32_t>(pieceSize / blockRowSize) * blockHeight;
+
+				  vk::BufferImageCopy bufferImageCopy;
+				  bufferImageCopy.setBufferOffset(offset);
+				  bufferImageCopy.setImageSubresource({vk::ImageAspectFlagBits::eColor, level, 0, 1});
+				  bufferImageCopy.setImageOffset(vk::Offset3D(0, static_cast<int32_t>(firstRow), 0));
+				  bufferImageCopy.setImageExtent(
+					  vk::Extent3D(levelWidth, std::min(rows, levelHeight - firstRow), 1));
+				  commandBuffer.copyBufferToImage(stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal,
+												  bufferImageCopy);
+			  });
+	}
+
+	// The last copy is in the recording command buffer, the layout change goes in with its release barriers
+	barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask({});
+	acquireBarrier.reset();
+	if (queueFamilyIndex != dstQueueFamilyIndex)
+	{
+		barrier.setSrcQueueFamilyIndex(queueFamilyIndex);
+		barrier.setDstQueueFamilyIndex(dstQueueFamilyIndex);
+
+		acquireBarrier = barrier;
+		acquireBarrier->setSrcAccessMask({});
+		acquireBarrier->setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead);
+	}
+	imageReleaseBarriers.push_back(barrier);
+
+	return lastSubmittedValue + 1;
+}
+
+UploadBatch StagingUploader::submitBatch()
+{
+	if (recording)
+		submitRecording();
+
+	batch.timelineValue = lastSubmittedValue;
+
+	UploadBatch submitted = std::move(batch);
+	batch = {};
+	return submitted;
+}
+
+void StagingUploader::flush()
+{
+	if (recording)
+		submitRecording();
+
+	while (!inFlight.empty())
+		retire(true);
+}
+
+void StagingUploader::wait(uint64_t timelineValue)
+{
+	if (timelineValue > lastSubmittedValue)
+		throw std::runtime_error("Cannot wait for an upload that was not submitted");
+
+	while (!inFlight.empty() && inFlight.front().timelineValue <= timelineValue)
+		retire(true);
+}
+
+void StagingUploader::stage(vk::DeviceSize size, vk::DeviceSize elementSize, const WriteFunction &write,
+							const RecordFunction &record)
+{
+	if (elementSize == 0 || elementSize > capacity)
+		throw std::runtime_error("Staged elements must fit the staging buffer");
+
+	if (batch.bytes == 0 && batch.submits == 0)
+		batch.startTime = std::chrono::high_resolution_clock::now();
+
+	vk::DeviceSize written = 0;
+	while (written < size)
+	{
+		vk::DeviceSize offset;
+		vk::DeviceSize pieceSize;
+		if (!place(size - written, elementSize, offset, pieceSize))
+		{
+			// Submitting the recorded copies lets their space be reclaimed, otherwise wait for the oldest submit
+			if (recording)
+				submitRecording();
+			else
+				retire(true);
+			continue;
+		}
+
+		if (!recording)
+			beginRecording();
+
+		write(stagingData + offset, written, pieceSize);
+		// A no-op on host coherent memory, which is what the staging buffer gets on most devices
+		vmaFlushAllocation(vmaAllocator, stagingBufferAllocation, offset, pieceSize);
+
+		record(offset, written, pieceSize);
+
+		vk::DeviceSize consumed = offset >= head ? offset + pieceSize - head : capacity - head + offset + pieceSize;
+		head = offset + pieceSize;
+		used += consumed;
+		recordingConsumed += consumed;
+
+		written += pieceSize;
+		batch.bytes += pieceSize;
+	}
+}
+
+bool StagingUploader::place(vk::DeviceSize remaining, vk::DeviceSize elementSize, vk::DeviceSize &offset,
+							vk::DeviceSize &pieceSize)
+{
+	if (used == 0)
+	{
+		// Only an empty ring splits a range, anything else rather waits for space to fit it whole
+		head = tail = 0;
+		offset = 0;
+		pieceSize = std::min(remaining, capacity / elementSize * elementSize);
+		return true;
+	}
+
+	if (used == capacity)
+		return false;
+
+	pieceSize = remaining;
+	vk::DeviceSize aligned = (head + stagingAlignment - 1) & ~(stagingAlignment - 1);
+	if (head >= tail)
+	{
+		// Free space is at the end of the ring and in front of the tail
+		if (aligned <= capacity && capacity - aligned >= remaining)
+		{
+			offset = aligned;
+			return true;
+		}
+		if (tail >= remaining)
+		{
+			offset = 0;
+			return true;
+		}
+		return false;
+	}
+
+	if (aligned <= tail && tail - aligned >= remaining)
+	{
+		offset = aligned;
+		return true;
+	}
+	return false;
+}
+
+void StagingUploader::beginRecording()
+{
+	retire(false);
+
+	if (freeCommandBuffers.empty())
+	{
+		vk::CommandBufferAllocateInfo commandBufferAllocateInfo;
+		commandBufferAllocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+		commandBufferAllocateInfo.setCommandPool(commandPool);
+		commandBufferAllocateInfo.setCommandBufferCount(1);
+		commandBuffer = device.allocateCommandBuffers(commandBufferAllocateInfo).at(0);
+	}
+	else
+	{
+		commandBuffer = freeCommandBuffers.back();
+		freeCommandBuffers.pop_back();
+		commandBuffer.reset();
+	}
+
+	vk::CommandBufferBeginInfo commandBufferBeginInfo;
+	commandBufferBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+	commandBuffer.begin(commandBufferBeginInfo);
+
+	recording = true;
+	recordingConsumed = 0;
+}
+
+void StagingUploader::submitRecording()
+{
+	if (!releaseBarriers.empty() || !imageReleaseBarriers.empty())
+	{
+		// Release half of the ownership transfers, the destination stage is ignored for a release. Images also change
+		// to their final layout here, which the timeline semaphore makes visible when no transfer is needed.
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+									  {}, nullptr, releaseBarriers, imageReleaseBarriers);
+		releaseBarriers.clear();
+		imageReleaseBarriers.clear();
+	}
+
+	commandBuffer.end();
+
+	uint64_t signalValue = lastSubmittedValue + 1;
+
+	vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+	timelineSubmitInfo.setSignalSemaphoreValues(signalValue);
+
+	vk::SubmitInfo submitInfo;
+	submitInfo.setPNext(&timelineSubmitInfo);
+	submitInfo.setCommandBuffers(commandBuffer);
+	submitInfo.setSignalSemaphores(timelineSemaphore);
+	queue.submit(submitInfo);
+
+	lastSubmittedValue = signalValue;
+	inFlight.push_back({commandBuffer, signalValue, recordingConsumed});
+
+	recording = false;
+	batch.submits++;
+}
+
+void StagingUploader::retire(bool waitOldest)
+{
+	if (waitOldest && !inFlight.empty())
+	{
+		vk::SemaphoreWaitInfo waitInfo;
+		waitInfo.setSemaphores(timelineSemaphore);
+		waitInfo.setValues(inFlight.front().timelineValue);
+		if (device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to wait for a staging upload");
+	}
+
+	uint64_t completedValue = getCompletedValue();
+	while (!inFlight.empty() && inFlight.front().timelineValue <= completedValue)
+	{
+		const Submission &submission = inFlight.front();
+		tail = (tail + submission.consumed) % capacity;
+		used -= submission.consumed;
+		freeCommandBuffers.push_back(submission.commandBuffer);
+		inFlight.pop_front();
+	}
+}
+} // namespace N
@@ -0,0 +1,276 @@
+#include "TangentGenerator.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENT_GENERATOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+// Triangles whose texture coordinates are (nearly) collinear have no defined tangent and are skipped
+constexpr float minUvDeterminant = 1e-20f;
+constexpr float minTangentLength = 1e-12f;
+
+// Any unit vector perpendicular to normal, for vertices whose triangles all had degenerate texture coordinates
+glm::vec3 perpendicular(const glm::vec3 &normal)
+{
+	glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3{1.f, 0.f, 0.f} : glm::vec3{0.f, 1.f, 0.f};
+	return glm::normalize(glm::cross(normal, axis));
+}
+
+#ifdef TANGENT_GENERATOR_SSE
+inline __m128 dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+#endif
+} // namespace
+
+void TangentGenerator::generate(std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	generate(vertices, indices, true);
+}
+
+void TangentGenerator::generateScalar(std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	generate(vertices, indices, false);
+}
+
+void TangentGenerator::generate(std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+								[[maybe_unused]] bool useSse)
+{
+	size_t vertexCount = vertices.size();
+	size_t triangleCount = indices.size() / 3;
+
+	// Structure of arrays so the per vertex pass can load four accumulators at once
+	Accumulators accumulators;
+	for (auto *channel : {&accumulators.tangentX, &accumulators.tangentY, &accumulators.tangentZ,
+						  &accumulators.bitangentX, &accumulators.bitangentY, &accumulators.bitangentZ})
+	{
+		channel->assign(vertexCount, 0.f);
+	}
+
+	size_t triangle = 0;
+
+#ifdef TANGENT_GENERATOR_SSE
+	for (; useSse && triangle + 4 <= triangleCount; triangle += 4)
+	{
+		// Gather the four triangles into SoA lanes
+		alignas(16) float gathered[15][4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			const uint32_t *corners = &indices[(triangle + lane) * 3];
+			const Vertex &v0 = vertices[corners[0]];
+			const Vertex &v1 = vertices[corners[1]];
+			const Vertex &v2 = vertices[corners[2]];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				gathered[axis][lane] = v0.pos[axis];
+				gathered[3 + axis][lane] = v1.pos[axis];
+				gathered[6 + axis][lane] = v2.pos[axis];
+			}
+			for (int axis = 0; axis < 2; axis++)
+			{
+				gathered[9 + axis][lane] = v0.texCoords[axis];
+				gathered[11 + axis][lane] = v1.texCoords[axis];
+				gathered[13 + axis][lane] = v2.texCoords[axis];
+			}
+		}
+
+		__m128 p0[3], edge1[3], edge2[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			p0[axis] = _mm_load_ps(gathered[axis]);
+			edge1[axis] = _mm_sub_ps(_mm_load_ps(gathered[3 + axis]), p0[axis]);
+			edge2[axis] = _mm_sub_ps(_mm_load_ps(gathered[6 + axis]), p0[axis]);
+		}
+
+		__m128 u0 = _mm_load_ps(gathered[9]);
+		__m128 v0 = _mm_load_ps(gathered[10]);
+		__m128 du1 = _mm_sub_ps(_mm_load_ps(gathered[11]), u0);
+		__m128 dv1 = _mm_sub_ps(_mm_load_ps(gathered[12]), v0);
+		__m128 du2 = _mm_sub_ps(_mm_load_ps(gathered[13]), u0);
+		__m128 dv2 = _mm_sub_ps(_mm_load_ps(gathered[14]), v0);
+
+		__m128 determinant = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+		__m128 absDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.f), determinant);
+		__m128 valid = _mm_cmpgt_ps(absDeterminant, _mm_set1_ps(minUvDeterminant));
+		__m128 f = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), determinant));
+
+		alignas(16) float tangent[3][4];
+		alignas(16) float bitangent[3][4];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m128 t = _mm_sub_ps(_mm_mul_ps(dv2, edge1[axis]), _mm_mul_ps(dv1, edge2[axis]));
+			__m128 b = _mm_sub_ps(_mm_mul_ps(du1, edge2[axis]), _mm_mul_ps(du2, edge1[axis]));
+			_mm_store_ps(tangent[axis], _mm_mul_ps(f, t));
+			_mm_store_ps(bitangent[axis], _mm_mul_ps(f, b));
+		}
+
+		// Scatter, lanes can share vertices so this has to stay scalar
+		for (int lane = 0; lane < 4; lane++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[(triangle + lane) * 3 + corner];
+				accumulators.tangentX[vertex] += tangent[0][lane];
+				accumulators.tangentY[vertex] += tangent[1][lane];
+				accumulators.tangentZ[vertex] += tangent[2][lane];
+				accumulators.bitangentX[vertex] += bitangent[0][lane];
+				accumulators.bitangentY[vertex] += bitangent[1][lane];
+				accumulators.bitangentZ[vertex] += bitangent[2][lane];
+			}
+		}
+	}
+#endif
+
+	for (; triangle < triangleCount; triangle++)
+	{
+		accumulateTriangle(vertices, &indices[triangle * 3], accumulators);
+	}
+
+	size_t vertex = 0;
+
+#ifdef TANGENT_GENERATOR_SSE
+	for (; useSse && vertex + 4 <= vertexCount; vertex += 4)
+	{
+		alignas(16) float normal[3][4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				normal[axis][lane] = vertices[vertex + lane].normal[axis];
+			}
+		}
+
+		__m128 nx = _mm_load_ps(normal[0]);
+		__m128 ny = _mm_load_ps(normal[1]);
+		__m128 nz = _mm_load_ps(normal[2]);
+		__m128 normalLength = _mm_sqrt_ps(dot3(nx, ny, nz, nx, ny, nz));
+		__m128 normalValid = _mm_cmpgt_ps(normalLength, _mm_setzero_ps());
+		__m128 inverseNormalLength = _mm_and_ps(normalValid, _mm_div_ps(_mm_set1_ps(1.f), normalLength));
+		nx = _mm_mul_ps(nx, inverseNormalLength);
+		ny = _mm_mul_ps(ny, inverseNormalLength);
+		nz = _mm_mul_ps(nz, inverseNormalLength);
+
+		__m128 tx = _mm_loadu_ps(&accumulators.tangentX[vertex]);
+		__m128 ty = _mm_loadu_ps(&accumulators.tangentY[vertex]);
+		__m128 tz = _mm_loadu_ps(&accumulators.tangentZ[vertex]);
+
+		// Gram-Schmidt, remove the normal component of the tangent. The second pass cleans up the cancellation error
+		// left when the accumulated tangent is nearly parallel to the normal.
+		__m128 tangentValid = normalValid;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			__m128 normalComponent = dot3(nx, ny, nz, tx, ty, tz);
+			tx = _mm_sub_ps(tx, _mm_mul_ps(nx, normalComponent));
+			ty = _mm_sub_ps(ty, _mm_mul_ps(ny, normalComponent));
+			tz = _mm_sub_ps(tz, _mm_mul_ps(nz, normalComponent));
+
+			__m128 tangentLength = _mm_sqrt_ps(dot3(tx, ty, tz, tx, ty, tz));
+			tangentValid = _mm_and_ps(tangentValid, _mm_cmpgt_ps(tangentLength, _mm_set1_ps(minTangentLength)));
+			__m128 inverseTangentLength = _mm_and_ps(tangentValid, _mm_div_ps(_mm_set1_ps(1.f), tangentLength));
+			tx = _mm_mul_ps(tx, inverseTangentLength);
+			ty = _mm_mul_ps(ty, inverseTangentLength);
+			tz = _mm_mul_ps(tz, inverseTangentLength);
+		}
+
+		// Handedness: does cross(N, T) point along the accumulated bitangent
+		__m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+		__m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+		__m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+		__m128 handedness = dot3(cx, cy, cz, _mm_loadu_ps(&accumulators.bitangentX[vertex]),
+								 _mm_loadu_ps(&accumulators.bitangentY[vertex]),
+								 _mm_loadu_ps(&accumulators.bitangentZ[vertex]));
+		__m128 negative = _mm_cmplt_ps(handedness, _mm_setzero_ps());
+		__m128 sign = _mm_or_ps(_mm_and_ps(negative, _mm_set1_ps(-1.f)), _mm_andnot_ps(negative, _mm_set1_ps(1.f)));
+
+		alignas(16) float result[4][4];
+		_mm_store_ps(result[0], tx);
+		_mm_store_ps(result[1], ty);
+		_mm_store_ps(result[2], tz);
+		_mm_store_ps(result[3], sign);
+		int validMask = _mm_movemask_ps(tangentValid);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (validMask & (1 << lane))
+			{
+				vertices[vertex + lane].tangent =
+					glm::vec4{result[0][lane], result[1][lane], result[2][lane], result[3][lane]};
+			}
+			else
+			{
+				finishVertex(vertices[vertex + lane], accumulators, vertex + lane);
+			}
+		}
+	}
+#endif
+
+	for (; vertex < vertexCount; vertex++)
+	{
+		finishVertex(vertices[vertex], accumulators, vertex);
+	}
+}
+
+void TangentGenerator::accumulateTriangle(const std::vector<Vertex> &vertices, const uint32_t *corners,
+										  Accumulators &accumulators)
+{
+	const Vertex &v0 = vertices[corners[0]];
+	const Vertex &v1 = vertices[corners[1]];
+	const Vertex &v2 = vertices[corners[2]];
+
+	glm::vec3 edge1 = v1.pos - v0.pos;
+	glm::vec3 edge2 = v2.pos - v0.pos;
+	glm::vec2 deltaUV1 = v1.texCoords - v0.texCoords;
+	glm::vec2 deltaUV2 = v2.texCoords - v0.texCoords;
+
+	float determinant = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+	if (!(std::abs(determinant) > minUvDeterminant))
+		return;
+
+	float f = 1.f / determinant;
+	glm::vec3 tangent = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+	glm::vec3 bitangent = f * (deltaUV1.x * edge2 - deltaUV2.x * edge1);
+
+	for (int corner = 0; corner < 3; corner++)
+	{
+		uint32_t vertex = corners[corner];
+		accumulators.tangentX[vertex] += tangent.x;
+		accumulators.tangentY[vertex] += tangent.y;
+		accumulators.tangentZ[vertex] += tangent.z;
+		accumulators.bitangentX[vertex] += bitangent.x;
+		accumulators.bitangentY[vertex] += bitangent.y;
+		accumulators.bitangentZ[vertex] += bitangent.z;
+	}
+}
+
+void TangentGenerator::finishVertex(Vertex &vertex, const Accumulators &accumulators, size_t index)
+{
+	float normalLength = glm::length(vertex.normal);
+	glm::vec3 normal = normalLength > 0.f ? vertex.normal / normalLength : glm::vec3{0.f, 0.f, 1.f};
+
+	glm::vec3 tangent{accumulators.tangentX[index], accumulators.tangentY[index], accumulators.tangentZ[index]};
+	glm::vec3 bitangent{accumulators.bitangentX[index], accumulators.bitangentY[index],
+						accumulators.bitangentZ[index]};
+
+	bool tangentValid = true;
+	for (int pass = 0; pass < 2 && tangentValid; pass++)
+	{
+		tangent -= normal * glm::dot(normal, tangent);
+
+		float tangentLength = glm::length(tangent);
+		tangentValid = tangentLength > minTangentLength;
+		if (tangentValid)
+			tangent /= tangentLength;
+	}
+
+	if (!tangentValid)
+		tangent = perpendicular(normal);
+
+	float sign = glm::dot(glm::cross(normal, tangent), bitangent) < 0.f ? -1.f : 1.f;
+	vertex.tangent = glm::vec4{tangent, sign};
+}
@@ -0,0 +1,151 @@
+#include "TextureCache.h"
+
+#include <stdexcept>
+
+#include "TextureLayout.h"
+
+namespace N
+{
+void TextureCache::create(const TextureCacheCreateInfo &createInfo)
+{
+	vmaAllocator = createInfo.vmaAllocator;
+	device = createInfo.device;
+}
+
+void TextureCache::destroy()
+{
+	for (const auto &[key, entry] : entries)
+	{
+		destroyTexture(entry.texture);
+	}
+	entries.clear();
+}
+
+const CachedTexture *TextureCache::acquire(uint64_t contentHash, vk::Format format)
+{
+	auto entry = entries.find({contentHash, format});
+	if (entry == entries.end())
+	{
+		misses++;
+		return nullptr;
+	}
+
+	hits++;
+	entry->second.references++;
+	return &entry->second.texture;
+}
+
+const CachedTexture *TextureCache::insert(CachedTexture &&texture)
+{
+	Key key{texture.contentHash, texture.format};
+	auto [entry, inserted] = entries.try_emplace(key, Entry{std::move(texture), 1});
+	if (!inserted)
+		throw std::runtime_error("A texture with the same contents and format is already cached");
+
+	return &entry->second.texture;
+}
+
+void TextureCache::release(const CachedTexture *texture)
+{
+	auto entry = entries.find({texture->contentHash, texture->format});
+	if (entry == entries.end() || &entry->second.texture != texture)
+		throw std::runtime_error("Released a texture that is not in the cache");
+
+	if (--entry->second.references == 0)
+	{
+		destroyTexture(entry->second.texture);
+		entries.erase(entry);
+	}
+}
+
+void TextureCache::forEach(const std::function<void(CachedTexture &, uint32_t)> &function)
+{
+	for (auto &[key, entry] : entries)
+	{
+		function(entry.texture, entry.references);
+	}
+}
+
+void TextureCache::acquireUploads(const vk::CommandBuffer &commandBuffer, uint64_t completedUploadValue)
+{
+	std::vector<vk::ImageMemoryBarrier> barriers;
+	for (auto &[key, entry] : entries)
+	{
+		CachedTexture &texture = entry.texture;
+		if (texture.uploadTimelineValue == 0 || texture.uploadTimelineValue > completedUploadValue)
+			continue;
+
+		if (texture.acquireBarrier)
+			barriers.push_back(*texture.acquireBarrier);
+		texture.uploadTimelineValue = 0;
+		texture.acquireBarrier.reset();
+	}
+
+	// Streaming may copy out of the images right after, before they are sampled
+	if (!barriers.empty())
+	{
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+									  vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eFragmentShader,
+									  {}, nullptr, nullptr, barriers);
+	}
+}
+
+void TextureCache::createImage(const VmaAllocator &allocator, const vk::Device &device, bool generateMipMaps,
+							   CachedTexture &texture)
+{
+	VkExtent3D extent;
+	extent.depth = 1;
+	extent.width = TextureLayout::getLevelExtent(texture.width, texture.firstResidentLevel);
+	extent.height = TextureLayout::getLevelExtent(texture.height, texture.firstResidentLevel);
+
+	VkImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.extent = extent;
+	imageCreateInfo.format = static_cast<VkFormat>(texture.format);
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.mipLevels = texture.getResidentLevels();
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	// Streaming copies the levels an image shares with its replacement out of it
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (generateMipMaps || texture.chain)
+		imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	VmaAllocationCreateInfo imageAllocationCreateInfo{};
+	imageAllocationCreateInfo.flags = VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+	imageAllocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+	auto res = vmaCreateImage(allocator, &imageCreateInfo, &imageAllocationCreateInfo, &texture.image,
+							  &texture.allocation, nullptr);
+	vk::resultCheck(vk::Result(res), "Could not create image!");
+
+	VkImageSubresourceRange imageSubresourceRange{};
+	imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageSubresourceRange.baseArrayLayer = 0;
+	imageSubresourceRange.baseMipLevel = 0;
+	imageSubresourceRange.layerCount = 1;
+	imageSubresourceRange.levelCount = texture.getResidentLevels();
+
+	VkImageViewCreateInfo imageViewCreateInfo{};
+	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.components = VkComponentMapping{};
+	imageViewCreateInfo.format = static_cast<VkFormat>(texture.format);
+	imageViewCreateInfo.subresourceRange = imageSubresourceRange;
+	imageViewCreateInfo.image = texture.image;
+
+	res = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &texture.view);
+	if (res != VK_SUCCESS)
+		vmaDestroyImage(allocator, texture.image, texture.allocation);
+	vk::resultCheck(vk::Result(res), "Could not create image view!");
+}
+
+void TextureCache::destroyTexture(const CachedTexture &texture)
+{
+	vkDestroyImageView(device, texture.view, nullptr);
+	vmaDestroyImage(vmaAllocator, texture.image, texture.allocation);
+}
+} // namespace N
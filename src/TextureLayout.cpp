@@ -0,0 +1,54 @@
+#include "TextureLayout.h"
+
+#include <stdexcept>
+
+#include "KtxFile.h"
+
+namespace N
+{
+uint32_t TextureLayout::getTexelSize(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8Unorm:
+		return 1;
+	case vk::Format::eR8G8Unorm:
+		return 2;
+	case vk::Format::eR8G8B8A8Unorm:
+	case vk::Format::eR8G8B8A8Srgb:
+		return 4;
+	default:
+		throw std::runtime_error("Unsupported uncompressed texture format " + vk::to_string(format));
+	}
+}
+
+vk::DeviceSize TextureLayout::getLevelSize(vk::Format format, uint32_t width, uint32_t height)
+{
+	uint32_t blockSize = KtxFile::getBlockSize(format);
+	if (blockSize)
+		return static_cast<vk::DeviceSize>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+
+	return static_cast<vk::DeviceSize>(width) * height * getTexelSize(format);
+}
+
+vk::DeviceSize TextureLayout::getMemorySize(vk::Format format, uint32_t width, uint32_t height, uint32_t firstLevel,
+											uint32_t endLevel)
+{
+	vk::DeviceSize size = 0;
+	for (uint32_t level = firstLevel; level < endLevel; level++)
+	{
+		size += getLevelSize(format, getLevelExtent(width, level), getLevelExtent(height, level));
+	}
+	return size;
+}
+
+vk::DeviceSize TextureLayout::getChainOffset(vk::Format format, uint32_t width, uint32_t height, uint32_t level)
+{
+	vk::DeviceSize offset = 0;
+	for (uint32_t i = 0; i < level; i++)
+	{
+		offset += align(getLevelSize(format, getLevelExtent(width, i), getLevelExtent(height, i)));
+	}
+	return offset;
+}
+} // namespace N
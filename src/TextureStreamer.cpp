@@ -0,0 +1,457 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "TextureLayout.h"
+
+namespace N
+{
+namespace
+{
+vk::DeviceSize getResidentSize(const CachedTexture &texture, uint32_t firstLevel)
+{
+	return TextureLayout::getMemorySize(texture.format, texture.width, texture.height, firstLevel, texture.mipLevels);
+}
+
+vk::DeviceSize getLevelSize(const CachedTexture &texture, uint32_t level)
+{
+	return TextureLayout::getLevelSize(texture.format, TextureLayout::getLevelExtent(texture.width, level),
+									   TextureLayout::getLevelExtent(texture.height, level));
+}
+
+// Bytes staged to make the levels from firstLevel up to the texture's first resident level resident
+vk::DeviceSize getStagingSize(const CachedTexture &texture, uint32_t firstLevel)
+{
+	if (firstLevel >= texture.firstResidentLevel)
+		return 0;
+	return TextureLayout::getChainOffset(texture.format, texture.width, texture.height, texture.firstResidentLevel) -
+		   TextureLayout::getChainOffset(texture.format, texture.width, texture.height, firstLevel);
+}
+
+// Device and staging memory raising a texture to firstLevel takes this frame. The new image holds every resident level
+// and the old image stays alive next to it until the frame retired.
+vk::DeviceSize getRaiseCost(const CachedTexture &texture, uint32_t firstLevel)
+{
+	if (firstLevel >= texture.firstResidentLevel)
+		return 0;
+	return getResidentSize(texture, firstLevel) + getStagingSize(texture, firstLevel);
+}
+
+vk::Extent3D getLevelExtent(const CachedTexture &texture, uint32_t level)
+{
+	return {TextureLayout::getLevelExtent(texture.width, level), TextureLayout::getLevelExtent(texture.height, level),
+			1};
+}
+} // namespace
+
+void TextureStreamer::create(const TextureStreamerCreateInfo &createInfo)
+{
+	vmaAllocator = createInfo.vmaAllocator;
+	device = createInfo.device;
+	textureCache = createInfo.textureCache;
+	deletionQueue = createInfo.deletionQueue;
+	baseSize = createInfo.baseSize;
+	budgetFraction = createInfo.budgetFraction;
+	memoryLimit = createInfo.memoryLimit;
+	uploadLimit = createInfo.uploadLimit;
+	holdFrames = createInfo.holdFrames;
+}
+
+void TextureStreamer::destroy()
+{
+	requests.clear();
+	histories.clear();
+	trackedReferences.clear();
+}
+
+uint32_t TextureStreamer::getBaseLevel(const CachedTexture &texture) const
+{
+	uint32_t level = 0;
+	while (level + 1 < texture.mipLevels && std::max(TextureLayout::getLevelExtent(texture.width, level),
+													 TextureLayout::getLevelExtent(texture.height, level)) > baseSize)
+	{
+		level++;
+	}
+	return level;
+}
+
+void TextureStreamer::request(const CachedTexture *texture, float pixels)
+{
+	if (!texture->chain)
+		return;
+
+	// The smallest level that still has at least as many texels across as the texture covers pixels
+	uint32_t size = std::max(texture->width, texture->height);
+	uint32_t level = 0;
+	while (level + 1 < texture->mipLevels && static_cast<float>(std::max(size >> (level + 1), 1u)) >= pixels)
+	{
+		level++;
+	}
+	level = std::min(level, getBaseLevel(*texture));
+
+	auto [entry, inserted] = requests.try_emplace(texture, level);
+	if (!inserted)
+		entry->second = std::min(entry->second, level);
+}
+
+void TextureStreamer::track(const CachedTexture *texture)
+{
+	if (texture->chain)
+		trackedReferences[texture]++;
+}
+
+void TextureStreamer::update(const vk::CommandBuffer &commandBuffer, uint64_t frameTimelineValue)
+{
+	frame++;
+
+	// A texture that is also referenced by a material that was not tracked, like one of a model that is not drawn or
+	// waits for its deferred destruction, would keep descriptor sets pointing at the old image. It stays as it is but
+	// still counts towards the memory limit, as does a texture the graphics queue did not acquire from its upload yet.
+	std::vector<Change> textures;
+	std::unordered_map<const CachedTexture *, History> untrackedHistories;
+	vk::DeviceSize residentBytes = 0;
+	textureCache->forEach([&](CachedTexture &texture, uint32_t references) {
+		if (!texture.chain)
+			return;
+
+		residentBytes += getResidentSize(texture, texture.firstResidentLevel);
+
+		auto history = histories.find(&texture);
+		History textureHistory = history != histories.end() ? history->second : History{};
+
+		auto tracked = trackedReferences.find(&texture);
+		if (tracked == trackedReferences.end() || tracked->second < references || texture.uploadTimelineValue != 0)
+		{
+			untrackedHistories.emplace(&texture, textureHistory);
+			return;
+		}
+
+		Change change{&texture, texture.firstResidentLevel, texture.firstResidentLevel, textureHistory};
+
+		auto request = requests.find(&texture);
+		if (request != requests.end())
+		{
+			change.wantedLevel = request->second;
+			change.history.lastRequestFrame = frame;
+		}
+
+		textures.push_back(change);
+	});
+	requests.clear();
+	trackedReferences.clear();
+
+	// A texture whose residency changed within the last holdFrames frames is left alone if possible, so a texture
+	// raised into the last of the budget is not dropped again right away, one that was dropped is not raised again and
+	// repeated drops are spread over the textures instead of taking one down to its base level
+	auto isHeld = [this](uint64_t changeFrame) { return changeFrame != 0 && frame - changeFrame < holdFrames; };
+
+	measureBudget(stats.budgetBytes, stats.usageBytes);
+	stats.releasingBytes = releasingBytes;
+
+	// VMA still counts the images replaced by the last frames until their deleters ran. They are as good as free,
+	// without crediting them every drop would look like it made things worse and be followed by another one.
+	int64_t available = static_cast<int64_t>(static_cast<double>(stats.budgetBytes) * budgetFraction) -
+						static_cast<int64_t>(stats.usageBytes) + static_cast<int64_t>(releasingBytes);
+	if (memoryLimit)
+		available = std::min(available, static_cast<int64_t>(memoryLimit) - static_cast<int64_t>(residentBytes));
+
+	// Over budget, drop the top level of the texture requested longest ago, preferring textures that were not raised
+	// or dropped recently, then textures that hold more levels than they were asked for and then the largest top
+	// level. Held textures still drop when nothing else can, going over the budget is worse than reloading a level.
+	bool dropped = false;
+	while (available < 0)
+	{
+		Change *victim = nullptr;
+		for (Change &change : textures)
+		{
+			if (change.firstLevel >= getBaseLevel(*change.texture))
+				continue;
+			if (!victim)
+			{
+				victim = &change;
+				continue;
+			}
+
+			bool held = isHeld(change.history.lastRaiseFrame) || isHeld(change.history.lastDropFrame);
+			bool victimHeld = isHeld(victim->history.lastRaiseFrame) || isHeld(victim->history.lastDropFrame);
+			bool overResident = change.firstLevel < change.wantedLevel;
+			bool victimOverResident = victim->firstLevel < victim->wantedLevel;
+			if (held != victimHeld)
+			{
+				if (!held)
+					victim = &change;
+			}
+			else if (change.history.lastRequestFrame != victim->history.lastRequestFrame)
+			{
+				if (change.history.lastRequestFrame < victim->history.lastRequestFrame)
+					victim = &change;
+			}
+			else if (overResident != victimOverResident)
+			{
+				if (overResident)
+					victim = &change;
+			}
+			else if (getLevelSize(*change.texture, change.firstLevel) >
+					 getLevelSize(*victim->texture, victim->firstLevel))
+			{
+				victim = &change;
+			}
+		}
+		if (!victim)
+			break;
+
+		available += static_cast<int64_t>(getLevelSize(*victim->texture, victim->firstLevel));
+		victim->firstLevel++;
+		victim->history.lastDropFrame = frame;
+		stats.droppedLevels++;
+		dropped = true;
+	}
+
+	// With room to spare, raise the requested textures that are furthest from their wanted level one level at a time.
+	// Each raise is charged what it adds to this frame's memory, the whole new image and the staged levels.
+	vk::DeviceSize uploadBytes = 0;
+	while (!dropped)
+	{
+		Change *candidate = nullptr;
+		for (Change &change : textures)
+		{
+			if (change.history.lastRequestFrame != frame || change.firstLevel <= change.wantedLevel ||
+				isHeld(change.history.lastDropFrame))
+				continue;
+			if (!candidate ||
+				change.firstLevel - change.wantedLevel > candidate->firstLevel - candidate->wantedLevel)
+				candidate = &change;
+		}
+		if (!candidate)
+			break;
+
+		const CachedTexture &texture = *candidate->texture;
+		uint32_t level = candidate->firstLevel - 1;
+		vk::DeviceSize cost = getRaiseCost(texture, level) - getRaiseCost(texture, candidate->firstLevel);
+		vk::DeviceSize staged = getStagingSize(texture, level) - getStagingSize(texture, candidate->firstLevel);
+		if (static_cast<int64_t>(cost) > available || (uploadBytes > 0 && uploadBytes + staged > uploadLimit))
+			break;
+
+		available -= static_cast<int64_t>(cost);
+		uploadBytes += staged;
+		candidate->firstLevel = level;
+		candidate->history.lastRaiseFrame = frame;
+		stats.raisedLevels++;
+	}
+
+	// Drops the textures that were destroyed since the last update
+	histories = std::move(untrackedHistories);
+	for (const Change &change : textures)
+		histories.emplace(change.texture, change.history);
+
+	std::vector<Change> changes;
+	stats.streamedTextures = textures.size();
+	stats.residentLevels = 0;
+	stats.totalLevels = 0;
+	stats.residentBytes = 0;
+	stats.fullBytes = 0;
+	for (const Change &change : textures)
+	{
+		if (change.firstLevel != change.texture->firstResidentLevel)
+			changes.push_back(change);
+
+		stats.residentLevels += change.texture->mipLevels - change.firstLevel;
+		stats.totalLevels += change.texture->mipLevels;
+		stats.residentBytes += getResidentSize(*change.texture, change.firstLevel);
+		stats.fullBytes += getResidentSize(*change.texture, 0);
+	}
+
+	stats.uploadedBytes = 0;
+	if (!changes.empty())
+		recordChanges(commandBuffer, frameTimelineValue, changes);
+}
+
+void TextureStreamer::measureBudget(vk::DeviceSize &budget, vk::DeviceSize &usage)
+{
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetHeapBudgets(vmaAllocator, budgets);
+
+	const VkPhysicalDeviceMemoryProperties *memoryProperties;
+	vmaGetMemoryProperties(vmaAllocator, &memoryProperties);
+
+	budget = 0;
+	usage = 0;
+	for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++)
+	{
+		if (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			budget += budgets[i].budget;
+			usage += budgets[i].usage;
+		}
+	}
+}
+
+void TextureStreamer::recordChanges(const vk::CommandBuffer &commandBuffer, uint64_t frameTimelineValue,
+									const std::vector<Change> &changes)
+{
+	struct Replacement
+	{
+		CachedTexture *texture;
+		VkImage oldImage;
+		VkImageView oldView;
+		VmaAllocation oldAllocation;
+		uint32_t oldFirstLevel;
+		vk::DeviceSize stagingOffset;
+	};
+
+	// Only levels above the old first level are new, they sit next to each other in the chain and are staged at once
+	std::vector<Replacement> replacements;
+	vk::DeviceSize stagingSize = 0;
+	for (const Change &change : changes)
+	{
+		CachedTexture &texture = *change.texture;
+		replacements.push_back(
+			{&texture, texture.image, texture.view, texture.allocation, texture.firstResidentLevel, stagingSize});
+
+		stagingSize += getStagingSize(texture, change.firstLevel);
+
+		texture.firstResidentLevel = change.firstLevel;
+		TextureCache::createImage(vmaAllocator, device, false, texture);
+	}
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VmaAllocation stagingAllocation = VK_NULL_HANDLE;
+	if (stagingSize > 0)
+	{
+		VkBufferCreateInfo bufferCreateInfo{};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.size = stagingSize;
+
+		VmaAllocationCreateInfo allocationCreateInfo{};
+		allocationCreateInfo.flags =
+			VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_MAPPED_BIT |
+			VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+		allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+
+		VmaAllocationInfo allocInfo;
+		auto res = vmaCreateBuffer(vmaAllocator, &bufferCreateInfo, &allocationCreateInfo, &stagingBuffer,
+								   &stagingAllocation, &allocInfo);
+		vk::resultCheck(vk::Result(res), "Could not create buffer!");
+
+		for (const Replacement &replacement : replacements)
+		{
+			const CachedTexture &texture = *replacement.texture;
+			if (texture.firstResidentLevel >= replacement.oldFirstLevel)
+				continue;
+
+			vk::DeviceSize chainOffset = TextureLayout::getChainOffset(texture.format, texture.width, texture.height,
+																	   texture.firstResidentLevel);
+			vk::DeviceSize size = TextureLayout::getChainOffset(texture.format, texture.width, texture.height,
+																replacement.oldFirstLevel) -
+								  chainOffset;
+			memcpy(static_cast<unsigned char *>(allocInfo.pMappedData) + replacement.stagingOffset,
+				   texture.chain.get() + chainOffset, size);
+		}
+		vmaFlushAllocation(vmaAllocator, stagingAllocation, 0, VK_WHOLE_SIZE);
+
+		stats.uploadedBytes = stagingSize;
+	}
+
+	// The old images were last sampled by earlier frames on the same queue
+	std::vector<vk::ImageMemoryBarrier> barriers;
+	for (const Replacement &replacement : replacements)
+	{
+		vk::ImageMemoryBarrier barrier{};
+		barrier.setImage(replacement.texture->image);
+		barrier.setSubresourceRange(
+			{vk::ImageAspectFlagBits::eColor, 0, replacement.texture->getResidentLevels(), 0, 1});
+		barrier.setOldLayout(vk::ImageLayout::eUndefined);
+		barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barriers.push_back(barrier);
+
+		barrier.setImage(replacement.oldImage);
+		barrier.setSubresourceRange(
+			{vk::ImageAspectFlagBits::eColor, 0, replacement.texture->mipLevels - replacement.oldFirstLevel, 0, 1});
+		barrier.setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+		barriers.push_back(barrier);
+	}
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+								  {}, nullptr, nullptr, barriers);
+
+	std::vector<vk::ImageCopy> imageCopies;
+	std::vector<vk::BufferImageCopy> bufferImageCopies;
+	for (const Replacement &replacement : replacements)
+	{
+		const CachedTexture &texture = *replacement.texture;
+		uint32_t firstLevel = texture.firstResidentLevel;
+
+		imageCopies.clear();
+		for (uint32_t level = std::max(firstLevel, replacement.oldFirstLevel); level < texture.mipLevels; level++)
+		{
+			vk::ImageCopy imageCopy{};
+			imageCopy.setSrcSubresource({vk::ImageAspectFlagBits::eColor, level - replacement.oldFirstLevel, 0, 1});
+			imageCopy.setDstSubresource({vk::ImageAspectFlagBits::eColor, level - firstLevel, 0, 1});
+			imageCopy.setExtent(getLevelExtent(texture, level));
+			imageCopies.push_back(imageCopy);
+		}
+		commandBuffer.copyImage(replacement.oldImage, vk::ImageLayout::eTransferSrcOptimal, texture.image,
+								vk::ImageLayout::eTransferDstOptimal, imageCopies);
+
+		if (firstLevel >= replacement.oldFirstLevel)
+			continue;
+
+		bufferImageCopies.clear();
+		vk::DeviceSize bufferOffset = replacement.stagingOffset;
+		for (uint32_t level = firstLevel; level < replacement.oldFirstLevel; level++)
+		{
+			vk::BufferImageCopy bufferImageCopy{};
+			bufferImageCopy.setBufferOffset(bufferOffset);
+			bufferImageCopy.setImageSubresource({vk::ImageAspectFlagBits::eColor, level - firstLevel, 0, 1});
+			bufferImageCopy.setImageExtent(getLevelExtent(texture, level));
+			bufferImageCopies.push_back(bufferImageCopy);
+			bufferOffset += TextureLayout::align(getLevelSize(texture, level));
+		}
+		commandBuffer.copyBufferToImage(stagingBuffer, texture.image, vk::ImageLayout::eTransferDstOptimal,
+										bufferImageCopies);
+	}
+
+	barriers.clear();
+	for (const Replacement &replacement : replacements)
+	{
+		vk::ImageMemoryBarrier barrier{};
+		barrier.setImage(replacement.texture->image);
+		barrier.setSubresourceRange(
+			{vk::ImageAspectFlagBits::eColor, 0, replacement.texture->getResidentLevels(), 0, 1});
+		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+		barriers.push_back(barrier);
+	}
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+								  {}, nullptr, nullptr, barriers);
+
+	// The frame this is recorded into is the last one to touch the old images and the staging buffer
+	VmaAllocator allocator = vmaAllocator;
+	VkDevice vkDevice = device;
+	for (const Replacement &replacement : replacements)
+	{
+		vk::DeviceSize oldBytes = getResidentSize(*replacement.texture, replacement.oldFirstLevel);
+		releasingBytes += oldBytes;
+		deletionQueue->push(frameTimelineValue, [this, allocator, vkDevice, replacement, oldBytes]() {
+			vkDestroyImageView(vkDevice, replacement.oldView, nullptr);
+			vmaDestroyImage(allocator, replacement.oldImage, replacement.oldAllocation);
+			releasingBytes -= oldBytes;
+		});
+	}
+	if (stagingBuffer != VK_NULL_HANDLE)
+	{
+		deletionQueue->push(frameTimelineValue, [allocator, stagingBuffer, stagingAllocation]() {
+			vmaDestroyBuffer(allocator, stagingBuffer, stagingAllocation);
+		});
+	}
+}
+} // namespace N
@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace N
+{
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (stopping && tasks.empty())
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		task();
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &task)
+{
+	if (count == 0)
+		return;
+
+	// Every job pulls the next index off a shared counter so uneven task sizes still balance across the workers
+	std::atomic<size_t> nextIndex{0};
+	size_t jobCount = std::min<size_t>(count, workers.size());
+
+	std::vector<std::future<void>> jobs;
+	jobs.reserve(jobCount);
+	for (size_t i = 0; i < jobCount; i++)
+	{
+		jobs.push_back(submit([&nextIndex, &task, count]() {
+			for (size_t index = nextIndex++; index < count; index = nextIndex++)
+			{
+				task(index);
+			}
+		}));
+	}
+
+	// Wait for every job before rethrowing so none of them outlives the references it captured
+	std::exception_ptr firstException;
+	for (auto &job : jobs)
+	{
+		try
+		{
+			job.get();
+		}
+		catch (...)
+		{
+			if (!firstException)
+				firstException = std::current_exception();
+		}
+	}
+
+	if (firstException)
+		std::rethrow_exception(firstException);
+}
+} // namespace N
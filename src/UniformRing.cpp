@@ -0,0 +1,60 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace N
+{
+void UniformRing::create(const UniformRingCreateInfo &createInfo)
+{
+	vmaAllocator = createInfo.vmaAllocator;
+	offsetAlignment = std::max<vk::DeviceSize>(createInfo.offsetAlignment, 1);
+	frameSize = (createInfo.frameSize + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+
+	VkBufferCreateInfo bufferCreateInfo{};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferCreateInfo.size = frameSize * createInfo.framesInFlight;
+
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+	VmaAllocationInfo allocInfo;
+	if (vmaCreateBuffer(vmaAllocator, &bufferCreateInfo, &allocCreateInfo, reinterpret_cast<VkBuffer *>(&buffer),
+						&bufferAllocation, &allocInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the uniform ring buffer");
+	}
+	mappedData = static_cast<unsigned char *>(allocInfo.pMappedData);
+}
+
+void UniformRing::destroy()
+{
+	vmaDestroyBuffer(vmaAllocator, buffer, bufferAllocation);
+}
+
+void UniformRing::beginFrame(uint32_t frame)
+{
+	frameStart = frame * frameSize;
+	frameHead = frameStart;
+}
+
+uint32_t UniformRing::allocate(vk::DeviceSize size, void *&data)
+{
+	vk::DeviceSize offset = (frameHead + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+	if (offset + size > frameStart + frameSize)
+		throw std::runtime_error("Per frame uniform data does not fit the uniform ring");
+
+	frameHead = offset + size;
+	data = mappedData + offset;
+	return static_cast<uint32_t>(offset);
+}
+
+void UniformRing::endFrame()
+{
+	if (frameHead > frameStart)
+		vmaFlushAllocation(vmaAllocator, bufferAllocation, frameStart, frameHead - frameStart);
+}
+} // namespace N
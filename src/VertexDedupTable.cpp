@@ -0,0 +1,46 @@
+#include "VertexDedupTable.h"
+
+#include "Hash.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+static_assert(offsetof(Vertex, tangent) == sizeof(glm::vec3) * 3 + sizeof(glm::vec2),
+			  "the dedup key must be the tightly packed fields in front of Vertex::tangent");
+
+VertexDedupTable::VertexDedupTable(size_t maxVertices)
+{
+	size_t capacity = std::bit_ceil(std::max<size_t>(maxVertices * 2, 16));
+	slots.resize(capacity, Slot{0, emptySlot});
+	mask = capacity - 1;
+}
+
+uint64_t VertexDedupTable::hash(const Vertex &vertex)
+{
+	return hashBytes(&vertex, keySize);
+}
+
+uint32_t VertexDedupTable::findOrInsert(const Vertex &vertex, std::vector<Vertex> &vertices)
+{
+	uint64_t fullHash = hash(vertex);
+	uint32_t shortHash = static_cast<uint32_t>(fullHash >> 32);
+
+	for (size_t slot = fullHash & mask;; slot = (slot + 1) & mask)
+	{
+		Slot &cur = slots[slot];
+
+		if (cur.index == emptySlot)
+		{
+			cur.hash = shortHash;
+			cur.index = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(vertex);
+			return cur.index;
+		}
+
+		if (cur.hash == shortHash && memcmp(&vertices[cur.index], &vertex, keySize) == 0)
+		{
+			return cur.index;
+		}
+	}
+}
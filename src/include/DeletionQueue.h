@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace N
+{
+// Defers freeing GPU resources until the work that last used them has retired. Every deleter is tagged with the frame
+// timeline value of the last submit that may reference its resources and runs once the timeline reached it, so
+// buffers, images, views, samplers and descriptor sets can be released mid session without waiting for the device.
+class DeletionQueue
+{
+  public:
+	DeletionQueue() = default;
+	DeletionQueue(const DeletionQueue &) = delete;
+	DeletionQueue &operator=(const DeletionQueue &) = delete;
+
+	// Tags must not decrease between calls
+	void push(uint64_t timelineValue, std::function<void()> &&deleter);
+	// Runs every deleter whose tag completedValue covers, in the order they were pushed
+	void collect(uint64_t completedValue);
+	// Runs every deleter, the caller has to make sure the device is done with all of them
+	void flush();
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+
+  private:
+	struct Entry
+	{
+		uint64_t timelineValue;
+		std::function<void()> deleter;
+	};
+
+	std::deque<Entry> entries;
+};
+} // namespace N
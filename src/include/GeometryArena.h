@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+namespace N
+{
+struct GeometryArenaCreateInfo
+{
+	VmaAllocator vmaAllocator;
+	// Size of one vertex in the vertex buffers, every mesh in the arena has to use the same vertex format
+	vk::DeviceSize vertexStride;
+	// Default sizes of a block, a block is only made larger when a single mesh does not fit it
+	vk::DeviceSize vertexBlockSize = 128ull << 20;
+	vk::DeviceSize indexBlockSize = 64ull << 20;
+};
+
+// Vertex and index range of one mesh inside the arena
+struct GeometryAllocation
+{
+	uint32_t block = UINT32_MAX;
+	VmaVirtualAllocation vertexAllocation = VK_NULL_HANDLE;
+	VmaVirtualAllocation indexAllocation = VK_NULL_HANDLE;
+	// Offset of the first vertex in vertices, passed as the vertex offset of a draw
+	uint32_t firstVertex = 0;
+	// Offset of the index range in bytes, divided by the index size it is added to the first index of a draw
+	vk::DeviceSize indexOffset = 0;
+};
+
+// What is currently bound while recording a command buffer, so buffers are only rebound when a draw needs others
+struct GeometryBindState
+{
+	uint32_t block = UINT32_MAX;
+	vk::IndexType indexType = vk::IndexType::eUint32;
+};
+
+// Shared vertex and index buffers that every mesh is sub-allocated from with VMA virtual blocks. Vertex ranges are
+// allocated in whole vertices so a mesh can be drawn with a vertex offset, index ranges at 4 byte alignment so both
+// 16 and 32 bit indices can be addressed from the start of the buffer. A new block is created when a mesh does not fit
+// the existing ones, in practice all geometry lives in the first block and is bound once per frame.
+class GeometryArena
+{
+  public:
+	GeometryArena() = default;
+	GeometryArena(const GeometryArena &) = delete;
+	GeometryArena &operator=(const GeometryArena &) = delete;
+
+	void create(const GeometryArenaCreateInfo &createInfo);
+	void destroy();
+
+	GeometryAllocation allocate(uint32_t vertexCount, vk::DeviceSize indicesSize);
+	void free(GeometryAllocation &allocation);
+
+	vk::Buffer getVertexBuffer(uint32_t block) const
+	{
+		return blocks.at(block).vertexBuffer;
+	}
+	vk::Buffer getIndexBuffer(uint32_t block) const
+	{
+		return blocks.at(block).indexBuffer;
+	}
+	vk::DeviceSize getVertexStride() const
+	{
+		return vertexStride;
+	}
+
+	// Binds the buffers of block, skipping whatever state already matches
+	void bind(const vk::CommandBuffer &commandBuffer, GeometryBindState &state, uint32_t block,
+			  vk::IndexType indexType) const;
+
+  private:
+	struct Block
+	{
+		vk::Buffer vertexBuffer;
+		VmaAllocation vertexBufferAllocation;
+		VmaVirtualBlock vertexBlock;
+
+		vk::Buffer indexBuffer;
+		VmaAllocation indexBufferAllocation;
+		VmaVirtualBlock indexBlock;
+	};
+
+	VmaAllocator vmaAllocator;
+	vk::DeviceSize vertexStride;
+	vk::DeviceSize vertexBlockSize;
+	vk::DeviceSize indexBlockSize;
+	std::vector<Block> blocks;
+
+	void createBlock(vk::DeviceSize vertexBufferSize, vk::DeviceSize indexBufferSize);
+	bool allocateFromBlock(uint32_t block, uint32_t vertexCount, vk::DeviceSize indicesSize,
+						   GeometryAllocation &allocation);
+};
+} // namespace N
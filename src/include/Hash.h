@@ -0,0 +1,40 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Fast non-cryptographic 64 bit hash over raw bytes, used for in-memory tables and on-disk cache keys alike
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0)
+{
+	const auto *bytes = static_cast<const unsigned char *>(data);
+
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ seed ^ size;
+
+	size_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, bytes + offset, sizeof(word));
+		h ^= word * 0xBF58476D1CE4E5B9ull;
+		h = std::rotl(h, 31) * 0x94D049BB133111EBull;
+	}
+
+	if (offset < size)
+	{
+		uint64_t word = 0;
+		memcpy(&word, bytes + offset, size - offset);
+		h ^= word * 0xBF58476D1CE4E5B9ull;
+		h = std::rotl(h, 31) * 0x94D049BB133111EBull;
+	}
+
+	// splitmix64 finalizer so every input bit affects the low bits
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBull;
+	h ^= h >> 31;
+
+	return h;
+}
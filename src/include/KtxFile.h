@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace N
+{
+// One mip level of a KTX2 texture, offset and size are in bytes into the file
+struct KtxLevel
+{
+	size_t offset;
+	size_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct KtxImage
+{
+	vk::Format format;
+	uint32_t width;
+	uint32_t height;
+	// Largest level first, the levels are uploaded as they are and never regenerated
+	std::vector<KtxLevel> levels;
+};
+
+// Reads KTX2 containers holding a single 2D image in BC1, BC4, BC5 or BC7 with pre-built mip levels and no
+// supercompression. The texel data is not touched, it is copied into the staging buffer straight from the file.
+class KtxFile
+{
+  public:
+	// The KTX2 file that replaces an image, the same path with a .ktx2 extension
+	static std::string getPath(const char *sourcePath);
+
+	// Returns false and sets reason if the file is not a KTX2 container of that kind
+	static bool parse(const unsigned char *data, size_t size, KtxImage &image, const char *&reason);
+
+	// Size of one 4x4 block in bytes, 0 for formats the reader does not load
+	static uint32_t getBlockSize(vk::Format format);
+};
+} // namespace N
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+namespace N
+{
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+  public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	MappedFile(MappedFile &&rhs) noexcept;
+	MappedFile &operator=(MappedFile &&rhs) noexcept;
+	~MappedFile();
+
+	// Returns false if the file does not exist or could not be mapped
+	bool open(const char *path);
+	void close();
+
+	// Hints that [offset, offset + size) will not be read again soon so its pages can leave the working set. The data
+	// stays readable, it is paged back in from the file on the next access.
+	void release(size_t offset, size_t size) const;
+
+	const unsigned char *data() const
+	{
+		return mappedData;
+	}
+
+	size_t size() const
+	{
+		return mappedSize;
+	}
+
+  private:
+	const unsigned char *mappedData = nullptr;
+	size_t mappedSize = 0;
+
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
+} // namespace N
@@ -1,60 +1,143 @@
 #pragma once
 
-#include <tuple>
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.hpp>
 
+#include "DeletionQueue.h"
+#include "KtxFile.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "SamplerCache.h"
+#include "StagingUploader.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
 #include "tiny_obj_loader.h"
 
 namespace N
 {
+struct MaterialCreateInfo
+{
+	VmaAllocator vmaAllocator;
+	vk::PhysicalDevice physicalDevice;
+	vk::Device device;
+	// Textures with every resident level staged are uploaded through this without waiting, they become usable with the
+	// batch it submits next once TextureCache::acquireUploads() handed them to the graphics queue
+	StagingUploader *stagingUploader;
+	// Textures whose mip chain is blitted are uploaded synchronously on this graphics queue with this command buffer
+	vk::Queue queue;
+	vk::CommandBuffer commandBuffer;
+	// Textures are hashed and decoded across this pool, or serially when it is null. Creating the images and recording
+	// their upload stays on the calling thread.
+	ThreadPool *threadPool;
+	// Shared by every material, has to outlive them
+	TextureCache *textureCache;
+	// Load the block compressed KTX2 file next to an image instead when there is one and the device can sample it
+	bool compressedTextures;
+	// Generate the mip chains of decoded textures with MipGenerator on the pool and upload them whole, instead of
+	// blitting them after the upload
+	bool cpuMipMaps;
+	// Textures with pre-built or generated mip chains are streamed through this, starting out with only their small
+	// levels resident. Null to upload every level at once.
+	TextureStreamer *textureStreamer;
+};
+
 class Material
 {
   public:
 	constexpr Material() = delete;
-	Material(const VmaAllocator &allocator, const vk::Device &device, const vk::Queue &queue,
-			 const vk::CommandBuffer &commandBuffer, const tinyobj::material_t &tinyObjMat);
+	Material(const MaterialCreateInfo &createInfo, const tinyobj::material_t &tinyObjMat);
 	constexpr Material(const Material &) = delete;
 	constexpr Material &operator=(const Material &rhs) = delete;
 	constexpr Material(Material &&) = default;
 	Material &operator=(Material &&) = default;
 
 	void bind(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout) const;
-	void destroy(const VmaAllocator &allocator, const vk::Device &device);
+	// Drops the material's references to its cached textures
+	void destroy(const vk::Device &device);
 
-	void createSampler(const vk::Device &device, float maxAnisotropy);
+	// Takes the shared sampler for the material's state from samplerCache, which has to outlive the material
+	void createSampler(SamplerCache &samplerCache, float maxAnisotropy);
 	void createDescriptorSets(const vk::Device &device, const vk::DescriptorPool &pool,
 							  const vk::DescriptorSetLayout &setLayout);
+	// Rewrites the descriptor sets into new ones when the streamer replaced the image of a texture, the old sets are
+	// freed once the frame timeline reached timelineValue
+	void refreshDescriptorSets(const vk::Device &device, DeletionQueue &deletionQueue, uint64_t timelineValue);
+	// Asks for the material's textures to be sharp at a size of pixels across on screen
+	void requestTextures(TextureStreamer &textureStreamer, float pixels) const;
+	// Lets the streamer change the material's textures this frame, refreshDescriptorSets() has to follow its update
+	void trackTextures(TextureStreamer &textureStreamer) const;
 
   private:
-	std::tuple<VkImage, VmaAllocation> loadImage(const VmaAllocator &allocator, const vk::Queue &queue,
-												 const vk::CommandBuffer &commandBuffer, vk::Format format,
-												 const char *path);
-	void generateMipMaps(const vk::Queue &queue, const vk::CommandBuffer &commandBuffer, const vk::Image &image);
+	// One texture of the material while it is loaded
+	struct TextureLoad
+	{
+		// Null for a packed texture, which is built from other loads
+		const char *path = nullptr;
+		MappedFile file;
+		uint64_t contentHash;
+		// Set when an earlier texture of the material has the same contents, it is only loaded once
+		std::optional<size_t> duplicateOf;
+		// Loaded from the KTX2 file at ktxPath with its pre-built mips instead of decoded from the image at path
+		bool compressed = false;
+		std::string ktxPath;
+		KtxImage ktxImage;
+		// Why an existing KTX2 file was not used
+		const char *fallbackReason = nullptr;
+		// Every resident mip level is staged, read from the KTX2 file or generated on the CPU, so nothing is blitted
+		bool prebuiltMips = false;
+		// Decoded texels laid out as texture.format, followed by the rest of the mip chain once it is generated, and
+		// where they start in the staging buffer when the mips are blitted
+		unsigned char *texels = nullptr;
+		vk::DeviceSize stagingOffset;
+		CachedTexture texture;
+		float decodeMilliseconds = 0.f;
+		float mipMilliseconds = 0.f;
+		float stagingMilliseconds = 0.f;
+	};
 
-	vk::Sampler sampler;
+	// Maps the KTX2 file of load if it exists, holds a supported format the shader reads the same way as slotFormat,
+	// the format the image would be decoded to, and the device can sample it
+	static void openCompressed(const vk::PhysicalDevice &physicalDevice, vk::Format slotFormat, TextureLoad &load);
+	// Decodes into the channels load.texture.format holds. Only touches load, so the textures of a material can be
+	// decoded on different threads.
+	static void decodeImage(TextureLoad &load);
+	// Packs the decoded maps into the red, green and blue channels of packed and frees their texels. Occlusion may be
+	// missing, the maps may differ in size.
+	static void packOcclusionRoughnessMetallic(TextureLoad &occlusion, TextureLoad &roughness,
+											   TextureLoad &metallic, TextureLoad &packed);
+	// Grows the decoded texels into the full mip chain, each level aligned the way it is staged
+	static void generateMipChain(TextureLoad &load);
+	// Hands the full chain of a load with pre-built mips to its texture for streaming, compressed levels are copied
+	// out of the KTX2 file into the chain layout
+	static void keepMipChain(TextureLoad &load);
+	// Records the copies of the top level of every texture and the blits for their mip chains, batching the barriers
+	// of all textures
+	static void recordUploads(const vk::CommandBuffer &commandBuffer, const vk::Buffer &stagingBuffer,
+							  const std::vector<TextureLoad *> &loads);
+	static void recordMipMaps(const vk::CommandBuffer &commandBuffer, const std::vector<TextureLoad *> &loads);
 
-	VkImage diffuse;
-	VkImageView diffuseView;
-	VmaAllocation diffuseAlloc;
-
-	VkImage metallic;
-	VkImageView metallicView;
-	VmaAllocation metallicAlloc;
-
-	VkImage roughness;
-	VkImageView roughnessView;
-	VmaAllocation roughnessAlloc;
+	SamplerCache *samplerCache;
+	vk::Sampler sampler;
 
-	VkImage normal;
-	VkImageView normalView;
-	VmaAllocation normalAlloc;
+	TextureCache *textureCache;
+	const CachedTexture *diffuse;
+	// Ambient occlusion in red, roughness in green and metallic in blue, either from a map_ORM texture or packed
+	// at load time from the map_AO, map_Pr and map_Pm textures
+	const CachedTexture *occlusionRoughnessMetallic;
+	const CachedTexture *normal;
 
+	vk::DescriptorPool descriptorPool;
+	vk::DescriptorSetLayout descriptorSetLayout;
 	std::vector<vk::DescriptorSet> descriptorSets;
+	// Views the descriptor sets were written with, in binding order
+	std::array<VkImageView, 3> boundViews;
 
-	uint32_t mipLevels;
-	uint32_t width;
-	uint32_t height;
+	void writeDescriptorSets(const vk::Device &device);
 };
 } // namespace N
@@ -1,17 +1,43 @@
 #pragma once
 
+#include <utility>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 #include <vk_mem_alloc.h>
 #include "tiny_obj_loader.h"
 
+#include "MeshOptimizer.h"
+#include "GeometryArena.h"
+#include "Meshlet.h"
+#include "StagingUploader.h"
 #include "Vertex.h"
 
+// A level of detail is a range of the mesh index buffer drawn with the shared vertex buffer
+struct MeshLod
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	// Largest distance the simplified surface may be from the full resolution one, in object space units
+	float error;
+};
+
+// Picks the coarsest level of detail whose error projects to at most errorThreshold pixels on screen
+struct LodSelectInfo
+{
+	glm::vec3 cameraPos;
+	// Pixels covered by one unit at distance one, proj[1][1] * viewport height / 2 for a perspective projection
+	float projectionScale;
+	float errorThreshold;
+};
+
 class Mesh
 {
   public:
 	constexpr Mesh() = delete;
 	Mesh(const tinyobj::shape_t &shape, const tinyobj::attrib_t &attrib, int materialId);
+	// Takes already assembled geometry, e.g. from the mesh cache
+	Mesh(std::vector<Vertex> &&vertices, std::vector<uint32_t> &&indices, int materialId, const glm::vec3 &boundsMin,
+		 const glm::vec3 &boundsMax, std::vector<MeshLod> &&lods = {});
 	constexpr Mesh(const Mesh &) = delete;
 	constexpr Mesh &operator=(const Mesh &) = delete;
 	constexpr Mesh(Mesh &&) = default;
@@ -20,30 +46,78 @@ class Mesh
 	{
 		return vertices;
 	}
-	const std::vector<uint16_t> &getIndices() const
+	const std::vector<uint32_t> &getIndices() const
 	{
 		return indices;
 	}
+	// 16 bit indices are uploaded whenever every vertex can be addressed by one, 32 bit otherwise
+	vk::IndexType getIndexType() const
+	{
+		return indexType;
+	}
 	int getMaterialId() const
 	{
 		return materialId;
 	}
+	const glm::vec3 &getBoundsMin() const
+	{
+		return boundsMin;
+	}
+	const glm::vec3 &getBoundsMax() const
+	{
+		return boundsMax;
+	}
+	// Level 0 is the full resolution mesh, followed by coarser levels if buildLods was called
+	const std::vector<MeshLod> &getLods() const
+	{
+		return lods;
+	}
+	// Empty unless buildMeshlets was called
+	const MeshletData &getMeshletData() const
+	{
+		return meshletData;
+	}
+
+	// Reorders triangles for vertex cache reuse and, if overdraw is set, then for overdraw, and vertices for fetch
+	// locality. Returns the vertex cache statistics from before and after. Must be called before buildLods.
+	std::pair<VertexCacheStats, VertexCacheStats> optimize(bool overdraw);
+
+	// Appends up to maxLevels - 1 simplified index sets, each targeting half the triangles of the previous level. The
+	// chain stops early once simplification stalls or the error would exceed maxRelativeError times the bounds
+	// diagonal.
+	void buildLods(uint32_t maxLevels = 5, float maxRelativeError = 0.05f);
+	uint32_t selectLod(const glm::mat4 &model, const LodSelectInfo &lodSelectInfo) const;
+	// Pixels across the bounding sphere covers on screen, infinite with the camera inside it
+	float getProjectedSize(const glm::mat4 &model, const LodSelectInfo &lodSelectInfo) const;
+
+	// Splits the full resolution level into clusters with bounding spheres and normal cones for cluster level culling
+	void buildMeshlets(uint32_t maxVertices = MeshletBuilder::defaultMaxVertices,
+					   uint32_t maxTriangles = MeshletBuilder::defaultMaxTriangles);
 
-	void draw(const vk::CommandBuffer &commandBuffer) const;
-	void uploadMesh(const VmaAllocator &vmaAllocator, const vk::Queue &queue, const vk::CommandBuffer &commandBuffer);
-	void destroy(const VmaAllocator &vmaAllocator);
+	// Only rebinds the arena buffers when bindState says other ones are bound
+	void draw(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout,
+			  const N::GeometryArena &geometryArena, N::GeometryBindState &bindState, uint32_t lod = 0) const;
+	// Allocates the vertex and index ranges from the arena and stages their contents, they may only be used once the
+	// uploader's batch is done
+	void uploadMesh(N::GeometryArena &geometryArena, N::StagingUploader &uploader, VertexFormat vertexFormat);
+	void destroy(N::GeometryArena &geometryArena);
 
   private:
 	std::vector<Vertex> vertices;
-	std::vector<uint16_t> indices;
+	std::vector<uint32_t> indices;
+	vk::IndexType indexType;
 	int materialId;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	std::vector<MeshLod> lods;
+	MeshletData meshletData;
 
-	vk::Buffer vertexBuffer;
-	VmaAllocation vertexBufferAllocation;
+	VertexFormat vertexFormat = VertexFormat::eFull;
+	PackedVertexDecode packedVertexDecode;
 
-	vk::Buffer indexBuffer;
-	VmaAllocation indexBufferAllocation;
+	N::GeometryAllocation geometry;
 
-	void bind(const vk::CommandBuffer &commandBuffer) const;
-	void calcTangents();
+	void selectIndexType();
+	void calcBounds();
+	PackedVertexDecode calcPackedVertexDecode() const;
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "tiny_obj_loader.h"
+
+namespace N
+{
+// Binary cache of the fully built meshes of an OBJ file, stored next to it as "<path>.meshcache". Each entry holds the
+// final vertices, indices, levels of detail, material id and bounds of a mesh along with the material texture names,
+// so a warm start never touches tinyobj. A cache is only used if its format version matches and it was written from
+// an OBJ file and material libraries with the same content hash.
+class MeshCache
+{
+  public:
+	static constexpr uint32_t version = 6;
+
+	// Build options that change the cached geometry, a cache written with different flags is not used
+	static constexpr uint32_t optimizedFlag = 1 << 0;
+	static constexpr uint32_t lodFlag = 1 << 1;
+	static constexpr uint32_t overdrawFlag = 1 << 2;
+
+	static std::string getCachePath(const char *sourcePath);
+	// Hash of the OBJ file and every material library it names, returns 0 if the OBJ file could not be read
+	static uint64_t hashSourceFile(const char *sourcePath);
+
+	// Returns false, leaving the output vectors untouched, if there is no valid cache for sourceHash and buildFlags
+	static bool load(const std::string &cachePath, uint64_t sourceHash, uint32_t buildFlags,
+					 std::vector<tinyobj::material_t> &materials, std::vector<Mesh> &meshes);
+	// Failing to write the cache is reported but not fatal
+	static void store(const std::string &cachePath, uint64_t sourceHash, uint32_t buildFlags,
+					  const std::vector<tinyobj::material_t> &materials, const std::vector<Mesh> &meshes);
+
+  private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t vertexSize;
+		uint32_t materialCount;
+		uint32_t meshCount;
+		uint32_t buildFlags;
+	};
+
+	struct MeshHeader
+	{
+		int32_t materialId;
+		uint32_t lodCount;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+};
+} // namespace N
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// Post-transform vertex cache statistics of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats
+{
+	uint64_t misses = 0;
+	uint64_t triangles = 0;
+	uint64_t vertices = 0;
+
+	// Average cache miss ratio, transformed vertices per triangle. 0.5 is the ideal for a regular grid, 3 the worst.
+	float acmr() const
+	{
+		return triangles ? static_cast<float>(misses) / triangles : 0.f;
+	}
+
+	// Average transform to vertex ratio, 1 means every vertex is transformed exactly once
+	float atvr() const
+	{
+		return vertices ? static_cast<float>(misses) / vertices : 0.f;
+	}
+
+	VertexCacheStats &operator+=(const VertexCacheStats &rhs)
+	{
+		misses += rhs.misses;
+		triangles += rhs.triangles;
+		vertices += rhs.vertices;
+		return *this;
+	}
+};
+
+// Index and vertex reordering passes for triangle lists. They only change the order of triangles and vertices, never
+// the rendered result (apart from the order overlapping triangles are drawn in).
+class MeshOptimizer
+{
+  public:
+	// Size of the FIFO cache used by analyzeVertexCache, a reasonable stand-in for current GPUs
+	static constexpr uint32_t analysisCacheSize = 16;
+
+	// Reorders triangles for post-transform cache reuse using Tom Forsyth's linear-speed algorithm
+	static void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+	// Reorders clusters of cache optimized triangles front to back from the mesh center to cut overdraw, after Sander
+	// et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw". Clusters are split where their ACMR,
+	// simulated from an empty cache, is within threshold of the ACMR of the run of triangles they are cut from. If the
+	// sorted order still ends up above threshold times the input's ACMR, the input order is kept.
+	static void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices,
+								 float threshold = 1.05f);
+
+	// Reorders vertices in the order the index buffer first references them and remaps the indices to match.
+	// Vertices not referenced at all are dropped.
+	static void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+	static VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount,
+											   uint32_t cacheSize = analysisCacheSize);
+};
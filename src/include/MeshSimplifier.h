@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// Quadric error metric edge collapse simplification, after Garland and Heckbert, "Surface Simplification Using Quadric
+// Error Metrics". Edges are collapsed onto one of their existing vertices, so the vertex buffer is shared by every
+// level of detail and only the index buffer changes.
+//
+// Vertices on open borders are never moved, which keeps silhouettes intact. Vertices on attribute seams (several
+// vertices at one position) only move along the seam, with every copy collapsing onto a neighbouring copy of the same
+// target, so texture mapping stays intact. Collapses that cannot pair up every copy are skipped.
+class MeshSimplifier
+{
+  public:
+	// Collapses edges cheapest first until at most targetIndexCount indices are left or every remaining collapse would
+	// move the surface by more than maxError, in object space units. resultError receives the largest error of any
+	// collapse that was done.
+	static std::vector<uint32_t> simplify(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+										  size_t targetIndexCount, float maxError, float &resultError);
+};
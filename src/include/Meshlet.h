@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+// A small cluster of a mesh's triangles, the unit of cluster level culling
+struct Meshlet
+{
+	// Ranges in MeshletData::vertices and MeshletData::triangles
+	uint32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t triangleOffset;
+	uint32_t triangleCount;
+
+	// Bounding sphere in mesh space
+	glm::vec3 center;
+	float radius;
+
+	// Normal cone, see MeshletBuilder::isBackfacing. A cutoff of 1 means the triangles face too many directions for
+	// the cluster to ever be culled this way.
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	// Mesh vertex index of every meshlet local vertex
+	std::vector<uint32_t> vertices;
+	// Three meshlet local vertex indices per triangle
+	std::vector<uint8_t> triangles;
+};
+
+class MeshletBuilder
+{
+  public:
+	// Common limits for mesh shader friendly clusters, 124 triangles keeps the local index data under 384 bytes
+	static constexpr uint32_t defaultMaxVertices = 64;
+	static constexpr uint32_t defaultMaxTriangles = 124;
+
+	// Splits the triangles into meshlets in index buffer order, so cache optimized input gives tight clusters.
+	// maxVertices can be at most 256 since local indices are 8 bits.
+	static MeshletData build(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+							 uint32_t maxVertices = defaultMaxVertices, uint32_t maxTriangles = defaultMaxTriangles);
+
+	// True if every triangle of the meshlet faces away from a camera at cameraPos, both given in mesh space
+	static bool isBackfacing(const Meshlet &meshlet, const glm::vec3 &cameraPos);
+
+	// True if the bounding sphere is entirely outside one of the planes. Planes are (normal, distance) with normals
+	// pointing into the frustum, in the same space as the meshlet.
+	static bool isOutsideFrustum(const Meshlet &meshlet, const std::array<glm::vec4, 6> &frustumPlanes);
+
+  private:
+	static void computeBounds(Meshlet &meshlet, const MeshletData &data, const std::vector<Vertex> &vertices);
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+namespace N
+{
+// What the texels of a texture hold, which decides how four of them are averaged into one
+enum class TexelContent
+{
+	// RGBA8 with sRGB encoded color and linear alpha, averaged in linear space
+	SrgbColor,
+	// One to four channels of linear data, averaged as stored
+	Linear,
+	// RG8 holding X and Y of a tangent space normal, averaged as vectors with Z reconstructed and renormalized
+	NormalXY,
+};
+
+// Builds mip levels on the CPU with a 2x2 box filter, so textures can be uploaded with their whole chain in one copy
+// instead of blitting it on the GPU, where filtering of sRGB formats is implementation defined.
+//
+// Levels follow the Vulkan chain, every dimension above 1 is halved and rounded down. The last row or column of an
+// odd sized level only contributes to the level below through the rows and columns next to it. With SSE, RGBA8 linear
+// and normal mip texels are built four at a time and the four channels of an sRGB mip texel are averaged together, one
+// texel per step since the sRGB conversion goes through table lookups. Other targets use a scalar path.
+class MipGenerator
+{
+  public:
+	// Writes the level below the width by height level at source to destination, texelSize is in bytes
+	static void downsample(const unsigned char *source, uint32_t width, uint32_t height, uint32_t texelSize,
+						   TexelContent content, unsigned char *destination);
+
+  private:
+	static void downsampleLinear(const unsigned char *row0, const unsigned char *row1, uint32_t width,
+								 uint32_t texelSize, unsigned char *destination);
+	static void downsampleSrgb(const unsigned char *row0, const unsigned char *row1, uint32_t width,
+							   unsigned char *destination);
+	static void downsampleNormal(const unsigned char *row0, const unsigned char *row1, uint32_t width,
+								 unsigned char *destination);
+};
+} // namespace N
@@ -6,20 +6,63 @@
 
 #include <glm/glm.hpp>
 
+#include "DeletionQueue.h"
+#include "GeometryArena.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "SamplerCache.h"
+#include "StagingUploader.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
 
 namespace N
 {
 struct ModelCreateInfo
 {
 	VmaAllocator vmaAllocator;
+	vk::PhysicalDevice physicalDevice;
 	vk::Device device;
+	// Textures that are not cached yet and have their mips blitted are uploaded synchronously on this queue with this
+	// command buffer
 	vk::Queue queue;
 	vk::CommandBuffer commandBuffer;
+	// Every mesh is sub-allocated from this arena, which has to outlive the model
+	GeometryArena *geometryArena;
+	// Mesh buffers and textures with staged mip chains go through this and are uploaded asynchronously in one batch
+	StagingUploader *stagingUploader;
+	// Material textures are shared through this cache, which has to outlive the model
+	TextureCache *textureCache;
+	// Materials with the same sampler state share a sampler through this cache, which has to outlive the model
+	SamplerCache *samplerCache;
 	vk::DescriptorPool descriptorPool;
 	vk::DescriptorSetLayout descriptorSetLayout;
 	float maxAnisotropy;
+	// Shapes are built into meshes and material textures decoded across this pool, or serially on the calling thread
+	// when it is null
+	ThreadPool *threadPool;
+	// Reuse or write the binary mesh cache stored next to the OBJ file
+	bool useMeshCache;
+	// Parse OBJ files with ObjParser instead of tinyobj::ObjReader
+	bool parallelObjParsing;
+	// Run the vertex cache and vertex fetch optimizations on every newly built mesh
+	bool optimizeMeshes;
+	// Run the overdraw optimization between them as well, only with optimizeMeshes
+	bool optimizeOverdraw;
+	// Split every mesh into meshlets for cluster culling
+	bool buildMeshlets;
+	// Simplify every newly built mesh into a chain of levels of detail
+	bool generateLods;
+	// Load block compressed KTX2 textures in place of the images the materials reference where they exist
+	bool compressedTextures;
+	// Generate the mip chains of decoded textures on the worker threads instead of blitting them
+	bool cpuMipMaps;
+	// Streams the textures that have mip chains on the CPU, null to keep every level resident
+	TextureStreamer *textureStreamer;
+	// Must match the vertex format of the pipeline the model is drawn with
+	VertexFormat vertexFormat;
+	// Largest index the device draws, 2^24 - 1 without fullDrawIndexUint32. Loading a mesh with more vertices fails.
+	uint32_t maxDrawIndexedIndexValue;
 };
 
 class Model
@@ -47,14 +90,44 @@ class Model
 		this->model = model;
 	}
 
-	void draw(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout) const;
+	// Meshes and textures are uploaded asynchronously, a model may only be drawn once this returned true. The first
+	// time completedUploadValue covers the upload, the ownership acquire of the mesh buffers and textures is recorded
+	// into commandBuffer, whose submit has to wait for the upload timeline at that value.
+	bool acquireUploads(const vk::CommandBuffer &commandBuffer, uint64_t completedUploadValue);
+	bool isDrawable() const
+	{
+		return drawable;
+	}
+	// Upload timeline value the model still waits for, 0 once it is drawable
+	uint64_t getUploadTimelineValue() const
+	{
+		return meshUpload.timelineValue;
+	}
+
+	// Draws every mesh at the level of detail picked by lodSelectInfo and returns the number of triangles submitted.
+	// bindState is shared by every model drawn into commandBuffer so the arena buffers are only bound once.
+	uint64_t draw(const vk::CommandBuffer &commandBuffer, const vk::PipelineLayout &pipelineLayout,
+				  const LodSelectInfo &lodSelectInfo, GeometryBindState &bindState) const;
+	// Requests the texture resolution every mesh needs at its on screen size this frame
+	void requestTextures(TextureStreamer &textureStreamer, const LodSelectInfo &lodSelectInfo) const;
+	// Picks up images the streamer replaced, the descriptor sets they were bound in are freed at timelineValue
+	void refreshMaterials(const vk::Device &device, DeletionQueue &deletionQueue, uint64_t timelineValue);
+	// Lets the streamer change the textures of every material, refreshMaterials() has to follow its update
+	void trackTextures(TextureStreamer &textureStreamer) const;
 	void destroy(const VmaAllocator &vmaAllocator, const vk::Device &device);
 
   private:
 	std::vector<Mesh> meshes;
 	std::vector<Material> materials;
 	glm::mat4 model{1.f};
+	GeometryArena *geometryArena = nullptr;
+	TextureCache *textureCache = nullptr;
+	UploadBatch meshUpload;
+	bool drawable = false;
 
+	void buildMeshes(const ModelCreateInfo &createInfo, const std::vector<tinyobj::shape_t> &shapes,
+					 const tinyobj::attrib_t &attrib);
+	void buildMeshlets(const ModelCreateInfo &createInfo);
 	void uploadMeshes(const ModelCreateInfo &createInfo);
 };
 } // namespace N
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+namespace N
+{
+// Parsed OBJ contents in tinyobj's layout so the result can be handed straight to Mesh
+struct ObjData
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+};
+
+// Memory mapped, chunk parallel replacement for tinyobj::ObjReader::ParseFromFile.
+//
+// The file is split into chunks at line boundaries. A first pass over every chunk counts attributes and triangles and
+// records where o, g and usemtl lines start new shapes, which gives every chunk its exact output offsets. The second
+// pass parses the chunks again and writes straight into the final, exactly sized arrays, so nothing is copied or
+// regrown and the pages of a chunk are released as soon as it is done. Chunks are parsed on the thread pool when one
+// is given. Only the mapping is kept out of the working set, the arrays hold the attributes and indices of the whole
+// file, so peak memory still grows with the file size.
+//
+// Faces are triangulated as fans and a new shape is started whenever the object, group or material changes, so every
+// shape uses a single material. Vertex colors, lines, points and smoothing groups are ignored.
+class ObjParser
+{
+  public:
+	// Throws if the file cannot be opened or contains an invalid face
+	static ObjData parse(const char *path, ThreadPool *threadPool);
+};
+} // namespace N
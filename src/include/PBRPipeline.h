@@ -8,6 +8,8 @@
 
 #include <glm/glm.hpp>
 
+#include "Vertex.h"
+
 namespace N
 {
 struct PBRPipelineCreateInfo
@@ -15,6 +17,7 @@ struct PBRPipelineCreateInfo
 	vk::Device device;
 	vk::SampleCountFlagBits samples;
 	vk::RenderPass renderPass;
+	VertexFormat vertexFormat;
 };
 
 struct MVPPushConstant
@@ -65,7 +68,7 @@ class PBRPipeline
 	vk::ShaderModule vertexShader;
 	vk::ShaderModule fragmentShader;
 
-	void createShaderModules(const vk::Device &device);
+	void createShaderModules(const vk::Device &device, VertexFormat vertexFormat);
 	void destroyShaderModules(const vk::Device &device);
 	std::vector<uint32_t> loadShaderCode(const char *path);
 };
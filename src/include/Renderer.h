@@ -11,13 +11,65 @@
 #include <imgui/backends/imgui_impl_vulkan.h>
 #include <imgui/imgui.h>
 
+#include "DeletionQueue.h"
+#include "GeometryArena.h"
 #include "Model.h"
 #include "PBRPipeline.h"
 #include "RenderPass.h"
+#include "SamplerCache.h"
+#include "StagingUploader.h"
 #include "SwapChain.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include "UniformRing.h"
 
 namespace N
 {
+struct RendererSettings
+{
+	// Worker threads used for model loading, 0 uses one per hardware thread
+	uint32_t workerThreadCount = 0;
+	// Upload meshes on a transfer only queue family when the device has one, otherwise on a second graphics queue
+	bool dedicatedTransferQueue = true;
+	// Cache built meshes next to their OBJ files so later runs skip parsing
+	bool useMeshCache = true;
+	// Parse OBJ files in chunks on the worker threads straight from a memory mapping
+	bool parallelObjParsing = true;
+	// Reorder mesh triangles and vertices for vertex cache reuse, overdraw and fetch locality at load time
+	bool optimizeMeshes = true;
+	// Also sort clusters of triangles front to back when optimizing to cut overdraw, at some vertex cache efficiency
+	bool optimizeOverdraw = false;
+	// Split meshes into meshlets with culling bounds at load time
+	bool buildMeshlets = false;
+	// Generate simplified levels of detail at load time and pick one per mesh from its projected error
+	bool generateLods = true;
+	// Largest on screen error in pixels a level of detail may have to be picked
+	float lodErrorThreshold = 1.f;
+	// ePacked stores 20 instead of 60 bytes per vertex, falls back to eFull if the decode push constants do not fit
+	VertexFormat vertexFormat = VertexFormat::eFull;
+	// Load a BC compressed KTX2 file with pre-built mips in place of a material image when one sits next to it
+	bool compressedTextures = true;
+	// Build the mip chains of decoded textures on the CPU, gamma correct for albedo and renormalized for normals,
+	// instead of blitting them on the GPU
+	bool cpuMipMaps = true;
+	// Keep the full mip chains of textures that have one on the CPU and only the levels their on screen size needs
+	// resident, within the device memory budget
+	bool streamTextures = true;
+	// Textures load with their levels up to this many texels across and never drop below them
+	uint32_t textureStreamingBaseSize = 128;
+	// Share of the device local memory budget that may be used before streamed textures drop their top levels
+	float textureBudgetFraction = 0.9f;
+	// Bytes streamed textures may take in device memory on top of following the budget, 0 for no limit
+	vk::DeviceSize textureMemoryLimit = 0;
+	// Bytes of texture levels staged per frame
+	vk::DeviceSize textureUploadLimit = 32ull << 20;
+	// Frames a streamed texture keeps a raised level before it is dropped again, and stays dropped before it is raised
+	uint32_t textureStreamingHoldFrames = 60;
+	// Materials of all loaded models together the descriptor pool has room for
+	uint32_t maxMaterials = 256;
+};
+
 // FIXME: temporary
 struct ModelSettings
 {
@@ -49,7 +101,7 @@ class Renderer
 {
   public:
 	Renderer() = delete;
-	Renderer(GLFWwindow *window);
+	Renderer(GLFWwindow *window, const RendererSettings &settings = {});
 	Renderer(const Renderer &rhs) = delete;
 	Renderer(const Renderer &&rhs) = delete;
 	~Renderer();
@@ -57,6 +109,7 @@ class Renderer
 	Model createModel(const char *path);
 	void render(std::vector<Model> &models, glm::vec3 cameraPos, glm::mat4 view);
 	void destroy();
+	// Takes the resources of model, which is left empty, and frees them once no submitted frame uses them anymore
 	void destroyModel(Model &model);
 
   private:
@@ -68,11 +121,13 @@ class Renderer
 	N::SwapChain swapChain;
 	N::RenderPass renderPass;
 	vk::Queue graphicsQueue;
+	vk::Queue transferQueue;
 	N::PBRPipeline pipeline;
 	vk::DescriptorPool descriptorPool;
 	vk::CommandPool commandPool;
 
 	int graphicsQueueIndex;
+	int transferQueueIndex;
 	vk::SampleCountFlagBits samples;
 	vk::Format depthFormat;
 
@@ -80,14 +135,32 @@ class Renderer
 	std::vector<ImageObject> renderTargets;
 	std::vector<vk::Framebuffer> frameBuffers;
 	std::vector<vk::CommandBuffer> commandBuffers;
+	// Single time commands outside of the frame loop, e.g. texture and font uploads
+	vk::CommandBuffer uploadCommandBuffer;
 	std::vector<vk::Semaphore> imageAvailableSemaphores;
 	std::vector<vk::Semaphore> renderFinishedSemaphores;
 	std::vector<vk::Fence> inFlightFences;
+	// Signaled with the number of every frame submit, tags deferred deletions
+	vk::Semaphore frameTimeline;
+	uint64_t frameTimelineValue = 0;
+	DeletionQueue deletionQueue;
 
 	int framesInFlight = 2;
 	int currentFrame = 0;
 
 	VmaAllocator vmaAllocator;
+	StagingUploader stagingUploader;
+	GeometryArena geometryArena;
+	// Shared by the materials of every model, a texture lives until the last material using it is destroyed
+	TextureCache textureCache;
+	TextureStreamer textureStreamer;
+	// Samplers are shared by every material with the same state, devices only allow maxSamplerAllocationCount of them
+	SamplerCache samplerCache;
+	// VK_EXT_memory_budget is enabled, so VMA reports the budget the driver gives instead of estimating it
+	bool memoryBudgetSupported = false;
+
+	RendererSettings settings;
+	ThreadPool threadPool;
 
 	GLFWwindow *window;
 	ImGuiContext *imGuiContext;
@@ -98,10 +171,13 @@ class Renderer
 
 	ModelSettings modelSettings{{0.f, 5.f, 2.f}, {}};
 	N::MVPPushConstant mvpPushConstant;
+	// Triangles submitted in the previous frame after level of detail selection
+	uint64_t drawnTriangles = 0;
 
 	void createInstance();
 	void selectPhysicalDevice();
 	void selectGraphicsQueue();
+	void selectTransferQueue();
 	void createDevice();
 	void createCommandPool();
 	void createSurface();
@@ -119,8 +195,7 @@ class Renderer
 	void createDescriptorSet();
 	vk::DescriptorSet cameraSettingsSet;
 
-	vk::Buffer cameraSettingsBuffer;
-	VmaAllocation cameraSettingsBufferAllocation;
-	VmaAllocationInfo cameraSettingsAllocInfo;
+	// Camera settings and any other per frame uniform data
+	UniformRing uniformRing;
 };
 } // namespace N
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include <vulkan/vulkan.hpp>
+
+namespace N
+{
+struct SamplerCacheCreateInfo
+{
+	vk::Device device;
+};
+
+// The state samplers are told apart by, everything else is the same for every sampler of the renderer
+struct SamplerState
+{
+	vk::Filter magFilter = vk::Filter::eLinear;
+	vk::Filter minFilter = vk::Filter::eLinear;
+	vk::SamplerMipmapMode mipmapMode = vk::SamplerMipmapMode::eLinear;
+	// For U, V and W
+	vk::SamplerAddressMode addressMode = vk::SamplerAddressMode::eClampToEdge;
+	// Anisotropic filtering is off at 1
+	float maxAnisotropy = 1.f;
+	// The image view already limits sampling to its levels, so samplers only clamp the LOD when asked to
+	float maxLod = vk::LodClampNone;
+
+	bool operator==(const SamplerState &rhs) const = default;
+};
+
+// Reference counted samplers keyed by their state, so materials with the same sampler state share one vk::Sampler
+// instead of each creating its own against the device's maxSamplerAllocationCount. Not thread safe, acquire() and
+// release() have to be called on the render thread, which both loads models and runs their deferred deletions.
+class SamplerCache
+{
+  public:
+	SamplerCache() = default;
+	SamplerCache(const SamplerCache &) = delete;
+	SamplerCache &operator=(const SamplerCache &) = delete;
+
+	void create(const SamplerCacheCreateInfo &createInfo);
+	// Destroys every sampler that is still referenced, the device has to be done with all of them
+	void destroy();
+
+	// Returns the sampler for state and adds a reference to it, creating it on the first request
+	vk::Sampler acquire(const SamplerState &state);
+	// Drops a reference, the sampler is destroyed with the last one
+	void release(vk::Sampler sampler);
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+	uint64_t getHits() const
+	{
+		return hits;
+	}
+	uint64_t getMisses() const
+	{
+		return misses;
+	}
+	// References held across every sampler, one per material using it
+	uint64_t getReferences() const
+	{
+		return references;
+	}
+
+  private:
+	struct StateHash
+	{
+		size_t operator()(const SamplerState &state) const;
+	};
+
+	struct Entry
+	{
+		vk::Sampler sampler;
+		uint32_t references;
+	};
+
+	vk::Device device;
+
+	std::unordered_map<SamplerState, Entry, StateHash> entries;
+	// Finds the entry of a released sampler
+	std::unordered_map<VkSampler, SamplerState> states;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t references = 0;
+};
+} // namespace N
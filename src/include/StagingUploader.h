@@ -0,0 +1,145 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+namespace N
+{
+struct StagingUploaderCreateInfo
+{
+	VmaAllocator vmaAllocator;
+	vk::Device device;
+	// Queue the copies are submitted to, ideally from a transfer only family
+	vk::Queue queue;
+	uint32_t queueFamilyIndex;
+	// Family the destination buffers and images are used on, ownership is transferred to it when it differs from
+	// queueFamilyIndex
+	uint32_t dstQueueFamilyIndex;
+	// Of queueFamilyIndex, image levels that do not fit the staging ring are split into rows of texels at multiples
+	// of its height. A height of 0 only allows whole levels.
+	vk::Extent3D minImageTransferGranularity{1, 1, 1};
+	// Size of the persistently mapped staging ring, larger uploads are split across several submits
+	vk::DeviceSize capacity = 64ull << 20;
+};
+
+// Everything staged between two calls to StagingUploader::submitBatch
+struct UploadBatch
+{
+	// Value of the uploader's timeline semaphore that is reached once every copy of the batch is done
+	uint64_t timelineValue = 0;
+	uint64_t bytes = 0;
+	uint32_t submits = 0;
+	std::chrono::high_resolution_clock::time_point startTime;
+	// Acquire halves of the queue family ownership transfers. They have to be recorded on the destination family in a
+	// submit that waits for timelineValue before the buffers are used there. Empty when no transfer is needed.
+	std::vector<vk::BufferMemoryBarrier> acquireBarriers;
+};
+
+// Uploads buffer and image data through a persistently mapped staging ring on its own queue and command pool. Data is
+// written straight into the ring and the copies are recorded into one command buffer per submit. Submits signal
+// increasing values of a timeline semaphore, which is also what tells the ring when staging space can be reused, so
+// the CPU only ever waits when the ring is full.
+class StagingUploader
+{
+  public:
+	// Writes size bytes of source data for the destination range starting at byte offset into the mapped pointer
+	using WriteFunction = std::function<void(void *mapped, vk::DeviceSize offset, vk::DeviceSize size)>;
+	// Writes size bytes of a mip level starting at byte offset into the level into the mapped pointer
+	using ImageWriteFunction =
+		std::function<void(void *mapped, uint32_t level, vk::DeviceSize offset, vk::DeviceSize size)>;
+
+	StagingUploader() = default;
+	StagingUploader(const StagingUploader &) = delete;
+	StagingUploader &operator=(const StagingUploader &) = delete;
+
+	void create(const StagingUploaderCreateInfo &createInfo);
+	// Waits for every upload that is still in flight
+	void destroy();
+
+	// Stages size bytes for dstBuffer at dstOffset. The range is split into pieces of whole elements when it does not
+	// fit the staging ring and write is called once per piece.
+	void upload(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, vk::DeviceSize size, vk::DeviceSize elementSize,
+				const WriteFunction &write);
+	void upload(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, const void *data, vk::DeviceSize size);
+	// Stages every level of image, whose level 0 is width by height texels of format, and leaves it in shader read
+	// only layout. Levels that do not fit the staging ring are split into bands of rows. Returns the timeline
+	// value the image is filled at. acquireBarrier is set to the acquire half of the ownership transfer, which has to
+	// be recorded on the destination family like the batch's, or reset when no transfer is needed.
+	uint64_t uploadImage(vk::Image image, vk::Format format, uint32_t width, uint32_t height, uint32_t levelCount,
+						 const ImageWriteFunction &write, std::optional<vk::ImageMemoryBarrier> &acquireBarrier);
+
+	// Submits the copies recorded so far without waiting and hands out the batch they belong to
+	UploadBatch submitBatch();
+	// Submits the recorded copies and blocks until every upload is done
+	void flush();
+	// Blocks until the uploads up to timelineValue are done
+	void wait(uint64_t timelineValue);
+
+	vk::Semaphore getTimelineSemaphore() const
+	{
+		return timelineSemaphore;
+	}
+	uint64_t getCompletedValue() const
+	{
+		return device.getSemaphoreCounterValue(timelineSemaphore);
+	}
+
+  private:
+	struct Submission
+	{
+		vk::CommandBuffer commandBuffer;
+		uint64_t timelineValue;
+		// Ring bytes used by the submit, including alignment padding and space skipped when wrapping
+		vk::DeviceSize consumed;
+	};
+
+	VmaAllocator vmaAllocator;
+	vk::Device device;
+	vk::Queue queue;
+	uint32_t queueFamilyIndex;
+	uint32_t dstQueueFamilyIndex;
+	vk::Extent3D minImageTransferGranularity;
+	vk::CommandPool commandPool;
+	vk::Semaphore timelineSemaphore;
+	uint64_t lastSubmittedValue = 0;
+
+	vk::Buffer stagingBuffer;
+	VmaAllocation stagingBufferAllocation;
+	unsigned char *stagingData = nullptr;
+	vk::DeviceSize capacity = 0;
+	// Bytes [tail, head) of the ring, wrapping around, are used by in flight and recorded copies
+	vk::DeviceSize head = 0;
+	vk::DeviceSize tail = 0;
+	vk::DeviceSize used = 0;
+
+	vk::CommandBuffer commandBuffer;
+	bool recording = false;
+	vk::DeviceSize recordingConsumed = 0;
+	std::vector<vk::BufferMemoryBarrier> releaseBarriers;
+	std::vector<vk::ImageMemoryBarrier> imageReleaseBarriers;
+
+	std::deque<Submission> inFlight;
+	std::vector<vk::CommandBuffer> freeCommandBuffers;
+
+	UploadBatch batch;
+
+	// Places size bytes in the ring piece by piece, calling write and then record with the ring offset, the bytes
+	// written so far and the size of every piece
+	using RecordFunction = std::function<void(vk::DeviceSize offset, vk::DeviceSize written, vk::DeviceSize size)>;
+	void stage(vk::DeviceSize size, vk::DeviceSize elementSize, const WriteFunction &write,
+			   const RecordFunction &record);
+	bool place(vk::DeviceSize remaining, vk::DeviceSize elementSize, vk::DeviceSize &offset,
+			   vk::DeviceSize &pieceSize);
+	void beginRecording();
+	void submitRecording();
+	// Frees the ring space and command buffers of finished submits, waiting for the oldest one if waitOldest is set
+	void retire(bool waitOldest);
+};
+} // namespace N
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// Generates per vertex tangent frames for normal mapping. Per triangle tangents and bitangents are derived from the
+// texture coordinate gradients and summed per vertex, then the tangent is Gram-Schmidt orthonormalized against the
+// vertex normal and the bitangent handedness is stored in tangent.w, so B = cross(N, T.xyz) * T.w.
+//
+// Triangles and vertices are processed four at a time with SSE when available, with a scalar path for other targets.
+class TangentGenerator
+{
+  public:
+	static void generate(std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+	// Only the scalar path generate() falls back to on other targets, which the SSE path has to match
+	static void generateScalar(std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+
+  private:
+	struct Accumulators
+	{
+		std::vector<float> tangentX, tangentY, tangentZ;
+		std::vector<float> bitangentX, bitangentY, bitangentZ;
+	};
+
+	static void generate(std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, bool useSse);
+	static void accumulateTriangle(const std::vector<Vertex> &vertices, const uint32_t *corners,
+								   Accumulators &accumulators);
+	static void finishVertex(Vertex &vertex, const Accumulators &accumulators, size_t index);
+};
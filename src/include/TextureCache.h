@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+namespace N
+{
+struct TextureCacheCreateInfo
+{
+	VmaAllocator vmaAllocator;
+	vk::Device device;
+};
+
+// An uploaded texture, shared by every material that references the same file contents
+struct CachedTexture
+{
+	struct FreeDeleter
+	{
+		void operator()(unsigned char *data) const
+		{
+			free(data);
+		}
+	};
+
+	uint64_t contentHash;
+	vk::Format format;
+	VkImage image;
+	VkImageView view;
+	VmaAllocation allocation;
+	// Of the full mip chain, the image may only hold its smaller levels
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipLevels;
+	// The image holds every level from this one to the end of the chain, level 0 unless the texture is streamed
+	uint32_t firstResidentLevel = 0;
+	// The full chain as laid out by TextureLayout, which streamed textures upload their levels from. Null for textures
+	// that are always fully resident.
+	std::unique_ptr<unsigned char[], FreeDeleter> chain;
+	// Value of the staging uploader's timeline the image is filled at, 0 once the graphics queue may use it
+	uint64_t uploadTimelineValue = 0;
+	// Acquire half of the image's ownership transfer to the graphics queue, recorded once the upload is done
+	std::optional<vk::ImageMemoryBarrier> acquireBarrier;
+
+	uint32_t getResidentLevels() const
+	{
+		return mipLevels - firstResidentLevel;
+	}
+};
+
+// Reference counted textures keyed by the hash of their source file and the format they were uploaded in, so a map
+// that several materials or models reference is decoded, uploaded and stored once. Not thread safe, textures are
+// looked up and inserted on the thread that records their uploads.
+class TextureCache
+{
+  public:
+	TextureCache() = default;
+	TextureCache(const TextureCache &) = delete;
+	TextureCache &operator=(const TextureCache &) = delete;
+
+	void create(const TextureCacheCreateInfo &createInfo);
+	// Destroys every texture that is still referenced, the device has to be done with all of them
+	void destroy();
+
+	// Returns the cached texture and adds a reference to it, or null if it still has to be loaded
+	const CachedTexture *acquire(uint64_t contentHash, vk::Format format);
+	// Takes ownership of a newly uploaded texture, which starts out with one reference
+	const CachedTexture *insert(CachedTexture &&texture);
+	// Drops a reference, the image and view are destroyed with the last one
+	void release(const CachedTexture *texture);
+	// Visits every cached texture with its reference count, e.g. for streaming to swap their images
+	void forEach(const std::function<void(CachedTexture &, uint32_t)> &function);
+	// Hands every texture uploaded up to completedUploadValue to the graphics queue, recording the ownership acquire
+	// into commandBuffer, whose submit has to wait for the upload timeline at that value
+	void acquireUploads(const vk::CommandBuffer &commandBuffer, uint64_t completedUploadValue);
+
+	// Creates the image and view for the resident levels of texture, sampled and written by transfers. Mip chains
+	// that are blitted on the GPU also need the image as a transfer source.
+	static void createImage(const VmaAllocator &allocator, const vk::Device &device, bool generateMipMaps,
+							CachedTexture &texture);
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+	uint64_t getHits() const
+	{
+		return hits;
+	}
+	uint64_t getMisses() const
+	{
+		return misses;
+	}
+
+  private:
+	struct Key
+	{
+		uint64_t contentHash;
+		vk::Format format;
+
+		bool operator==(const Key &rhs) const = default;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const
+		{
+			return static_cast<size_t>(key.contentHash ^ (static_cast<uint64_t>(key.format) * 0x9E3779B97F4A7C15ull));
+		}
+	};
+
+	struct Entry
+	{
+		CachedTexture texture;
+		uint32_t references;
+	};
+
+	VmaAllocator vmaAllocator;
+	vk::Device device;
+
+	// Node based, so the textures handed out keep their address while other entries come and go
+	std::unordered_map<Key, Entry, KeyHash> entries;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+
+	void destroyTexture(const CachedTexture &texture);
+};
+} // namespace N
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+namespace N
+{
+// Sizes of texture levels and the layout of mip chains in host memory and staging buffers. A chain holds its levels
+// largest first, each starting at a multiple of chainAlignment so every level can be copied straight into an image.
+class TextureLayout
+{
+  public:
+	// Copies out of a buffer have to start at a multiple of the texel block size
+	static constexpr vk::DeviceSize chainAlignment = 16;
+
+	static vk::DeviceSize align(vk::DeviceSize size)
+	{
+		return (size + chainAlignment - 1) & ~(chainAlignment - 1);
+	}
+
+	// Width or height of a level, levels never get smaller than one texel
+	static uint32_t getLevelExtent(uint32_t extent, uint32_t level)
+	{
+		return std::max(extent >> level, 1u);
+	}
+
+	// Bytes per texel of the uncompressed formats images are decoded to, throws for any other format
+	static uint32_t getTexelSize(vk::Format format);
+	// Bytes of one width by height level, block compressed formats included
+	static vk::DeviceSize getLevelSize(vk::Format format, uint32_t width, uint32_t height);
+	// Device memory levels [firstLevel, endLevel) of a texture take, ignoring any padding the driver adds
+	static vk::DeviceSize getMemorySize(vk::Format format, uint32_t width, uint32_t height, uint32_t firstLevel,
+										uint32_t endLevel);
+	// Where a level starts in the chain of a texture, getChainOffset(..., mipLevels) is the size of the whole chain
+	static vk::DeviceSize getChainOffset(vk::Format format, uint32_t width, uint32_t height, uint32_t level);
+};
+} // namespace N
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+#include "DeletionQueue.h"
+#include "TextureCache.h"
+
+namespace N
+{
+struct TextureStreamerCreateInfo
+{
+	VmaAllocator vmaAllocator;
+	vk::Device device;
+	// The streamed textures are the cached ones that hold their chain in host memory
+	TextureCache *textureCache;
+	// Replaced images and the staging buffers of each frame are freed through this once the frame retired
+	DeletionQueue *deletionQueue;
+	// Textures are loaded with their levels up to this size in texels resident and never dropped below them
+	uint32_t baseSize;
+	// Share of the device local memory budget VMA reports that may be in use before top levels are dropped
+	float budgetFraction;
+	// Bytes streamed textures may take in device memory, 0 to only follow the budget
+	vk::DeviceSize memoryLimit;
+	// Bytes staged per frame, a frame always raises at least one level so large levels still get through
+	vk::DeviceSize uploadLimit;
+	// Frames a raised texture is preferably not dropped for, and a dropped texture is not raised for
+	uint32_t holdFrames;
+};
+
+struct TextureStreamerStats
+{
+	size_t streamedTextures = 0;
+	uint32_t residentLevels = 0;
+	uint32_t totalLevels = 0;
+	// Device memory the resident levels take and what every streamed texture fully resident would take
+	vk::DeviceSize residentBytes = 0;
+	vk::DeviceSize fullBytes = 0;
+	// Over every device local heap, as VMA reports it
+	vk::DeviceSize budgetBytes = 0;
+	vk::DeviceSize usageBytes = 0;
+	// Replaced images that are still part of usageBytes until the frames that copied from them retired
+	vk::DeviceSize releasingBytes = 0;
+	// Levels made resident and dropped since the streamer was created
+	uint64_t raisedLevels = 0;
+	uint64_t droppedLevels = 0;
+	// Bytes staged in the last update
+	vk::DeviceSize uploadedBytes = 0;
+};
+
+// Keeps the mip levels of textures resident that their on screen size needs, within the device memory budget.
+// Textures start out with only their small levels resident. Every frame the meshes request the resolution they are
+// drawn at, and update() raises the residency of requested textures while the budget allows and drops the top levels
+// of the least recently requested textures when it is exceeded.
+//
+// A residency change replaces the texture's image with one holding the new range of levels. The levels both images
+// share are copied on the GPU, the others are staged from the chain in host memory, and the old image is freed once
+// the frame that copied from it retired. Materials rewrite their descriptor sets when they see the new views, so only
+// textures whose every reference was tracked this frame are changed, the others keep their images.
+class TextureStreamer
+{
+  public:
+	TextureStreamer() = default;
+	TextureStreamer(const TextureStreamer &) = delete;
+	TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+	void create(const TextureStreamerCreateInfo &createInfo);
+	void destroy();
+
+	// Level a texture is loaded with and the streamer never drops it below
+	uint32_t getBaseLevel(const CachedTexture &texture) const;
+
+	// Asks for the texture to be sharp at a size of pixels across on screen this frame
+	void request(const CachedTexture *texture, float pixels);
+	// Counts one cache reference to the texture whose holder picks up replaced images after this frame's update
+	void track(const CachedTexture *texture);
+	// Changes the residency of textures from this frame's requests and the budget, and records the copies into
+	// commandBuffer outside of a render pass. frameTimelineValue is the value the frame it is submitted with signals.
+	void update(const vk::CommandBuffer &commandBuffer, uint64_t frameTimelineValue);
+
+	const TextureStreamerStats &getStats() const
+	{
+		return stats;
+	}
+
+  private:
+	// Frames a texture was last requested, raised and dropped in, 0 for never
+	struct History
+	{
+		uint64_t lastRequestFrame = 0;
+		uint64_t lastRaiseFrame = 0;
+		uint64_t lastDropFrame = 0;
+	};
+
+	struct Change
+	{
+		CachedTexture *texture;
+		uint32_t firstLevel;
+		// The requested level, or the first level when the texture was not requested this frame
+		uint32_t wantedLevel;
+		History history;
+	};
+
+	VmaAllocator vmaAllocator;
+	vk::Device device;
+	TextureCache *textureCache;
+	DeletionQueue *deletionQueue;
+	uint32_t baseSize;
+	float budgetFraction;
+	vk::DeviceSize memoryLimit;
+	vk::DeviceSize uploadLimit;
+	uint32_t holdFrames;
+
+	uint64_t frame = 0;
+	// Device memory of replaced images waiting in the deletion queue, their deleters take it off again
+	vk::DeviceSize releasingBytes = 0;
+	// Smallest level requested for each texture this frame
+	std::unordered_map<const CachedTexture *, uint32_t> requests;
+	// Of every streamed texture, textures that were not requested for the longest time drop their levels first
+	std::unordered_map<const CachedTexture *, History> histories;
+	// References tracked for each texture this frame
+	std::unordered_map<const CachedTexture *, uint32_t> trackedReferences;
+	TextureStreamerStats stats;
+
+	void measureBudget(vk::DeviceSize &budget, vk::DeviceSize &usage);
+	void recordChanges(const vk::CommandBuffer &commandBuffer, uint64_t frameTimelineValue,
+					   const std::vector<Change> &changes);
+};
+} // namespace N
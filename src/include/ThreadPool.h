@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace N
+{
+class ThreadPool
+{
+  public:
+	// A thread count of 0 uses one worker per hardware thread
+	explicit ThreadPool(uint32_t threadCount = 0);
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+	~ThreadPool();
+
+	uint32_t getThreadCount() const
+	{
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	template <typename F> std::future<std::invoke_result_t<F>> submit(F &&task)
+	{
+		using Result = std::invoke_result_t<F>;
+
+		auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		auto future = packagedTask->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.emplace([packagedTask]() { (*packagedTask)(); });
+		}
+		condition.notify_one();
+
+		return future;
+	}
+
+	// Runs task(i) for every i in [0, count) and blocks until all of them are done. The first exception thrown by a
+	// task is rethrown on the calling thread. Must not be called from inside a pool task.
+	void parallelFor(size_t count, const std::function<void(size_t)> &task);
+
+  private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	void workerLoop();
+};
+} // namespace N
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+namespace N
+{
+struct UniformRingCreateInfo
+{
+	VmaAllocator vmaAllocator;
+	uint32_t framesInFlight;
+	// minUniformBufferOffsetAlignment of the device, every allocation starts at a multiple of it
+	vk::DeviceSize offsetAlignment;
+	// Uniform data a single frame may allocate
+	vk::DeviceSize frameSize = 64 * 1024;
+};
+
+// Persistently mapped uniform buffer split into one region per frame in flight. Per frame data is sub-allocated from
+// the region of the current frame and bound through dynamic uniform buffer descriptors with the returned offsets. A
+// region is only written again once the fence of the frame that used it was waited on, so writes never race the GPU
+// and need no locking or stalls.
+class UniformRing
+{
+  public:
+	UniformRing() = default;
+	UniformRing(const UniformRing &) = delete;
+	UniformRing &operator=(const UniformRing &) = delete;
+
+	void create(const UniformRingCreateInfo &createInfo);
+	void destroy();
+
+	// Starts allocating from the start of the region of frame, whose previous use must have finished
+	void beginFrame(uint32_t frame);
+	// Returns the dynamic offset of size freshly allocated bytes and their mapped pointer in data
+	uint32_t allocate(vk::DeviceSize size, void *&data);
+	// Flushes everything written this frame, a no-op on host coherent memory
+	void endFrame();
+
+	template <typename T> uint32_t push(const T &value)
+	{
+		void *data;
+		uint32_t offset = allocate(sizeof(T), data);
+		memcpy(data, &value, sizeof(T));
+		return offset;
+	}
+
+	vk::Buffer getBuffer() const
+	{
+		return buffer;
+	}
+
+  private:
+	VmaAllocator vmaAllocator;
+	vk::Buffer buffer;
+	VmaAllocation bufferAllocation;
+	unsigned char *mappedData = nullptr;
+
+	vk::DeviceSize offsetAlignment;
+	vk::DeviceSize frameSize;
+	vk::DeviceSize frameStart = 0;
+	vk::DeviceSize frameHead = 0;
+};
+} // namespace N
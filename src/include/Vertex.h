@@ -1,17 +1,29 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vulkan/vulkan.hpp>
 
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
 
+enum class VertexFormat
+{
+	// Vertex, 32 bit floats for every attribute
+	eFull,
+	// PackedVertex, quantized attributes decoded in the vertex shader
+	ePacked
+};
+
 struct Vertex
 {
 	glm::vec3 pos;
 	glm::vec3 color;
 	glm::vec2 texCoords;
 	glm::vec3 normal;
-	glm::vec3 tangent;
+	// xyz unit tangent orthogonal to the normal, w the bitangent sign
+	glm::vec4 tangent;
 
 	bool operator==(const Vertex &other) const
 	{
@@ -35,12 +47,113 @@ struct Vertex
 		vertexAttributeDescriptions.emplace_back(1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, color));
 		vertexAttributeDescriptions.emplace_back(2, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, texCoords));
 		vertexAttributeDescriptions.emplace_back(3, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, normal));
-		vertexAttributeDescriptions.emplace_back(4, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, tangent));
+		vertexAttributeDescriptions.emplace_back(4, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Vertex, tangent));
 
 		return vertexAttributeDescriptions;
 	}
 };
 
+// Pushed right after the MVP matrices when drawing packed vertices, maps the quantized attributes back to mesh space
+struct PackedVertexDecode
+{
+	glm::vec4 positionOffset;
+	glm::vec4 positionScale;
+	// xy offset, zw scale
+	glm::vec4 texCoordOffsetScale;
+};
+
+// 20 byte compressed Vertex. Positions and texture coordinates are unorm16 relative to the bounds of their mesh, the
+// normal and tangent are octahedral encoded snorm16 pairs. The color attribute is dropped.
+struct PackedVertex
+{
+	// xyz position, w holds the bitangent sign as 0 for -1 and 65535 for +1
+	uint16_t pos[4];
+	int16_t normal[2];
+	uint16_t texCoords[2];
+	int16_t tangent[2];
+
+	static vk::VertexInputBindingDescription getBindingDescription()
+	{
+		vk::VertexInputBindingDescription vertexInputBindingDescription;
+		vertexInputBindingDescription.setBinding(0);
+		vertexInputBindingDescription.setStride(sizeof(PackedVertex));
+		vertexInputBindingDescription.setInputRate(vk::VertexInputRate::eVertex);
+
+		return vertexInputBindingDescription;
+	}
+
+	static std::vector<vk::VertexInputAttributeDescription> getAttributeDescription()
+	{
+		std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescriptions;
+		vertexAttributeDescriptions.emplace_back(0, 0, vk::Format::eR16G16B16A16Unorm, offsetof(PackedVertex, pos));
+		vertexAttributeDescriptions.emplace_back(1, 0, vk::Format::eR16G16Snorm, offsetof(PackedVertex, normal));
+		vertexAttributeDescriptions.emplace_back(2, 0, vk::Format::eR16G16Unorm, offsetof(PackedVertex, texCoords));
+		vertexAttributeDescriptions.emplace_back(3, 0, vk::Format::eR16G16Snorm, offsetof(PackedVertex, tangent));
+
+		return vertexAttributeDescriptions;
+	}
+
+	static PackedVertex pack(const Vertex &vertex, const PackedVertexDecode &decode)
+	{
+		PackedVertex packed;
+
+		for (int i = 0; i < 3; i++)
+		{
+			float scale = decode.positionScale[i];
+			float normalized = scale > 0.f ? (vertex.pos[i] - decode.positionOffset[i]) / scale : 0.f;
+			packed.pos[i] = quantizeUnorm16(normalized);
+		}
+		packed.pos[3] = vertex.tangent.w < 0.f ? 0 : UINT16_MAX;
+
+		for (int i = 0; i < 2; i++)
+		{
+			float scale = decode.texCoordOffsetScale[2 + i];
+			float normalized = scale > 0.f ? (vertex.texCoords[i] - decode.texCoordOffsetScale[i]) / scale : 0.f;
+			packed.texCoords[i] = quantizeUnorm16(normalized);
+		}
+
+		glm::vec2 octNormal = octEncode(vertex.normal);
+		packed.normal[0] = quantizeSnorm16(octNormal.x);
+		packed.normal[1] = quantizeSnorm16(octNormal.y);
+
+		glm::vec2 octTangent = octEncode(glm::vec3{vertex.tangent});
+		packed.tangent[0] = quantizeSnorm16(octTangent.x);
+		packed.tangent[1] = quantizeSnorm16(octTangent.y);
+
+		return packed;
+	}
+
+	// Octahedral mapping of a direction onto the [-1, 1] square, see shader_packed.vert for the inverse
+	static glm::vec2 octEncode(const glm::vec3 &direction)
+	{
+		float l1Norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+		if (l1Norm == 0.f)
+			return glm::vec2{0.f};
+
+		glm::vec2 encoded{direction.x / l1Norm, direction.y / l1Norm};
+		if (direction.z < 0.f)
+		{
+			encoded = glm::vec2{(1.f - std::abs(encoded.y)) * (encoded.x >= 0.f ? 1.f : -1.f),
+								(1.f - std::abs(encoded.x)) * (encoded.y >= 0.f ? 1.f : -1.f)};
+		}
+
+		return encoded;
+	}
+
+	static uint16_t quantizeUnorm16(float value)
+	{
+		return static_cast<uint16_t>(std::lround(std::clamp(value, 0.f, 1.f) * UINT16_MAX));
+	}
+
+	static int16_t quantizeSnorm16(float value)
+	{
+		return static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * INT16_MAX));
+	}
+};
+
+static_assert(sizeof(Vertex) == 60);
+static_assert(sizeof(PackedVertex) == 20);
+
 namespace std
 {
 template <> struct hash<Vertex>
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// Flat open-addressing table used to deduplicate vertices while a mesh is assembled. Slots only hold an index into the
+// vertex array being built, so the table never stores a second copy of a vertex and never allocates per entry.
+//
+// Vertices are hashed and compared over their raw bytes from pos up to (but not including) tangent, which is the
+// same set of fields Vertex::operator== looks at. Comparing bytes means -0.f and 0.f are treated as different values.
+class VertexDedupTable
+{
+  public:
+	// Sized so that maxVertices unique vertices keep the load factor at or below one half
+	explicit VertexDedupTable(size_t maxVertices);
+
+	// Returns the index of an identical vertex already in vertices, or appends vertex and returns its new index
+	uint32_t findOrInsert(const Vertex &vertex, std::vector<Vertex> &vertices);
+
+	static uint64_t hash(const Vertex &vertex);
+
+  private:
+	static constexpr uint32_t emptySlot = UINT32_MAX;
+	static constexpr size_t keySize = offsetof(Vertex, tangent);
+
+	struct Slot
+	{
+		uint32_t hash;
+		uint32_t index;
+	};
+
+	std::vector<Slot> slots;
+	size_t mask;
+};
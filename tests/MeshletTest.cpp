@@ -0,0 +1,154 @@
+// CPU tests for MeshletBuilder. Exits with a non-zero code if any check fails.
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Meshlet.h"
+#include "Vertex.h"
+
+int failures = 0;
+
+void check(bool condition, const char *what)
+{
+	if (!condition)
+	{
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+// A size by size grid of vertices in the z = 0 plane spanning [0, extent], with every triangle facing +z. bumps
+// displaces the vertices along z so the meshlets are not flat.
+void buildPatch(uint32_t size, float extent, bool bumps, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+	vertices.clear();
+	indices.clear();
+
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			Vertex vertex{};
+			vertex.pos = glm::vec3{extent * x / (size - 1), extent * y / (size - 1), 0.f};
+			if (bumps)
+				vertex.pos.z = 0.25f * std::sin(vertex.pos.x * 3.f) * std::cos(vertex.pos.y * 2.f);
+			vertices.push_back(vertex);
+		}
+	}
+
+	for (uint32_t y = 0; y + 1 < size; y++)
+	{
+		for (uint32_t x = 0; x + 1 < size; x++)
+		{
+			uint32_t corner = y * size + x;
+			indices.insert(indices.end(), {corner, corner + 1, corner + size + 1});
+			indices.insert(indices.end(), {corner, corner + size + 1, corner + size});
+		}
+	}
+}
+
+void testLimitsAndIndices()
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	buildPatch(60, 4.f, true, vertices, indices);
+	// A degenerate triangle repeating a corner still has to come back exactly
+	indices.insert(indices.end(), {5, 5, 6});
+
+	MeshletData data = MeshletBuilder::build(vertices, indices);
+	check(data.meshlets.size() > 1, "the patch is split into several meshlets");
+
+	std::vector<uint32_t> rebuilt;
+	for (const Meshlet &meshlet : data.meshlets)
+	{
+		check(meshlet.vertexCount > 0 && meshlet.vertexCount <= MeshletBuilder::defaultMaxVertices,
+			  "a meshlet has at most 64 vertices");
+		check(meshlet.triangleCount > 0 && meshlet.triangleCount <= MeshletBuilder::defaultMaxTriangles,
+			  "a meshlet has at most 124 triangles");
+		check(meshlet.vertexOffset + meshlet.vertexCount <= data.vertices.size(),
+			  "the vertex range of a meshlet is inside the vertex array");
+		check((meshlet.triangleOffset + meshlet.triangleCount) * 3 <= data.triangles.size(),
+			  "the triangle range of a meshlet is inside the triangle array");
+
+		for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++)
+		{
+			uint8_t local = data.triangles[meshlet.triangleOffset * 3 + i];
+			check(local < meshlet.vertexCount, "local indices stay below the meshlet's vertex count");
+			rebuilt.push_back(data.vertices[meshlet.vertexOffset + local]);
+		}
+
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+		{
+			const glm::vec3 &position = vertices[data.vertices[meshlet.vertexOffset + i]].pos;
+			check(glm::distance(meshlet.center, position) <= meshlet.radius * (1.f + 1e-5f) + 1e-6f,
+				  "the bounding sphere contains every vertex of its meshlet");
+		}
+	}
+
+	check(rebuilt == indices, "the local indices rebuild the original triangles exactly");
+
+	// Smaller limits split differently but must hold as well
+	data = MeshletBuilder::build(vertices, indices, 16, 20);
+	for (const Meshlet &meshlet : data.meshlets)
+	{
+		check(meshlet.vertexCount <= 16 && meshlet.triangleCount <= 20, "meshlets respect custom limits");
+	}
+}
+
+void testBackfacing()
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	buildPatch(4, 1.f, false, vertices, indices);
+
+	MeshletData data = MeshletBuilder::build(vertices, indices);
+	check(data.meshlets.size() == 1, "a small patch fits in one meshlet");
+	if (data.meshlets.empty())
+		return;
+
+	const Meshlet &meshlet = data.meshlets[0];
+	check(std::abs(meshlet.coneAxis.z - 1.f) < 1e-5f, "the cone of a flat patch points along its normal");
+	check(!MeshletBuilder::isBackfacing(meshlet, glm::vec3{0.5f, 0.5f, 10.f}),
+		  "a flat patch seen from the front is not backfacing");
+	check(MeshletBuilder::isBackfacing(meshlet, glm::vec3{0.5f, 0.5f, -10.f}),
+		  "a flat patch seen from behind is backfacing");
+}
+
+void testFrustum()
+{
+	// The [-1, 1] cube, normals pointing inwards
+	std::array<glm::vec4, 6> planes{glm::vec4{1.f, 0.f, 0.f, 1.f}, glm::vec4{-1.f, 0.f, 0.f, 1.f},
+									glm::vec4{0.f, 1.f, 0.f, 1.f}, glm::vec4{0.f, -1.f, 0.f, 1.f},
+									glm::vec4{0.f, 0.f, 1.f, 1.f}, glm::vec4{0.f, 0.f, -1.f, 1.f}};
+
+	Meshlet meshlet{};
+	meshlet.radius = 0.5f;
+
+	meshlet.center = glm::vec3{0.f, 0.f, 0.f};
+	check(!MeshletBuilder::isOutsideFrustum(meshlet, planes), "a sphere fully inside the frustum is kept");
+
+	meshlet.center = glm::vec3{5.f, 0.f, 0.f};
+	check(MeshletBuilder::isOutsideFrustum(meshlet, planes), "a sphere fully outside the frustum is culled");
+
+	meshlet.center = glm::vec3{0.f, -1.2f, 0.f};
+	check(!MeshletBuilder::isOutsideFrustum(meshlet, planes), "a sphere crossing a plane is kept");
+}
+
+int main()
+{
+	testLimitsAndIndices();
+	testBackfacing();
+	testFrustum();
+
+	if (failures)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "All meshlet checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,260 @@
+// CPU tests for TangentGenerator, its SSE path against its scalar path and both against the accumulation Mesh used
+// before it. Exits with a non-zero code if any check fails.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "TangentGenerator.h"
+#include "Vertex.h"
+
+// Tolerances for the tangent checks
+constexpr float maxAngleDegrees = 1.f;
+constexpr float maxNormalDotError = 1e-4f;
+constexpr float maxLengthErrorLimit = 1e-4f;
+constexpr float maxScalarDifference = 1e-5f;
+
+int failures = 0;
+
+void check(bool condition, const char *what)
+{
+	if (!condition)
+	{
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+// The tangent accumulation Mesh used before TangentGenerator, neither normalized nor orthogonal to the normal
+std::vector<glm::vec3> referenceTangents(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	std::vector<glm::vec3> tangents(vertices.size(), glm::vec3{0.f});
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		auto &vert1 = vertices.at(indices.at(i));
+		auto &vert2 = vertices.at(indices.at(i + 1));
+		auto &vert3 = vertices.at(indices.at(i + 2));
+
+		glm::vec3 edge1 = vert2.pos - vert1.pos;
+		glm::vec3 edge2 = vert3.pos - vert1.pos;
+		glm::vec2 deltaUV1 = vert2.texCoords - vert1.texCoords;
+		glm::vec2 deltaUV2 = vert3.texCoords - vert1.texCoords;
+
+		float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+		glm::vec3 newTan = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+
+		tangents.at(indices.at(i)) += newTan;
+		tangents.at(indices.at(i + 1)) += newTan;
+		tangents.at(indices.at(i + 2)) += newTan;
+	}
+
+	return tangents;
+}
+
+// How much removing the normal component shrinks the accumulated tangent of every vertex, which is how much the
+// rounding differences between the SSE and the scalar path get amplified
+std::vector<float> tangentConditions(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	std::vector<glm::vec3> tangents = referenceTangents(vertices, indices);
+
+	std::vector<float> conditions(vertices.size(), 1.f);
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		glm::vec3 normal = glm::normalize(vertices[i].normal);
+		float projectedLength = glm::length(tangents[i] - normal * glm::dot(normal, tangents[i]));
+		if (projectedLength > 1e-12f && std::isfinite(projectedLength))
+			conditions[i] = std::max(1.f, glm::length(tangents[i]) / projectedLength);
+	}
+
+	return conditions;
+}
+
+// The SSE path against the scalar path: the same tangent within maxScalarDifference, scaled by the condition of the
+// vertex, and the same handedness
+void checkAgainstScalar(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+						const std::vector<Vertex> &generated)
+{
+	std::vector<Vertex> scalar = vertices;
+	TangentGenerator::generateScalar(scalar, indices);
+	std::vector<float> conditions = tangentConditions(vertices, indices);
+
+	float maxDifference = 0.f;
+	size_t signMismatches = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		glm::vec3 difference = glm::abs(glm::vec3{generated[i].tangent} - glm::vec3{scalar[i].tangent}) / conditions[i];
+		maxDifference = std::max({maxDifference, difference.x, difference.y, difference.z});
+		if (generated[i].tangent.w != scalar[i].tangent.w)
+			signMismatches++;
+	}
+
+	check(maxDifference < maxScalarDifference, "SSE tangents match the scalar path");
+	check(signMismatches == 0, "SSE handedness matches the scalar path");
+}
+
+// Unit length tangents orthogonal to the normal with a handedness of 1 or -1, within maxAngleDegrees of the reference
+// projected onto the tangent plane. Vertices whose reference is degenerate (zero or NaN from collinear texture
+// coordinates) are skipped.
+void checkAgainstReference(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+						   const std::vector<Vertex> &generated)
+{
+	std::vector<glm::vec3> reference = referenceTangents(vertices, indices);
+
+	float maxAngle = 0.f;
+	float maxNormalDot = 0.f;
+	float maxLengthError = 0.f;
+	size_t badSigns = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		glm::vec3 normal = glm::normalize(vertices[i].normal);
+		glm::vec3 tangent{generated[i].tangent};
+
+		maxNormalDot = std::max(maxNormalDot, std::abs(glm::dot(normal, tangent)));
+		maxLengthError = std::max(maxLengthError, std::abs(glm::length(tangent) - 1.f));
+		if (generated[i].tangent.w != 1.f && generated[i].tangent.w != -1.f)
+			badSigns++;
+
+		glm::vec3 projected = reference[i] - normal * glm::dot(normal, reference[i]);
+		float projectedLength = glm::length(projected);
+		if (!(projectedLength > 1e-6f))
+			continue;
+
+		float cosine = glm::clamp(glm::dot(projected / projectedLength, tangent), -1.f, 1.f);
+		maxAngle = std::max(maxAngle, glm::degrees(std::acos(cosine)));
+	}
+
+	check(maxAngle < maxAngleDegrees, "tangents are within 1 degree of the reference");
+	check(maxNormalDot < maxNormalDotError, "tangents are orthogonal to the normal");
+	check(maxLengthError < maxLengthErrorLimit, "tangents are unit length");
+	check(badSigns == 0, "the handedness is either 1 or -1");
+}
+
+// A flat grid facing +z with u along x, or along -x when mirrored. Mirrored UVs flip the bitangent relative to
+// cross(N, T), so the expected handedness is known for every vertex.
+void appendGrid(uint32_t width, uint32_t height, bool mirrored, std::vector<Vertex> &vertices,
+				std::vector<uint32_t> &indices)
+{
+	uint32_t first = static_cast<uint32_t>(vertices.size());
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			Vertex vertex{};
+			vertex.pos = glm::vec3{static_cast<float>(x), static_cast<float>(y), 0.f};
+			vertex.normal = glm::vec3{0.f, 0.f, 1.f};
+			vertex.texCoords = glm::vec2{(mirrored ? -1.f : 1.f) * x / width, static_cast<float>(y) / height};
+			vertices.push_back(vertex);
+		}
+	}
+
+	for (uint32_t y = 0; y + 1 < height; y++)
+	{
+		for (uint32_t x = 0; x + 1 < width; x++)
+		{
+			uint32_t corner = first + y * width + x;
+			indices.insert(indices.end(), {corner, corner + 1, corner + width + 1});
+			indices.insert(indices.end(), {corner, corner + width + 1, corner + width});
+		}
+	}
+}
+
+// A UV sphere with a duplicated seam column and its poles collapsed into rings of vertices, so the triangles touching
+// the poles have collinear texture coordinates. The radius is perturbed so the normals, taken from the unperturbed
+// sphere, are not exactly orthogonal to the accumulated tangents.
+void buildSphere(uint32_t segments, uint32_t rings, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+	constexpr float pi = 3.14159265358979f;
+
+	vertices.clear();
+	indices.clear();
+
+	for (uint32_t ring = 0; ring <= rings; ring++)
+	{
+		float v = static_cast<float>(ring) / rings;
+		float theta = v * pi;
+		for (uint32_t segment = 0; segment <= segments; segment++)
+		{
+			float u = static_cast<float>(segment) / segments;
+			float phi = u * 2.f * pi;
+
+			glm::vec3 direction{std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+			float radius = 1.f + 0.05f * std::sin(7.f * phi) * std::sin(5.f * theta);
+
+			Vertex vertex{};
+			vertex.pos = radius * direction;
+			vertex.normal = direction;
+			vertex.texCoords = glm::vec2{u, v};
+			vertices.push_back(vertex);
+		}
+	}
+
+	for (uint32_t ring = 0; ring < rings; ring++)
+	{
+		for (uint32_t segment = 0; segment < segments; segment++)
+		{
+			uint32_t corner = ring * (segments + 1) + segment;
+			indices.insert(indices.end(), {corner, corner + segments + 2, corner + 1});
+			indices.insert(indices.end(), {corner, corner + segments + 1, corner + segments + 2});
+		}
+	}
+}
+
+// Vertex and triangle counts that are not multiples of 4, so the SSE lanes and the scalar tails both run
+void testGrids()
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	appendGrid(7, 5, false, vertices, indices);
+	appendGrid(5, 4, true, vertices, indices);
+	appendGrid(2, 2, false, vertices, indices);
+	uint32_t mirroredBegin = 35;
+	uint32_t mirroredEnd = 55;
+
+	std::vector<Vertex> generated = vertices;
+	TangentGenerator::generate(generated, indices);
+
+	size_t wrong = 0;
+	for (uint32_t i = 0; i < generated.size(); i++)
+	{
+		bool mirrored = i >= mirroredBegin && i < mirroredEnd;
+		glm::vec4 expected{mirrored ? -1.f : 1.f, 0.f, 0.f, mirrored ? -1.f : 1.f};
+		glm::vec4 difference = glm::abs(generated[i].tangent - expected);
+		if (std::max({difference.x, difference.y, difference.z, difference.w}) > maxNormalDotError)
+			wrong++;
+	}
+
+	check(wrong == 0, "mirrored texture coordinates flip the tangent and the handedness");
+	checkAgainstScalar(vertices, indices, generated);
+}
+
+void testSphere()
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	buildSphere(37, 19, vertices, indices);
+
+	std::vector<Vertex> generated = vertices;
+	TangentGenerator::generate(generated, indices);
+
+	checkAgainstReference(vertices, indices, generated);
+	checkAgainstScalar(vertices, indices, generated);
+}
+
+int main()
+{
+	testGrids();
+	testSphere();
+
+	if (failures)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "All tangent checks passed" << std::endl;
+	return 0;
+}